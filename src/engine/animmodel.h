@@ -1,5 +1,6 @@
 VARP(fullbrightmodels, 0, 0, 200);
 VAR(testtags, 0, 0, 1);
+VARP(cookmodels, 0, 1, 1);
 VARF(dbgcolmesh, 0, 0, 1,
 {
     extern void cleanupmodels();
@@ -619,6 +620,96 @@ struct animmodel : model
 
     static hashnameset<meshgroup *> meshgroups;
 
+    // fully processed meshes and animations are cooked into cache/, tagged with the size and crc of their source
+    // and a key for anything else that went into processing them, so later loads can skip parsing altogether
+    #define COOKEDMODEL_VERSION 1
+
+    struct cookedheader
+    {
+        char magic[4];
+        int version;
+        uint size, crc, key;
+        float smooth;
+    };
+
+    static bool cookedsource(const char *filename, uint &size, uint &crc)
+    {
+        stream *f = openfile(filename, "rb");
+        if(!f) return false;
+        uchar buf[16384];
+        size = 0;
+        crc = crc32(0, NULL, 0);
+        for(;;)
+        {
+            size_t len = f->read(buf, sizeof(buf));
+            if(!len) break;
+            crc = crc32(crc, buf, len);
+            size += len;
+        }
+        delete f;
+        return true;
+    }
+
+    static stream *opencooked(const char *filename, const char *kind, uint key, float smooth, bool write)
+    {
+        if(!cookmodels) return NULL;
+        cookedheader hdr;
+        if(!cookedsource(filename, hdr.size, hdr.crc)) return NULL;
+        defformatstring(cookedname, "cache/%s.%s", filename, kind);
+        stream *f = openfile(path(cookedname), write ? "wb" : "rb");
+        if(!f) return NULL;
+        if(write)
+        {
+            memcpy(hdr.magic, "TCMD", 4);
+            hdr.version = COOKEDMODEL_VERSION;
+            hdr.key = key;
+            hdr.smooth = smooth;
+            lilswap(&hdr.version, 4);
+            lilswap(&hdr.smooth, 1);
+            f->write(&hdr, sizeof(hdr));
+            return f;
+        }
+        cookedheader cooked;
+        if(f->read(&cooked, sizeof(cooked)) != sizeof(cooked) || memcmp(cooked.magic, "TCMD", 4)) { delete f; return NULL; }
+        lilswap(&cooked.version, 4);
+        lilswap(&cooked.smooth, 1);
+        if(cooked.version != COOKEDMODEL_VERSION || cooked.size != hdr.size || cooked.crc != hdr.crc || cooked.key != key || cooked.smooth != smooth) { delete f; return NULL; }
+        return f;
+    }
+
+    static void putcookedstring(stream *f, const char *s)
+    {
+        int len = s ? strlen(s) : -1;
+        f->putlil<int>(len);
+        if(len > 0) f->write(s, len);
+    }
+
+    static bool getcookedstring(stream *f, char *&s)
+    {
+        int len = f->getlil<int>();
+        if(len < 0) { s = NULL; return len == -1; }
+        if(len >= MAXSTRLEN) return false;
+        s = new char[len+1];
+        s[len] = '\0';
+        if(f->read(s, len) != size_t(len)) { DELETEA(s); return false; }
+        return true;
+    }
+
+    // arrays are written as runs of little endian words, W being the size of every field in T
+    template<class W, class T> static void putcookedwords(stream *f, T *data, int n)
+    {
+        lilswap((W *)data, n*sizeof(T)/sizeof(W));
+        f->write(data, n*sizeof(T));
+        lilswap((W *)data, n*sizeof(T)/sizeof(W));
+    }
+
+    template<class W, class T> static bool getcookedwords(stream *f, T *data, int n)
+    {
+        if(f->read(data, n*sizeof(T)) != n*sizeof(T)) return false;
+        lilswap((W *)data, n*sizeof(T)/sizeof(W));
+        return true;
+    }
+
     struct linkedpart
     {
         part *p;
@@ -1,116 +1,5 @@
 #include "engine.h"
-
-enum
-{
-    BM_BRANCH = 0,
-    BM_SOLID,
-    BM_IMAGE
-};
-
-struct BlendMapBranch;
-struct BlendMapSolid;
-struct BlendMapImage;
-
-struct BlendMapNode
-{
-    union
-    {
-        BlendMapBranch *branch;
-        BlendMapSolid *solid;
-        BlendMapImage *image;
-    };
-
-    void cleanup(int type);
-    void splitsolid(uchar &type, uchar val);
-};
-
-struct BlendMapBranch
-{
-    uchar type[4];
-    BlendMapNode children[4];
-
-    ~BlendMapBranch()
-    {
-        loopi(4) children[i].cleanup(type[i]);
-    }
-
-    uchar shrink(BlendMapNode &child, int quadrant);
-};
-
-struct BlendMapSolid
-{
-    uchar val;
-
-    BlendMapSolid(uchar val) : val(val) {}
-};
-
-#define BM_SCALE 1
-#define BM_IMAGE_SIZE 64
-
-struct BlendMapImage
-{
-    uchar data[BM_IMAGE_SIZE*BM_IMAGE_SIZE];
-};
-
-void BlendMapNode::cleanup(int type)
-{
-    switch(type)
-    {
-        case BM_BRANCH: delete branch; break;
-        case BM_IMAGE: delete image; break;
-    }
-}
-
-#define DEFBMSOLIDS(n) n, n+1, n+2, n+3, n+4, n+5, n+6, n+7, n+8, n+9, n+10, n+11, n+12, n+13, n+14, n+15
-
-static BlendMapSolid bmsolids[256] =
-{
-    DEFBMSOLIDS(0x00), DEFBMSOLIDS(0x10), DEFBMSOLIDS(0x20), DEFBMSOLIDS(0x30),
-    DEFBMSOLIDS(0x40), DEFBMSOLIDS(0x50), DEFBMSOLIDS(0x60), DEFBMSOLIDS(0x70),
-    DEFBMSOLIDS(0x80), DEFBMSOLIDS(0x90), DEFBMSOLIDS(0xA0), DEFBMSOLIDS(0xB0),
-    DEFBMSOLIDS(0xC0), DEFBMSOLIDS(0xD0), DEFBMSOLIDS(0xE0), DEFBMSOLIDS(0xF0),
-};
-
-void BlendMapNode::splitsolid(uchar &type, uchar val)
-{
-    cleanup(type);
-    type = BM_BRANCH;
-    branch = new BlendMapBranch;
-    loopi(4)
-    {
-        branch->type[i] = BM_SOLID;
-        branch->children[i].solid = &bmsolids[val];
-    }
-}
-
-uchar BlendMapBranch::shrink(BlendMapNode &child, int quadrant)
-{
-    uchar childtype = type[quadrant];
-    child = children[quadrant];
-    type[quadrant] = BM_SOLID;
-    children[quadrant].solid = &bmsolids[0];
-    return childtype;
-}
-
-struct BlendMapRoot : BlendMapNode
-{
-    uchar type;
-
-    BlendMapRoot() : type(BM_SOLID) { solid = &bmsolids[0xFF]; }
-    BlendMapRoot(uchar type, const BlendMapNode &node) : BlendMapNode(node), type(type) {}
-
-    void cleanup() { BlendMapNode::cleanup(type); }
-
-    void shrink(int quadrant)
-    {
-        if(type == BM_BRANCH)
-        {
-            BlendMapRoot oldroot = *this;
-            type = branch->shrink(*this, quadrant);
-            oldroot.cleanup();
-        }
-    }
-};
+#include "blendmap.h"
 
 static BlendMapRoot blendmap;
 
@@ -302,7 +191,7 @@ static void invertblendmap(uchar &type, BlendMapNode &node, int size, int x1, in
         uchar *dst = &node.image->data[y1*BM_IMAGE_SIZE + x1];
         loopi(y2-y1)
         {
-            loopj(x2-x1) dst[j] = 255-dst[j];
+            invertrow(dst, x2-x1);
             dst += BM_IMAGE_SIZE;
         }
     }
@@ -361,71 +250,6 @@ VARF(blendpaintmode, 0, 0, 5,
     if(!blendpaintmode) stoppaintblendmap();
 });
 
-static void blitblendmap(uchar &type, BlendMapNode &node, int bmx, int bmy, int bmsize, uchar *src, int sx, int sy, int sw, int sh, int smode)
-{
-    if(type==BM_BRANCH)
-    {
-        bmsize /= 2;
-        if(sy < bmy + bmsize)
-        {
-            if(sx < bmx + bmsize) blitblendmap(node.branch->type[0], node.branch->children[0], bmx, bmy, bmsize, src, sx, sy, sw, sh, smode);
-            if(sx + sw > bmx + bmsize) blitblendmap(node.branch->type[1], node.branch->children[1], bmx+bmsize, bmy, bmsize, src, sx, sy, sw, sh, smode);
-        }
-        if(sy + sh > bmy + bmsize)
-        {
-            if(sx < bmx + bmsize) blitblendmap(node.branch->type[2], node.branch->children[2], bmx, bmy+bmsize, bmsize, src, sx, sy, sw, sh, smode);
-            if(sx + sw > bmx + bmsize) blitblendmap(node.branch->type[3], node.branch->children[3], bmx+bmsize, bmy+bmsize, bmsize, src, sx, sy, sw, sh, smode);
-        }
-        return;
-    }
-    if(type==BM_SOLID)
-    {
-        uchar val = node.solid->val;
-        if(bmsize > BM_IMAGE_SIZE)
-        {
-            node.splitsolid(type, val);
-            blitblendmap(type, node, bmx, bmy, bmsize, src, sx, sy, sw, sh, smode);
-            return;
-        }
-
-        type = BM_IMAGE;
-        node.image = new BlendMapImage;
-        memset(node.image->data, val, sizeof(node.image->data));
-    }
-
-    int x1 = clamp(sx - bmx, 0, bmsize), y1 = clamp(sy - bmy, 0, bmsize),
-        x2 = clamp(sx+sw - bmx, 0, bmsize), y2 = clamp(sy+sh - bmy, 0, bmsize);
-    uchar *dst = &node.image->data[y1*BM_IMAGE_SIZE + x1];
-    src += max(bmy - sy, 0)*sw + max(bmx - sx, 0);
-    loopi(y2-y1)
-    {
-        switch(smode)
-        {
-            case 1:
-                memcpy(dst, src, x2 - x1);
-                break;
-
-            case 2:
-                loopi(x2 - x1) dst[i] = min(dst[i], src[i]);
-                break;
-
-            case 3:
-                loopi(x2 - x1) dst[i] = max(dst[i], src[i]);
-                break;
-
-            case 4:
-                loopi(x2 - x1) dst[i] = min(dst[i], uchar(0xFF - src[i]));
-                break;
-
-            case 5:
-                loopi(x2 - x1) dst[i] = max(dst[i], uchar(0xFF - src[i]));
-                break;
-        }
-        dst += BM_IMAGE_SIZE;
-        src += sw;
-    }
-}
-
 void blitblendmap(uchar *src, int sx, int sy, int sw, int sh, int smode)
 {
     int bmsize = worldsize>>BM_SCALE;
@@ -505,7 +329,7 @@ static int calcblendlayer(uchar &type, BlendMapNode &node, int bmx, int bmy, int
         val = src[0];
         loopi(y2-y1)
         {
-            loopj(x2-x1) if(src[j] != val) return LAYER_BLEND;
+            if(!uniformrow(src, x2-x1, val)) return LAYER_BLEND;
             src += BM_IMAGE_SIZE;
         }
     }
@@ -692,52 +516,11 @@ void dumpblendtexs()
 
 COMMAND(dumpblendtexs, "");
 
-static void renderblendtexture(uchar &type, BlendMapNode &node, int bmx, int bmy, int bmsize, uchar *dst, int dsize, int dx, int dy, int dw, int dh)
-{
-    if(type==BM_BRANCH)
-    {
-        bmsize /= 2;
-        if(dy < bmy + bmsize)
-        {
-            if(dx < bmx + bmsize) renderblendtexture(node.branch->type[0], node.branch->children[0], bmx, bmy, bmsize, dst, dsize, dx, dy, dw, dh);
-            if(dx + dw > bmx + bmsize) renderblendtexture(node.branch->type[1], node.branch->children[1], bmx+bmsize, bmy, bmsize, dst, dsize, dx, dy, dw, dh);
-        }
-        if(dy + dh > bmy + bmsize)
-        {
-            if(dx < bmx + bmsize) renderblendtexture(node.branch->type[2], node.branch->children[2], bmx, bmy+bmsize, bmsize, dst, dsize, dx, dy, dw, dh);
-            if(dx + dw > bmx + bmsize) renderblendtexture(node.branch->type[3], node.branch->children[3], bmx+bmsize, bmy+bmsize, bmsize, dst, dsize, dx, dy, dw, dh);
-        }
-        return;
-    }
-
-    int x1 = clamp(dx - bmx, 0, bmsize), y1 = clamp(dy - bmy, 0, bmsize),
-        x2 = clamp(dx+dw - bmx, 0, bmsize), y2 = clamp(dy+dh - bmy, 0, bmsize),
-        tsize = 1<<(min(worldscale, 12)-BM_SCALE),
-        step = tsize/dsize, stepw = (x2 - x1)/step, steph = (y2 - y1)/step;
-    dst += max(bmy - dy, 0)/step*dsize + max(bmx - dx, 0)/step;
-    if(type == BM_SOLID) loopi(steph)
-    {
-        memset(dst, node.solid->val, stepw);
-        dst += dsize;
-    }
-    else
-    {
-        uchar *src = &node.image->data[y1*BM_IMAGE_SIZE + x1];
-        loopi(steph)
-        {
-            if(step <= 1) memcpy(dst, src, stepw);
-            else for(int j = 0, k = 0; j < stepw; j++, k += step) dst[j] = src[k];
-            src += step*BM_IMAGE_SIZE;
-            dst += dsize;
-        }
-    }
-}
-
 void renderblendtexture(uchar *dst, int dsize, int dx, int dy, int dw, int dh)
 {
     int bmsize = worldsize>>BM_SCALE;
     if(max(dx, dy) >= bmsize || min(dx+dw, dy+dh) <= 0 || min(dw, dh) <= 0) return;
-    renderblendtexture(blendmap.type, blendmap, 0, 0, bmsize, dst, dsize, dx, dy, dw, dh);
+    renderblendtexture(blendmap.type, blendmap, 0, 0, bmsize, dst, dsize, (1<<(min(worldscale, 12)-BM_SCALE))/dsize, dx, dy, dw, dh);
 }
 
 static bool usesblendmap(uchar &type, BlendMapNode &node, int bmx, int bmy, int bmsize, int ux, int uy, int uw, int uh)
@@ -830,16 +613,17 @@ static void updateblendtextures(uchar &type, BlendMapNode &node, int bmx, int bm
         int tsize = 1<<(min(worldscale, 12)-BM_SCALE),
             ux1 = tx, ux2 = tx + tsize, uy1 = ty, uy2 = ty + tsize,
             step = tsize/bt->size;
-        if(!bt->valid)
+        // a valid tile only re-rasterizes and uploads the dirty rectangle, a new or resized one is filled entirely
+        if(bt->valid)
         {
             ux1 = max(ux1, ux&~(step-1));
             ux2 = min(ux2, (ux+uw+step-1)&~(step-1));
             uy1 = max(uy1, uy&~(step-1));
             uy2 = min(uy2, (uy+uh+step-1)&~(step-1));
-            bt->valid = true;
         }
+        else bt->valid = true;
         uchar *data = bt->data + (uy1-ty)/step*bt->size + (ux1-tx)/step;
-        renderblendtexture(type, node, bmx, bmy, bmsize, data, bt->size, ux1, uy1, ux2-ux1, uy2-uy1);
+        renderblendtexture(type, node, bmx, bmy, bmsize, data, bt->size, step, ux1, uy1, ux2-ux1, uy2-uy1);
         glPixelStorei(GL_UNPACK_ROW_LENGTH, bt->size);
         glBindTexture(GL_TEXTURE_2D, bt->tex);
         glTexSubImage2D(GL_TEXTURE_2D, 0, (ux1-tx)/step, (uy1-ty)/step, (ux2-ux1)/step, (uy2-uy1)/step, bt->format, GL_UNSIGNED_BYTE, data);
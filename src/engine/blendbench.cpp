@@ -0,0 +1,140 @@
+// blendbench.cpp: paints a synthetic brush stroke into a blend map headlessly, timing the blits and the rasterization
+// of the blend texture tiles each stamp dirties, both as whole tiles and as just the stamp's rectangle
+// the tiles kept up to date by dirty rectangles are checked against whole tiles once each stroke is done
+
+#include "cube.h"
+#include "blendmap.h"
+
+static int mapscale = 14, brushsize = 128, numstamps = 1000, iterations = 4, paintmode = 2, blendtexsize = 9;
+static bool prefill = true;
+
+static uchar *brush = NULL;
+
+// a round brush that paints fully at its centre and fades out towards its edge
+static void makebrush()
+{
+    brush = new uchar[brushsize*brushsize];
+    float r = brushsize/2.0f;
+    loop(y, brushsize) loop(x, brushsize)
+    {
+        float dx = x + 0.5f - r, dy = y + 0.5f - r;
+        brush[y*brushsize + x] = uchar(clamp(sqrtf(dx*dx + dy*dy)/r, 0.0f, 1.0f)*255);
+    }
+}
+
+struct blendstamp
+{
+    int x, y;
+};
+static vector<blendstamp> stroke;
+
+// a wandering drag across the map, each stamp an eighth of the brush on from the last, turning back at the edges
+static void makestroke(int bmsize)
+{
+    vec2 pos(rndscale(bmsize), rndscale(bmsize));
+    float dir = rndscale(2*M_PI), dist = max(brushsize/8, 1);
+    loopi(numstamps)
+    {
+        blendstamp &s = stroke.add();
+        s.x = int(pos.x) - brushsize/2;
+        s.y = int(pos.y) - brushsize/2;
+        dir += rndscale(0.5f) - 0.25f;
+        pos.add(vec2(cosf(dir), sinf(dir)).mul(dist));
+        if(pos.x < 0 || pos.x >= bmsize) { dir = M_PI - dir; pos.x = clamp(pos.x, 0.0f, bmsize - 1.0f); }
+        if(pos.y < 0 || pos.y >= bmsize) { dir = -dir; pos.y = clamp(pos.y, 0.0f, bmsize - 1.0f); }
+    }
+}
+
+// covers the whole map with image nodes, as on a map that has been painted all over
+static void fillnoise(BlendMapRoot &root, int bmsize)
+{
+    uchar noise[BM_IMAGE_SIZE*BM_IMAGE_SIZE];
+    for(int y = 0; y < bmsize; y += BM_IMAGE_SIZE) for(int x = 0; x < bmsize; x += BM_IMAGE_SIZE)
+    {
+        loopi(BM_IMAGE_SIZE*BM_IMAGE_SIZE) noise[i] = uchar(0x80 | randomMT());
+        blitblendmap(root.type, root, 0, 0, bmsize, noise, x, y, BM_IMAGE_SIZE, BM_IMAGE_SIZE, 1);
+    }
+}
+
+static bool loadoption(const char *arg)
+{
+    if(arg[0] != '-') return false;
+    switch(arg[1])
+    {
+        case 'w': mapscale = clamp(atoi(&arg[2]), 10, 16); return true;
+        case 'b': brushsize = clamp(atoi(&arg[2]), 1, 1024); return true;
+        case 's': numstamps = max(atoi(&arg[2]), 1); return true;
+        case 'n': iterations = max(atoi(&arg[2]), 1); return true;
+        case 'm': paintmode = clamp(atoi(&arg[2]), 1, 5); return true;
+        // any smaller and a texel steps over whole image nodes, which renderblendtexture leaves unsampled
+        case 't': blendtexsize = clamp(atoi(&arg[2]), 12-BM_SCALE-6, 12-BM_SCALE); return true;
+        case 'f': prefill = atoi(&arg[2]) != 0; return true;
+    }
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    for(int i = 1; i < argc; i++) if(!loadoption(argv[i]))
+    {
+        printf("usage: tess_blendbench [-wMAPSCALE] [-bBRUSHSIZE] [-sSTAMPS] [-nITERATIONS] [-mPAINTMODE] [-tBLENDTEXSIZE] [-fPREFILL]\n");
+        return EXIT_FAILURE;
+    }
+    seedMT(1);
+
+    // the tile and texture sizes updateblendtextures uses for a map of this scale
+    int bmsize = 1<<(mapscale-BM_SCALE), tsize = 1<<(min(mapscale, 12)-BM_SCALE),
+        dsize = 1<<min(mapscale-BM_SCALE, blendtexsize), step = tsize/dsize, numtiles = bmsize/tsize;
+    makebrush();
+    makestroke(bmsize);
+    printf("%dx%d blend map%s, %dx%d brush in mode %d, %d stamps, %dx%d tiles of %dx%d texels\n",
+        bmsize, bmsize, prefill ? " of image nodes" : "", brushsize, brushsize, paintmode, numstamps, numtiles, numtiles, dsize, dsize);
+
+    uchar *tile = new uchar[dsize*dsize], *tiles = new uchar[numtiles*numtiles*dsize*dsize];
+    #define TILE(tx, ty) &tiles[((ty)*numtiles + (tx))*dsize*dsize]
+    uint blitmicros = 0, fullmicros = 0, dirtymicros = 0;
+    int stamps = 0;
+    loopi(iterations)
+    {
+        BlendMapRoot root;
+        if(prefill) fillnoise(root, bmsize);
+        loop(ty, numtiles) loop(tx, numtiles) renderblendtexture(root.type, root, 0, 0, bmsize, TILE(tx, ty), dsize, step, tx*tsize, ty*tsize, tsize, tsize);
+        loopvj(stroke)
+        {
+            const blendstamp &s = stroke[j];
+            if(max(s.x, s.y) >= bmsize || min(s.x+brushsize, s.y+brushsize) <= 0) continue;
+            uint start = getclockmicros();
+            blitblendmap(root.type, root, 0, 0, bmsize, brush, s.x, s.y, brushsize, brushsize, paintmode);
+            uint blitted = getclockmicros();
+            // the same dirty rectangle paintblendmap hands on to the blend textures
+            int ux1 = max(s.x-1, 0), uy1 = max(s.y-1, 0), ux2 = min(s.x+brushsize+1, bmsize), uy2 = min(s.y+brushsize+1, bmsize);
+            for(int ty = uy1&~(tsize-1); ty < uy2; ty += tsize) for(int tx = ux1&~(tsize-1); tx < ux2; tx += tsize)
+                renderblendtexture(root.type, root, 0, 0, bmsize, tile, dsize, step, tx, ty, tsize, tsize);
+            uint full = getclockmicros();
+            for(int ty = uy1&~(tsize-1); ty < uy2; ty += tsize) for(int tx = ux1&~(tsize-1); tx < ux2; tx += tsize)
+            {
+                int x1 = max(tx, ux1&~(step-1)), x2 = min(tx+tsize, (ux2+step-1)&~(step-1)),
+                    y1 = max(ty, uy1&~(step-1)), y2 = min(ty+tsize, (uy2+step-1)&~(step-1));
+                renderblendtexture(root.type, root, 0, 0, bmsize, TILE(tx/tsize, ty/tsize) + (y1-ty)/step*dsize + (x1-tx)/step, dsize, step, x1, y1, x2-x1, y2-y1);
+            }
+            uint dirty = getclockmicros();
+            blitmicros += blitted - start;
+            fullmicros += full - blitted;
+            dirtymicros += dirty - full;
+            stamps++;
+        }
+        loop(ty, numtiles) loop(tx, numtiles)
+        {
+            renderblendtexture(root.type, root, 0, 0, bmsize, tile, dsize, step, tx*tsize, ty*tsize, tsize, tsize);
+            if(memcmp(tile, TILE(tx, ty), dsize*dsize)) fatal("tile %d,%d kept by dirty rectangles differs from a whole tile", tx, ty);
+        }
+        root.cleanup();
+    }
+    #undef TILE
+    if(stamps) printf("per stamp: blit %.1f us, whole tiles %.1f us, dirty rects %.1f us\n",
+        blitmicros/float(stamps), fullmicros/float(stamps), dirtymicros/float(stamps));
+    delete[] tile;
+    delete[] tiles;
+    delete[] brush;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,279 @@
+// blendmap.h: the blend map quadtree, painting brushes into it and rasterizing it into blend texture tiles
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+enum
+{
+    BM_BRANCH = 0,
+    BM_SOLID,
+    BM_IMAGE
+};
+
+struct BlendMapBranch;
+struct BlendMapSolid;
+struct BlendMapImage;
+
+struct BlendMapNode
+{
+    union
+    {
+        BlendMapBranch *branch;
+        BlendMapSolid *solid;
+        BlendMapImage *image;
+    };
+
+    void cleanup(int type);
+    void splitsolid(uchar &type, uchar val);
+};
+
+struct BlendMapBranch
+{
+    uchar type[4];
+    BlendMapNode children[4];
+
+    ~BlendMapBranch()
+    {
+        loopi(4) children[i].cleanup(type[i]);
+    }
+
+    uchar shrink(BlendMapNode &child, int quadrant);
+};
+
+struct BlendMapSolid
+{
+    uchar val;
+
+    BlendMapSolid(uchar val) : val(val) {}
+};
+
+#define BM_SCALE 1
+#define BM_IMAGE_SIZE 64
+
+struct BlendMapImage
+{
+    uchar data[BM_IMAGE_SIZE*BM_IMAGE_SIZE];
+};
+
+// row kernels for painting and rasterizing image tiles, 16 texels at a time where SSE2 is available
+
+static inline void blendrow(uchar *dst, const uchar *src, int n, bool usemax, uchar flip)
+{
+    int i = 0;
+#ifdef __SSE2__
+    __m128i f = _mm_set1_epi8(char(flip));
+    if(usemax) for(; i + 16 <= n; i += 16)
+        _mm_storeu_si128((__m128i *)&dst[i], _mm_max_epu8(_mm_loadu_si128((const __m128i *)&dst[i]), _mm_xor_si128(_mm_loadu_si128((const __m128i *)&src[i]), f)));
+    else for(; i + 16 <= n; i += 16)
+        _mm_storeu_si128((__m128i *)&dst[i], _mm_min_epu8(_mm_loadu_si128((const __m128i *)&dst[i]), _mm_xor_si128(_mm_loadu_si128((const __m128i *)&src[i]), f)));
+#endif
+    if(usemax) for(; i < n; i++) dst[i] = max(dst[i], uchar(src[i]^flip));
+    else for(; i < n; i++) dst[i] = min(dst[i], uchar(src[i]^flip));
+}
+
+static inline void invertrow(uchar *dst, int n)
+{
+    int i = 0;
+#ifdef __SSE2__
+    __m128i f = _mm_set1_epi8(char(0xFF));
+    for(; i + 16 <= n; i += 16)
+        _mm_storeu_si128((__m128i *)&dst[i], _mm_xor_si128(_mm_loadu_si128((const __m128i *)&dst[i]), f));
+#endif
+    for(; i < n; i++) dst[i] = 255-dst[i];
+}
+
+static inline bool uniformrow(const uchar *src, int n, uchar val)
+{
+    int i = 0;
+#ifdef __SSE2__
+    __m128i v = _mm_set1_epi8(char(val));
+    for(; i + 16 <= n; i += 16)
+        if(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)&src[i]), v)) != 0xFFFF) return false;
+#endif
+    for(; i < n; i++) if(src[i] != val) return false;
+    return true;
+}
+
+// point samples every step'th texel of src into n texels of dst
+static inline void downsamplerow(uchar *dst, const uchar *src, int n, int step)
+{
+    int i = 0;
+#ifdef __SSE2__
+    if(step == 2)
+    {
+        __m128i mask = _mm_set1_epi16(0xFF);
+        for(; i + 16 <= n; i += 16)
+        {
+            const __m128i *row = (const __m128i *)&src[2*i];
+            __m128i lo = _mm_and_si128(_mm_loadu_si128(&row[0]), mask), hi = _mm_and_si128(_mm_loadu_si128(&row[1]), mask);
+            _mm_storeu_si128((__m128i *)&dst[i], _mm_packus_epi16(lo, hi));
+        }
+    }
+    else if(step == 4)
+    {
+        __m128i mask = _mm_set1_epi32(0xFF);
+        for(; i + 16 <= n; i += 16)
+        {
+            const __m128i *row = (const __m128i *)&src[4*i];
+            __m128i a = _mm_and_si128(_mm_loadu_si128(&row[0]), mask), b = _mm_and_si128(_mm_loadu_si128(&row[1]), mask),
+                    c = _mm_and_si128(_mm_loadu_si128(&row[2]), mask), d = _mm_and_si128(_mm_loadu_si128(&row[3]), mask);
+            _mm_storeu_si128((__m128i *)&dst[i], _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+        }
+    }
+#endif
+    for(int k = i*step; i < n; i++, k += step) dst[i] = src[k];
+}
+
+inline void BlendMapNode::cleanup(int type)
+{
+    switch(type)
+    {
+        case BM_BRANCH: delete branch; break;
+        case BM_IMAGE: delete image; break;
+    }
+}
+
+#define DEFBMSOLIDS(n) n, n+1, n+2, n+3, n+4, n+5, n+6, n+7, n+8, n+9, n+10, n+11, n+12, n+13, n+14, n+15
+
+static BlendMapSolid bmsolids[256] =
+{
+    DEFBMSOLIDS(0x00), DEFBMSOLIDS(0x10), DEFBMSOLIDS(0x20), DEFBMSOLIDS(0x30),
+    DEFBMSOLIDS(0x40), DEFBMSOLIDS(0x50), DEFBMSOLIDS(0x60), DEFBMSOLIDS(0x70),
+    DEFBMSOLIDS(0x80), DEFBMSOLIDS(0x90), DEFBMSOLIDS(0xA0), DEFBMSOLIDS(0xB0),
+    DEFBMSOLIDS(0xC0), DEFBMSOLIDS(0xD0), DEFBMSOLIDS(0xE0), DEFBMSOLIDS(0xF0),
+};
+
+inline void BlendMapNode::splitsolid(uchar &type, uchar val)
+{
+    cleanup(type);
+    type = BM_BRANCH;
+    branch = new BlendMapBranch;
+    loopi(4)
+    {
+        branch->type[i] = BM_SOLID;
+        branch->children[i].solid = &bmsolids[val];
+    }
+}
+
+inline uchar BlendMapBranch::shrink(BlendMapNode &child, int quadrant)
+{
+    uchar childtype = type[quadrant];
+    child = children[quadrant];
+    type[quadrant] = BM_SOLID;
+    children[quadrant].solid = &bmsolids[0];
+    return childtype;
+}
+
+struct BlendMapRoot : BlendMapNode
+{
+    uchar type;
+
+    BlendMapRoot() : type(BM_SOLID) { solid = &bmsolids[0xFF]; }
+    BlendMapRoot(uchar type, const BlendMapNode &node) : BlendMapNode(node), type(type) {}
+
+    void cleanup() { BlendMapNode::cleanup(type); }
+
+    void shrink(int quadrant)
+    {
+        if(type == BM_BRANCH)
+        {
+            BlendMapRoot oldroot = *this;
+            type = branch->shrink(*this, quadrant);
+            oldroot.cleanup();
+        }
+    }
+};
+
+static void blitblendmap(uchar &type, BlendMapNode &node, int bmx, int bmy, int bmsize, uchar *src, int sx, int sy, int sw, int sh, int smode)
+{
+    if(type==BM_BRANCH)
+    {
+        bmsize /= 2;
+        if(sy < bmy + bmsize)
+        {
+            if(sx < bmx + bmsize) blitblendmap(node.branch->type[0], node.branch->children[0], bmx, bmy, bmsize, src, sx, sy, sw, sh, smode);
+            if(sx + sw > bmx + bmsize) blitblendmap(node.branch->type[1], node.branch->children[1], bmx+bmsize, bmy, bmsize, src, sx, sy, sw, sh, smode);
+        }
+        if(sy + sh > bmy + bmsize)
+        {
+            if(sx < bmx + bmsize) blitblendmap(node.branch->type[2], node.branch->children[2], bmx, bmy+bmsize, bmsize, src, sx, sy, sw, sh, smode);
+            if(sx + sw > bmx + bmsize) blitblendmap(node.branch->type[3], node.branch->children[3], bmx+bmsize, bmy+bmsize, bmsize, src, sx, sy, sw, sh, smode);
+        }
+        return;
+    }
+    if(type==BM_SOLID)
+    {
+        uchar val = node.solid->val;
+        if(bmsize > BM_IMAGE_SIZE)
+        {
+            node.splitsolid(type, val);
+            blitblendmap(type, node, bmx, bmy, bmsize, src, sx, sy, sw, sh, smode);
+            return;
+        }
+
+        type = BM_IMAGE;
+        node.image = new BlendMapImage;
+        memset(node.image->data, val, sizeof(node.image->data));
+    }
+
+    int x1 = clamp(sx - bmx, 0, bmsize), y1 = clamp(sy - bmy, 0, bmsize),
+        x2 = clamp(sx+sw - bmx, 0, bmsize), y2 = clamp(sy+sh - bmy, 0, bmsize);
+    uchar *dst = &node.image->data[y1*BM_IMAGE_SIZE + x1];
+    src += max(bmy - sy, 0)*sw + max(bmx - sx, 0);
+    loopi(y2-y1)
+    {
+        switch(smode)
+        {
+            case 1:
+                memcpy(dst, src, x2 - x1);
+                break;
+
+            case 2: case 3: case 4: case 5:
+                blendrow(dst, src, x2 - x1, smode == 3 || smode == 5, smode >= 4 ? 0xFF : 0);
+                break;
+        }
+        dst += BM_IMAGE_SIZE;
+        src += sw;
+    }
+}
+
+static void renderblendtexture(uchar &type, BlendMapNode &node, int bmx, int bmy, int bmsize, uchar *dst, int dsize, int step, int dx, int dy, int dw, int dh)
+{
+    if(type==BM_BRANCH)
+    {
+        bmsize /= 2;
+        if(dy < bmy + bmsize)
+        {
+            if(dx < bmx + bmsize) renderblendtexture(node.branch->type[0], node.branch->children[0], bmx, bmy, bmsize, dst, dsize, step, dx, dy, dw, dh);
+            if(dx + dw > bmx + bmsize) renderblendtexture(node.branch->type[1], node.branch->children[1], bmx+bmsize, bmy, bmsize, dst, dsize, step, dx, dy, dw, dh);
+        }
+        if(dy + dh > bmy + bmsize)
+        {
+            if(dx < bmx + bmsize) renderblendtexture(node.branch->type[2], node.branch->children[2], bmx, bmy+bmsize, bmsize, dst, dsize, step, dx, dy, dw, dh);
+            if(dx + dw > bmx + bmsize) renderblendtexture(node.branch->type[3], node.branch->children[3], bmx+bmsize, bmy+bmsize, bmsize, dst, dsize, step, dx, dy, dw, dh);
+        }
+        return;
+    }
+
+    int x1 = clamp(dx - bmx, 0, bmsize), y1 = clamp(dy - bmy, 0, bmsize),
+        x2 = clamp(dx+dw - bmx, 0, bmsize), y2 = clamp(dy+dh - bmy, 0, bmsize),
+        stepw = (x2 - x1)/step, steph = (y2 - y1)/step;
+    dst += max(bmy - dy, 0)/step*dsize + max(bmx - dx, 0)/step;
+    if(type == BM_SOLID) loopi(steph)
+    {
+        memset(dst, node.solid->val, stepw);
+        dst += dsize;
+    }
+    else
+    {
+        uchar *src = &node.image->data[y1*BM_IMAGE_SIZE + x1];
+        loopi(steph)
+        {
+            if(step <= 1) memcpy(dst, src, stepw);
+            else downsamplerow(dst, src, stepw, step);
+            src += step*BM_IMAGE_SIZE;
+            dst += dsize;
+        }
+    }
+}
@@ -4256,6 +4256,7 @@ COMMANDN(sleep, addsleep, "is");
 
 void checksleep(int millis)
 {
+    PROFILE("script");
     loopv(sleepcmds)
     {
         sleepcmd &s = sleepcmds[i];
@@ -204,6 +204,7 @@ extern void getcubevector(cube &c, int d, int x, int y, int z, ivec &p);
 extern void setcubevector(cube &c, int d, int x, int y, int z, const ivec &p);
 extern int familysize(const cube &c);
 extern void freeocta(cube *c);
+extern void trimoctapools();
 extern void discardchildren(cube &c, bool fixtex = false, int depth = 0);
 extern void optiface(uchar *p, cube &c);
 extern void validatec(cube *c, int size = 0);
@@ -239,10 +240,10 @@ extern int visibleorient(const cube &c, int orient);
 extern void genfaceverts(const cube &c, int orient, ivec v[4]);
 extern int calcmergedsize(int orient, const ivec &co, int size, const vertinfo *verts, int numverts);
 extern void invalidatemerges(cube &c, const ivec &co, int size, bool msg);
-extern void calcmerges();
+extern void calcmerges(bool dirtyonly = false);
 extern int mergefaces(int orient, facebounds *m, int sz);
 extern void mincubeface(const cube &cu, int orient, const ivec &o, int size, const facebounds &orig, facebounds &cf, ushort nmat = MAT_AIR, ushort matmask = MATF_VOLUME);
-extern void remip();
+extern bool remip();
 
 static inline cubeext &ext(cube &c)
 {
@@ -287,6 +288,7 @@ extern matrix4 shadowmatrix;
 
 extern void loaddeferredlightshaders();
 extern void cleardeferredlightshaders();
+extern void clearshadowmaps();
 extern void clearshadowcache();
 
 extern void rendervolumetric();
@@ -390,6 +392,20 @@ extern void pasteundoent(int idx, const entity &ue);
 extern void pasteundoents(undoblock *u);
 
 // octaedit
+struct editregion // bounds of the world touched by edits, empty while bbmin > bbmax
+{
+    ivec bbmin, bbmax;
+
+    editregion() { reset(); }
+
+    void reset() { bbmin = ivec(INT_MAX, INT_MAX, INT_MAX); bbmax = ivec(INT_MIN, INT_MIN, INT_MIN); }
+    void all() { bbmin = ivec(0, 0, 0); bbmax = ivec(worldsize, worldsize, worldsize); }
+    bool empty() const { return bbmin.x > bbmax.x; }
+    bool whole() const { return bbmin.x <= 0 && bbmin.y <= 0 && bbmin.z <= 0 && bbmax.x >= worldsize && bbmax.y >= worldsize && bbmax.z >= worldsize; }
+    void add(const ivec &lo, const ivec &hi) { bbmin.min(lo); bbmax.max(hi); }
+};
+
+extern editregion remipregion, recalcregion;
 extern void cancelsel();
 extern void rendertexturepanel(int w, int h);
 extern void addundo(undoblock *u);
@@ -413,6 +429,7 @@ extern vec decodenormal(ushort norm);
 extern void guessnormals(const vec *pos, int numverts, vec *normals);
 extern void reduceslope(ivec &n);
 extern void findtjoints();
+extern void findtjoints(const ivec &bbmin, const ivec &bbmax);
 extern void octarender();
 extern void allchanged(bool load = false);
 extern void clearvas(cube *c);
@@ -423,6 +440,7 @@ extern void updatevabbs(bool force = false);
 // renderva
 
 extern int oqfrags;
+extern float vfcDfog;
 extern float alphafrontsx1, alphafrontsx2, alphafrontsy1, alphafrontsy2, alphabacksx1, alphabacksx2, alphabacksy1, alphabacksy2, alpharefractsx1, alpharefractsx2, alpharefractsy1, alpharefractsy2;
 extern uint alphatiles[LIGHTTILE_MAXH];
 extern vtxarray *visibleva;
@@ -460,7 +478,9 @@ extern void renderdecals();
 
 struct shadowmesh;
 extern void clearshadowmeshes();
+extern void clearshadowmeshes(const ivec &bbmin, const ivec &bbmax);
 extern void genshadowmeshes();
+extern void genshadowmeshes(const ivec &bbmin, const ivec &bbmax);
 extern shadowmesh *findshadowmesh(int idx, extentity &e);
 extern void rendershadowmesh(shadowmesh *m);
 
@@ -757,6 +777,7 @@ extern void clearmainmenu();
 
 // sound
 extern void clearmapsounds();
+extern void clearmapsoundindex();
 extern void checkmapsounds();
 extern void updatesounds();
 extern void preloadmapsounds();
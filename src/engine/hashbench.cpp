@@ -0,0 +1,144 @@
+// hashbench.cpp: times deduplicating inserts, the way genpvs numbers unique view cells, from 1 to N threads
+// a hashtable behind one mutex is compared against the lock-free concurrenthashtable
+
+#include "cube.h"
+
+#ifndef WIN32
+#include <pthread.h>
+#endif
+
+static int maxthreads = 8, numops = 4000000, numkeys = 100000;
+
+#ifdef WIN32
+static CRITICAL_SECTION tablelock;
+#define LOCKTABLE EnterCriticalSection(&tablelock)
+#define UNLOCKTABLE LeaveCriticalSection(&tablelock)
+#else
+static pthread_mutex_t tablelock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCKTABLE pthread_mutex_lock(&tablelock)
+#define UNLOCKTABLE pthread_mutex_unlock(&tablelock)
+#endif
+
+static vector<int> keys;
+static hashtable<int, int> *lockedtable = NULL;
+static concurrenthashtable<int, int> concurrenttable;
+static int nextid = 0;
+static bool concurrent = false;
+
+struct benchworker
+{
+    int first, last;
+#ifdef WIN32
+    HANDLE thread;
+#else
+    pthread_t thread;
+#endif
+};
+
+static void runops(int first, int last)
+{
+    if(concurrent) for(int i = first; i < last; i++)
+    {
+        int key = keys[i];
+        if(!concurrenttable.access(key)) concurrenttable.access(key, atomicadd(nextid, 1) - 1);
+    }
+    else for(int i = first; i < last; i++)
+    {
+        int key = keys[i];
+        LOCKTABLE;
+        int *id = lockedtable->access(key);
+        if(!id) (*lockedtable)[key] = nextid++;
+        UNLOCKTABLE;
+    }
+}
+
+#ifdef WIN32
+static DWORD WINAPI benchthread(LPVOID data)
+#else
+static void *benchthread(void *data)
+#endif
+{
+    benchworker *w = (benchworker *)data;
+    runops(w->first, w->last);
+    return 0;
+}
+
+static double runbench(int numthreads)
+{
+    lockedtable->clear();
+    concurrenttable.reserve(numkeys);
+    nextid = 0;
+    vector<benchworker> workers;
+    loopi(numthreads)
+    {
+        benchworker &w = workers.add();
+        w.first = i*numops/numthreads;
+        w.last = (i+1)*numops/numthreads;
+    }
+    uint start = getclockmicros();
+    loopv(workers)
+    {
+        benchworker &w = workers[i];
+#ifdef WIN32
+        w.thread = CreateThread(NULL, 0, benchthread, &w, 0, NULL);
+        if(!w.thread) fatal("could not create thread");
+#else
+        if(pthread_create(&w.thread, NULL, benchthread, &w)) fatal("could not create thread");
+#endif
+    }
+    loopv(workers)
+    {
+#ifdef WIN32
+        WaitForSingleObject(workers[i].thread, INFINITE);
+        CloseHandle(workers[i].thread);
+#else
+        pthread_join(workers[i].thread, NULL);
+#endif
+    }
+    double millis = (getclockmicros() - start)/1000.0;
+    int unique = concurrent ? concurrenttable.length() : lockedtable->numelems;
+    if(unique > numkeys) fatal("%d unique keys found, expected at most %d", unique, numkeys);
+    return millis;
+}
+
+static bool loadoption(const char *arg)
+{
+    if(arg[0] != '-') return false;
+    switch(arg[1])
+    {
+        case 't': maxthreads = clamp(atoi(&arg[2]), 1, 64); return true;
+        case 'n': numops = max(atoi(&arg[2]), 1); return true;
+        case 'k': numkeys = max(atoi(&arg[2]), 1); return true;
+    }
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    for(int i = 1; i < argc; i++) if(!loadoption(argv[i]))
+    {
+        printf("usage: tess_hashbench [-tMAXTHREADS] [-nOPERATIONS] [-kKEYS]\n");
+        return EXIT_FAILURE;
+    }
+#ifdef WIN32
+    InitializeCriticalSection(&tablelock);
+#endif
+    // both tables get as many buckets for the keys
+    int size = 1;
+    while(size < 2*numkeys) size <<= 1;
+    lockedtable = new hashtable<int, int>(size);
+    seedMT(1);
+    loopi(numops) keys.add(randomMT()%numkeys);
+    printf("%d deduplicating inserts over %d keys\n", numops, numkeys);
+    for(int numthreads = 1; numthreads <= maxthreads; numthreads *= 2)
+    {
+        concurrent = false;
+        double locked = runbench(numthreads);
+        concurrent = true;
+        double lockfree = runbench(numthreads);
+        printf("%2d threads: hashtable+mutex %.1f Mops/sec, concurrenthashtable %.1f Mops/sec\n",
+            numthreads, numops/(locked*1000.0), numops/(lockfree*1000.0));
+    }
+    delete lockedtable;
+    return EXIT_SUCCESS;
+}
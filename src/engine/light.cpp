@@ -1,4 +1,5 @@
 #include "engine.h"
+#include "lightgrid.h"
 
 CVAR1R(ambient, 0x191919);
 FVARR(ambientscale, 0, 1, 16);
@@ -259,75 +260,39 @@ static void clearsurfaces(cube *c)
     }
 }
 
-#define LIGHTCACHESIZE 1024
+static lightgrid lightbins;
 
-static struct lightcacheentry
+VARF(lightgridsize, 4, 6, 12, clearlightcache());
+// the grid took over from the light cache, so configs and maps that still set lightcachesize keep working
+ICOMMAND(lightcachesize, "iN", (int *size, int *numargs),
 {
-    int x, y;
-    vector<int> lights;
-} lightcache[LIGHTCACHESIZE];
-
-#define LIGHTCACHEHASH(x, y) (((((x)^(y))<<5) + (((x)^(y))>>5)) & (LIGHTCACHESIZE - 1))
-
-VARF(lightcachesize, 4, 6, 12, clearlightcache());
+    if(*numargs > 0) setvar("lightgridsize", *size);
+    else if(!*numargs) conoutf("lightgridsize = %d", lightgridsize);
+    else intret(lightgridsize);
+});
 
 void clearlightcache(int id)
 {
-    if(id >= 0)
-    {
-        const extentity &light = *entities::getents()[id];
-        int radius = light.attr1;
-        if(radius <= 0) return;
-        for(int x = int(max(light.o.x-radius, 0.0f))>>lightcachesize, ex = int(min(light.o.x+radius, worldsize-1.0f))>>lightcachesize; x <= ex; x++)
-        for(int y = int(max(light.o.y-radius, 0.0f))>>lightcachesize, ey = int(min(light.o.y+radius, worldsize-1.0f))>>lightcachesize; y <= ey; y++)
-        {
-            lightcacheentry &lce = lightcache[LIGHTCACHEHASH(x, y)];
-            if(lce.x != x || lce.y != y) continue;
-            lce.x = -1;
-            lce.lights.setsize(0);
-        }
-        return;
-    }
-
-    for(lightcacheentry *lce = lightcache; lce < &lightcache[LIGHTCACHESIZE]; lce++)
-    {
-        lce->x = -1;
-        lce->lights.setsize(0);
-    }
+    // an edited light is taken out of the octree with its old state and put back with its new one
+    if(id >= 0) lightbins.update(entities::getents(), id, (entities::getents()[id]->flags&EF_OCTA) != 0);
+    else lightbins.dirty = true;
 }
 
-const vector<int> &checklightcache(int x, int y)
+static inline void checklightgrid()
 {
-    x >>= lightcachesize;
-    y >>= lightcachesize;
-    lightcacheentry &lce = lightcache[LIGHTCACHEHASH(x, y)];
-    if(lce.x == x && lce.y == y) return lce.lights;
+    if(lightbins.dirty || lightbins.dim != max(worldsize >> lightbins.cellbits, 1)) lightbins.build(entities::getents(), worldsize, lightgridsize);
+}
 
-    lce.lights.setsize(0);
-    int csize = 1<<lightcachesize, cx = x<<lightcachesize, cy = y<<lightcachesize;
-    const vector<extentity *> &ents = entities::getents();
-    loopv(ents)
-    {
-        const extentity &light = *ents[i];
-        switch(light.type)
-        {
-            case ET_LIGHT:
-            {
-                int radius = light.attr1;
-                if(radius <= 0 ||
-                   light.o.x + radius < cx || light.o.x - radius > cx + csize ||
-                   light.o.y + radius < cy || light.o.y - radius > cy + csize)
-                    continue;
-                break;
-            }
-            default: continue;
-        }
-        lce.lights.add(i);
-    }
+const int *checklightcache(int x, int y, int &numlights)
+{
+    checklightgrid();
+    return lightbins.lookup(x, y, numlights);
+}
 
-    lce.x = x;
-    lce.y = y;
-    return lce.lights;
+void findlights(const vec &bbmin, const vec &bbmax, vector<int> &found)
+{
+    checklightgrid();
+    lightbins.find(entities::getents(), bbmin, bbmax, found);
 }
 
 static uint lightprogress = 0;
@@ -339,11 +304,88 @@ void check_calclight_canceled()
 {
     if(interceptkey(SDLK_ESCAPE))
     {
-        calclight_canceled = true;
+        atomicstore(calclight_canceled, true);
     }
     if(!calclight_canceled) check_calclight_progress = false;
 }
 
+VARP(lightthreads, 0, 0, 16);
+
+static vector<lighttask> *lighttasks = NULL;
+static int nextlighttask = 0;
+static void (*lighttaskwork)(lighttask &) = NULL;
+
+static int lightworker(void *data)
+{
+    profilethread("light worker");
+    for(;;)
+    {
+        int i = atomicadd(nextlighttask, 1) - 1;
+        if(i >= lighttasks->length()) break;
+        lighttask &t = (*lighttasks)[i];
+        if(!atomicload(calclight_canceled))
+        {
+            PROFILE("light task");
+            lighttaskwork(t);
+        }
+        atomicstore(t.done, 1);
+    }
+    profilethreaddone();
+    return 0;
+}
+
+void genlighttasks(vector<lighttask> &tasks, cube *c, const ivec &co, int size, int depth)
+{
+    loopi(8)
+    {
+        ivec o(i, co, size);
+        if(c[i].children && depth > 0) genlighttasks(tasks, c[i].children, o, size >> 1, depth - 1);
+        else
+        {
+            lighttask &t = tasks.add();
+            t.c = &c[i];
+            t.o = o;
+            t.size = size;
+            t.id = tasks.length() - 1;
+            t.done = 0;
+        }
+    }
+}
+
+// work runs on the worker threads and must only touch the task's own subtree, finish runs on the main thread in task order
+void runlighttasks(vector<lighttask> &tasks, void (*work)(lighttask &), void (*finish)(lighttask &), void (*progress)())
+{
+    int numthreads = min(lightthreads > 0 ? lightthreads : numcpus, tasks.length());
+    if(numthreads <= 1)
+    {
+        loopv(tasks)
+        {
+            CHECK_CALCLIGHT_PROGRESS(return, progress);
+            work(tasks[i]);
+            if(finish) finish(tasks[i]);
+        }
+        return;
+    }
+
+    lighttasks = &tasks;
+    nextlighttask = 0;
+    lighttaskwork = work;
+    vector<SDL_Thread *> threads;
+    loopi(numthreads) threads.add(SDL_CreateThread(lightworker, "light worker", NULL));
+    loopv(tasks)
+    {
+        while(!atomicload(tasks[i].done))
+        {
+            SDL_Delay(1);
+            CHECK_CALCLIGHT_PROGRESS(, progress);
+        }
+        if(finish && !calclight_canceled) finish(tasks[i]);
+    }
+    loopv(threads) SDL_WaitThread(threads[i], NULL);
+    lighttasks = NULL;
+    lighttaskwork = NULL;
+}
+
 void show_calclight_progress()
 {
     float bar1 = float(lightprogress) / float(allocnodes);
@@ -475,6 +517,7 @@ static void calcsurfaces(cube &c, const ivec &co, int size, int usefacemask, int
         surfaceinfo &surf = surfaces[k];
         if(surf.used())
         {
+            // other light workers may be growing their own cubes' extensions at the same time, growcubeext and setcubeext lock the shared pools for this
             cubeext *ext = c.ext && c.ext->maxverts >= numlitverts ? c.ext : growcubeext(c.ext, numlitverts);
             memcpy(ext->surfaces, surfaces, sizeof(ext->surfaces));
             memcpy(ext->verts(), litverts, numlitverts*sizeof(vertinfo));
@@ -484,33 +527,44 @@ static void calcsurfaces(cube &c, const ivec &co, int size, int usefacemask, int
     }
 }
 
+static void calcleafsurfaces(cube &c, const ivec &o, int size)
+{
+    if(isempty(c)) return;
+    if(c.ext)
+    {
+        loopj(6) c.ext->surfaces[j].clear();
+    }
+    int usefacemask = 0;
+    loopj(6) if(c.texture[j] != DEFAULT_SKY && (!(c.merged&(1<<j)) || (c.ext && c.ext->surfaces[j].numverts&MAXFACEVERTS)))
+    {
+        usefacemask |= visibletris(c, j, o, size)<<(4*j);
+    }
+    if(usefacemask) calcsurfaces(c, o, size, usefacemask);
+}
+
 static void calcsurfaces(cube *c, const ivec &co, int size)
 {
-    CHECK_CALCLIGHT_PROGRESS(return, show_calclight_progress);
+    if(atomicload(calclight_canceled)) return;
 
-    lightprogress++;
+    atomicadd(lightprogress, 1U);
 
     loopi(8)
     {
         ivec o(i, co, size);
         if(c[i].children)
             calcsurfaces(c[i].children, o, size >> 1);
-        else if(!isempty(c[i]))
-        {
-            if(c[i].ext)
-            {
-                loopj(6) c[i].ext->surfaces[j].clear();
-            }
-            int usefacemask = 0;
-            loopj(6) if(c[i].texture[j] != DEFAULT_SKY && (!(c[i].merged&(1<<j)) || (c[i].ext && c[i].ext->surfaces[j].numverts&MAXFACEVERTS)))
-            {
-                usefacemask |= visibletris(c[i], j, o, size)<<(4*j);
-            }
-            if(usefacemask) calcsurfaces(c[i], o, size, usefacemask);
-        }
+        else calcleafsurfaces(c[i], o, size);
     }
 }
 
+// surfaces only depend on the cube's own geometry and read-only neighbour/normal lookups, so subtrees can be lit in any order
+// besides its own cube a worker only writes the shared extension pools, when the cube's extension has to grow
+static void calcsurfacestask(lighttask &t)
+{
+    if(t.c->children) calcsurfaces(t.c->children, t.o, t.size >> 1);
+    else calcleafsurfaces(*t.c, t.o, t.size);
+}
+
 static inline bool previewblends(cube &c, const ivec &o, int size)
 {
     if(isempty(c) || c.material&MAT_ALPHA) return false;
@@ -589,7 +643,9 @@ void calclight()
     SDL_TimerID timer = SDL_AddTimer(250, calclighttimer, NULL);
     Uint32 start = SDL_GetTicks();
     calcnormals(filltjoints > 0);
-    calcsurfaces(worldroot, ivec(0, 0, 0), worldsize >> 1);
+    vector<lighttask> tasks;
+    genlighttasks(tasks, worldroot, ivec(0, 0, 0), worldsize >> 1);
+    runlighttasks(tasks, calcsurfacestask, NULL, show_calclight_progress);
     clearnormals();
     Uint32 end = SDL_GetTicks();
     if(timer) SDL_RemoveTimer(timer);
@@ -640,8 +696,9 @@ void lightreaching(const vec &target, vec &color, vec &dir, bool fast, extentity
 
     color = dir = vec(0, 0, 0);
     const vector<extentity *> &ents = entities::getents();
-    const vector<int> &lights = checklightcache(int(target.x), int(target.y));
-    loopv(lights)
+    int numlights;
+    const int *lights = checklightcache(int(target.x), int(target.y), numlights);
+    loopi(numlights)
     {
         extentity &e = *ents[lights[i]];
         if(e.type != ET_LIGHT || e.attr1 <= 0)
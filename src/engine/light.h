@@ -82,5 +82,16 @@ extern volatile bool check_calclight_progress;
 
 extern void check_calclight_canceled();
 
-extern const vector<int> &checklightcache(int x, int y);
+struct lighttask
+{
+    cube *c;
+    ivec o;
+    int size, id, done;
+};
+
+extern void genlighttasks(vector<lighttask> &tasks, cube *c, const ivec &co, int size, int depth = 2);
+extern void runlighttasks(vector<lighttask> &tasks, void (*work)(lighttask &), void (*finish)(lighttask &), void (*progress)());
+
+extern const int *checklightcache(int x, int y, int &numlights);
+extern void findlights(const vec &bbmin, const vec &bbmax, vector<int> &found);
 
@@ -0,0 +1,174 @@
+// lightbench.cpp: bins synthetic light layouts headlessly to compare the light grid with the old per-cell entity scan
+// point queries stand in for lightreaching, region queries for the renderer's light collection
+
+#include "cube.h"
+#include "lightgrid.h"
+
+static int numlights = 500, numents = 4000, benchsize = 4096, numqueries = 1000000, gridsize = 6, numclusters = 0;
+
+// the lightcache this grid replaced: a 1024 entry hash of cells, each miss rescanning every entity
+#define LIGHTCACHESIZE 1024
+
+static struct lightcacheentry
+{
+    int x, y;
+    vector<int> lights;
+} lightcache[LIGHTCACHESIZE];
+
+#define LIGHTCACHEHASH(x, y) (((((x)^(y))<<5) + (((x)^(y))>>5)) & (LIGHTCACHESIZE - 1))
+
+static const vector<int> &checklightcache(const vector<extentity *> &ents, int x, int y)
+{
+    x >>= gridsize;
+    y >>= gridsize;
+    lightcacheentry &lce = lightcache[LIGHTCACHEHASH(x, y)];
+    if(lce.x == x && lce.y == y) return lce.lights;
+
+    lce.lights.setsize(0);
+    int csize = 1<<gridsize, cx = x<<gridsize, cy = y<<gridsize;
+    loopv(ents)
+    {
+        const extentity &light = *ents[i];
+        if(light.type != ET_LIGHT) continue;
+        int radius = light.attr1;
+        if(radius <= 0 ||
+           light.o.x + radius < cx || light.o.x - radius > cx + csize ||
+           light.o.y + radius < cy || light.o.y - radius > cy + csize)
+            continue;
+        lce.lights.add(i);
+    }
+
+    lce.x = x;
+    lce.y = y;
+    return lce.lights;
+}
+
+static void genlayout(vector<extentity *> &ents)
+{
+    vector<vec> clusters;
+    loopi(numclusters) clusters.add(vec(rndscale(benchsize), rndscale(benchsize), rndscale(benchsize/4)));
+    loopi(numents)
+    {
+        extentity *e = new extentity;
+        e->type = i < numlights ? ET_LIGHT : ET_MAPMODEL;
+        if(clusters.length()) e->o = vec(clusters[rnd(clusters.length())]).add(vec(rndscale(256)-128, rndscale(256)-128, rndscale(64)));
+        else e->o = vec(rndscale(benchsize), rndscale(benchsize), rndscale(benchsize/4));
+        e->attr1 = e->type == ET_LIGHT ? 32 + rnd(224) : 0;
+        ents.add(e);
+    }
+    // lights are interleaved with other entities in real maps
+    loopv(ents) swap(ents[i], ents[rnd(ents.length())]);
+}
+
+// moves lights around the way editing does, patching the grid, and checks every cell against a fresh build
+static void benchupdates(vector<extentity *> &ents, lightgrid &grid, int numupdates)
+{
+    vector<int> lightids;
+    loopv(ents) if(ents[i]->type == ET_LIGHT) lightids.add(i);
+    if(lightids.empty()) return;
+    grid.build(ents, benchsize, gridsize);
+    int rebuilds = 0;
+    uint start = getclockmicros();
+    loopi(numupdates)
+    {
+        int id = lightids[rnd(lightids.length())];
+        extentity &e = *ents[id];
+        grid.update(ents, id, false);
+        e.o.add(vec(rndscale(256)-128, rndscale(256)-128, 0)).max(0).min(benchsize-1);
+        e.attr1 = 32 + rnd(224);
+        grid.update(ents, id, true);
+        if(grid.dirty) { grid.build(ents, benchsize, gridsize); rebuilds++; }
+    }
+    double updatemillis = (getclockmicros() - start)/1000.0;
+
+    lightgrid fresh;
+    fresh.build(ents, benchsize, gridsize);
+    loopi(grid.dim*grid.dim)
+    {
+        int n, m;
+        const int *a = grid.celllights(i, n), *b = fresh.celllights(i, m);
+        if(n != m || memcmp(a, b, n*sizeof(int))) fatal("patched cell %d differs from a fresh build", i);
+    }
+    if(grid.lights.length() != fresh.lights.length() || memcmp(grid.lights.getbuf(), fresh.lights.getbuf(), grid.lights.length()*sizeof(int)))
+        fatal("patched light list differs from a fresh build");
+    printf("lightgrid: %.1f us/light edit, %d rebuilds in %d edits, %d patched cells\n",
+        updatemillis*1000.0/numupdates, rebuilds, numupdates, grid.patches.length());
+}
+
+static bool loadoption(const char *arg)
+{
+    if(arg[0] != '-') return false;
+    switch(arg[1])
+    {
+        case 'l': numlights = max(atoi(&arg[2]), 0); return true;
+        case 'e': numents = max(atoi(&arg[2]), 0); return true;
+        case 'w': benchsize = 1<<clamp(atoi(&arg[2]), 10, 16); return true;
+        case 'q': numqueries = max(atoi(&arg[2]), 1); return true;
+        case 'g': gridsize = clamp(atoi(&arg[2]), 4, 12); return true;
+        case 'c': numclusters = max(atoi(&arg[2]), 0); return true;
+    }
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    for(int i = 1; i < argc; i++) if(!loadoption(argv[i]))
+    {
+        printf("usage: tess_lightbench [-lLIGHTS] [-eENTITIES] [-wWORLDSCALE] [-qQUERIES] [-gGRIDSIZE] [-cCLUSTERS]\n");
+        return EXIT_FAILURE;
+    }
+    numents = max(numents, numlights);
+    seedMT(1);
+
+    vector<extentity *> ents;
+    genlayout(ents);
+    vector<vec> points;
+    loopi(numqueries) points.add(vec(rndscale(benchsize), rndscale(benchsize), 0));
+    printf("%d lights among %d entities, world size %d, %d queries%s\n", numlights, numents, benchsize, numqueries, numclusters ? " (clustered)" : "");
+
+    loopi(LIGHTCACHESIZE) lightcache[i].x = -1;
+    uint start = getclockmicros();
+    uint oldsum = 0;
+    loopv(points) oldsum += checklightcache(ents, int(points[i].x), int(points[i].y)).length();
+    double oldmillis = (getclockmicros() - start)/1000.0;
+
+    lightgrid grid;
+    start = getclockmicros();
+    const int builds = 100;
+    loopi(builds) grid.build(ents, benchsize, gridsize);
+    double buildmillis = (getclockmicros() - start)/1000.0/builds;
+
+    start = getclockmicros();
+    uint gridsum = 0;
+    loopv(points)
+    {
+        int n;
+        grid.lookup(int(points[i].x), int(points[i].y), n);
+        gridsum += n;
+    }
+    double gridmillis = (getclockmicros() - start)/1000.0;
+
+    vector<int> found;
+    int regions = max(numqueries/100, 1);
+    uint regionsum = 0;
+    start = getclockmicros();
+    loopi(regions)
+    {
+        const vec &p = points[i];
+        found.setsize(0);
+        grid.find(ents, vec(p).sub(1024), vec(p).add(1024), found);
+        regionsum += found.length();
+    }
+    double regionmillis = (getclockmicros() - start)/1000.0;
+
+    printf("lightcache: %.0f lookups/sec, %.1f lights/lookup\n", numqueries*1000.0/max(oldmillis, 1e-3), oldsum/double(numqueries));
+    printf("lightgrid: %.0f lookups/sec, %.1f lights/lookup, %dx%d cells, %d binned indices, %.3f ms/build\n",
+        numqueries*1000.0/max(gridmillis, 1e-3), gridsum/double(numqueries), grid.dim, grid.dim, grid.indices.length(), buildmillis);
+    printf("lightgrid: %.0f region queries/sec, %.1f lights/region\n", regions*1000.0/max(regionmillis, 1e-3), regionsum/double(regions));
+
+    benchupdates(ents, grid, 1000);
+
+    ents.deletecontents();
+    return EXIT_SUCCESS;
+}
+
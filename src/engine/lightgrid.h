@@ -0,0 +1,143 @@
+// lightgrid.h: uniform 2D grid binning light entities by their radius of influence
+// each cell keeps a compact, ascending list of the lights that reach it
+// editing a light only patches the cells it covers, and the grid is rebuilt once the patched cells pile up
+
+#define MAXLIGHTGRIDDIM 256
+
+struct lightgrid
+{
+    int cellbits, dim;
+    vector<int> cells;   // dim*dim+1 offsets into indices
+    vector<int> indices;
+    vector<int> lights;  // every binned light
+    vector<uint> stamps; // per entity, to report each light once per region query
+    vector<int> patchcells;         // per cell, the index of its patched list or -1
+    vector<vector<int> > patches;
+    uint stamp;
+    bool dirty;
+
+    lightgrid() : cellbits(0), dim(0), stamp(0), dirty(true) {}
+
+    static bool binned(const extentity &e) { return e.type == ET_LIGHT && e.attr1 > 0; }
+
+    void cellrange(const extentity &e, int &x1, int &y1, int &x2, int &y2) const
+    {
+        float radius = e.attr1;
+        x1 = clamp(int(floor(e.o.x - radius)) >> cellbits, 0, dim-1);
+        y1 = clamp(int(floor(e.o.y - radius)) >> cellbits, 0, dim-1);
+        x2 = clamp(int(floor(e.o.x + radius)) >> cellbits, 0, dim-1);
+        y2 = clamp(int(floor(e.o.y + radius)) >> cellbits, 0, dim-1);
+    }
+
+    void build(const vector<extentity *> &ents, int worldsize, int size)
+    {
+        cellbits = size;
+        while((worldsize >> cellbits) > MAXLIGHTGRIDDIM) cellbits++;
+        dim = max(worldsize >> cellbits, 1);
+
+        // count lights per cell, turn the counts into offsets, then scatter in entity order
+        cells.setsize(0);
+        loopi(dim*dim + 1) cells.add(0);
+        lights.setsize(0);
+        loopv(ents) if(binned(*ents[i]))
+        {
+            lights.add(i);
+            int x1, y1, x2, y2;
+            cellrange(*ents[i], x1, y1, x2, y2);
+            for(int y = y1; y <= y2; y++) for(int x = x1; x <= x2; x++) cells[y*dim + x + 1]++;
+        }
+        loopi(dim*dim) cells[i+1] += cells[i];
+        indices.setsize(0);
+        indices.pad(cells.last());
+        vector<int> fill;
+        fill.put(cells.getbuf(), dim*dim);
+        loopv(lights)
+        {
+            int x1, y1, x2, y2;
+            cellrange(*ents[lights[i]], x1, y1, x2, y2);
+            for(int y = y1; y <= y2; y++) for(int x = x1; x <= x2; x++) indices[fill[y*dim + x]++] = lights[i];
+        }
+        patchcells.setsize(0);
+        loopi(dim*dim) patchcells.add(-1);
+        patches.setsize(0);
+        dirty = false;
+    }
+
+    static void patchlist(vector<int> &list, int id, bool add)
+    {
+        int lo = 0, hi = list.length();
+        while(lo < hi)
+        {
+            int mid = (lo + hi)/2;
+            if(list[mid] < id) lo = mid + 1;
+            else hi = mid;
+        }
+        bool found = lo < list.length() && list[lo] == id;
+        if(add && !found) list.insert(lo, id);
+        else if(!add && found) list.remove(lo);
+    }
+
+    // adds or removes one light in the cells it covers, which is called with a light's old state and then its new one
+    void update(const vector<extentity *> &ents, int id, bool add)
+    {
+        if(dirty || !binned(*ents[id])) return;
+        int x1, y1, x2, y2;
+        cellrange(*ents[id], x1, y1, x2, y2);
+        // once the patches hold a good share of the cells, one rebuild is cheaper than walking them all
+        if(patches.length() + (x2 - x1 + 1)*(y2 - y1 + 1) > dim*dim/4) { dirty = true; return; }
+        for(int y = y1; y <= y2; y++) for(int x = x1; x <= x2; x++)
+        {
+            int cell = y*dim + x;
+            if(patchcells[cell] < 0)
+            {
+                patchcells[cell] = patches.length();
+                patches.add().put(indices.getbuf() + cells[cell], cells[cell+1] - cells[cell]);
+            }
+            patchlist(patches[patchcells[cell]], id, add);
+        }
+        patchlist(lights, id, add);
+    }
+
+    const int *celllights(int cell, int &numlights) const
+    {
+        int patch = patchcells[cell];
+        if(patch >= 0)
+        {
+            numlights = patches[patch].length();
+            return patches[patch].getbuf();
+        }
+        numlights = cells[cell+1] - cells[cell];
+        return indices.getbuf() + cells[cell];
+    }
+
+    const int *lookup(int x, int y, int &numlights) const
+    {
+        return celllights(clamp(y >> cellbits, 0, dim-1)*dim + clamp(x >> cellbits, 0, dim-1), numlights);
+    }
+
+    // lights whose cells overlap the box, in ascending entity order
+    void find(const vector<extentity *> &ents, const vec &bbmin, const vec &bbmax, vector<int> &found)
+    {
+        int x1 = clamp(int(floor(bbmin.x)) >> cellbits, 0, dim-1), y1 = clamp(int(floor(bbmin.y)) >> cellbits, 0, dim-1),
+            x2 = clamp(int(floor(bbmax.x)) >> cellbits, 0, dim-1), y2 = clamp(int(floor(bbmax.y)) >> cellbits, 0, dim-1);
+        if((x2 - x1 + 1)*(y2 - y1 + 1)*2 >= dim*dim) { found.put(lights.getbuf(), lights.length()); return; }
+        int grow = ents.length() - stamps.length();
+        if(grow > 0) memset(stamps.pad(grow), 0, grow*sizeof(uint));
+        if(!++stamp) { memset(stamps.getbuf(), 0, stamps.length()*sizeof(uint)); stamp = 1; }
+        int start = found.length();
+        for(int y = y1; y <= y2; y++) for(int x = x1; x <= x2; x++)
+        {
+            int numlights;
+            const int *celllist = celllights(y*dim + x, numlights);
+            loopi(numlights)
+            {
+                int idx = celllist[i];
+                if(stamps[idx] == stamp) continue;
+                stamps[idx] = stamp;
+                found.add(idx);
+            }
+        }
+        found.sort(sortless(), start);
+    }
+};
+
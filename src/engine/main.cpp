@@ -14,6 +14,7 @@ void cleanup()
     if(screen) SDL_SetWindowGrab(screen, SDL_FALSE);
     cleargamma();
     freeocta(worldroot);
+    trimoctapools();
     UI::cleanup();
     extern void clear_command(); clear_command();
     extern void clear_console(); clear_console();
@@ -731,6 +732,7 @@ static void checkmousemotion(int &dx, int &dy)
 
 void checkinput()
 {
+    PROFILE("input");
     SDL_Event event;
     //int lasttype = 0, lastbut = 0;
     bool mousemoved = false;
@@ -839,6 +841,7 @@ void checkinput()
 
 void swapbuffers(bool overlay)
 {
+    PROFILE("swap");
     recorder::capture(overlay);
     vr::submitrender();
     gle::disable();
@@ -1015,8 +1018,86 @@ int getclockmillis()
     return max(millis, totalmillis);
 }
 
+// wall clock for profiling short spans of work, wraps after about 71 minutes
+uint getclockmicros()
+{
+    static Uint64 freq = SDL_GetPerformanceFrequency();
+    Uint64 ticks = SDL_GetPerformanceCounter();
+    return uint((ticks/freq)*1000000 + ((ticks%freq)*1000000)/freq);
+}
+
 VAR(numcpus, 1, 1, 16);
 
+// with simthread on, game::simulateworld is overlapped with presenting the frame: it runs on its own thread while the
+// main thread swaps and sleeps in limitfps, and is joined before the next frame starts
+// this is not a fixed rate simulation, a frame still pays for any simulation that outlasts the swap and sleep,
+// and what is drawn lags the input by a frame, so simoverlap reports how much of the simulation was actually hidden
+VARP(simthread, 0, 1, 1);
+
+static SDL_Thread *simthreadid = NULL;
+static SDL_mutex *simlock = NULL;
+static SDL_cond *simstart = NULL, *simdone = NULL;
+static bool simpending = false, simasync = false;
+static uint simmicros = 0, simwaitmicros = 0, simframes = 0;
+
+static int simworker(void *data)
+{
+    profilethread("sim thread", true);
+    SDL_LockMutex(simlock);
+    for(;;)
+    {
+        while(!simpending) SDL_CondWait(simstart, simlock);
+        SDL_UnlockMutex(simlock);
+        uint start = getclockmicros();
+        game::simulateworld();
+        uint elapsed = getclockmicros() - start;
+        SDL_LockMutex(simlock);
+        simmicros += elapsed;
+        simframes++;
+        simpending = false;
+        SDL_CondSignal(simdone);
+    }
+    return 0;
+}
+
+static void startsimulation()
+{
+    if(!simthreadid)
+    {
+        simlock = SDL_CreateMutex();
+        simstart = SDL_CreateCond();
+        simdone = SDL_CreateCond();
+        simthreadid = SDL_CreateThread(simworker, "sim thread", NULL);
+        if(!simthreadid) { simthread = 0; game::simulateworld(); return; }
+    }
+    SDL_LockMutex(simlock);
+    simpending = true;
+    SDL_CondSignal(simstart);
+    SDL_UnlockMutex(simlock);
+}
+
+static void finishsimulation()
+{
+    if(!simasync) return;
+    simasync = false;
+    PROFILE("sim wait");
+    uint start = getclockmicros();
+    SDL_LockMutex(simlock);
+    while(simpending) SDL_CondWait(simdone, simlock);
+    SDL_UnlockMutex(simlock);
+    simwaitmicros += getclockmicros() - start;
+}
+
+// the simulation time and the part of it the main thread still waited for, per frame since the last report
+void simoverlap()
+{
+    if(!simframes) { conoutf("no simulation has run on the sim thread"); return; }
+    conoutf("simulation: %.1f us/frame, %.1f us/frame waited, %.0f%% overlapped with present",
+        simmicros/float(simframes), simwaitmicros/float(simframes), 100.0f*(1 - min(simwaitmicros/float(max(simmicros, 1U)), 1.0f)));
+    simmicros = simwaitmicros = simframes = 0;
+}
+COMMAND(simoverlap, "");
+
 int main(int argc, char **argv)
 {
     #ifdef WIN32
@@ -1190,6 +1271,7 @@ int main(int argc, char **argv)
         static int frames = 0;
         int millis = getclockmillis();
         limitfps(millis, totalmillis);
+        finishsimulation();
         elapsedtime = millis - totalmillis;
         static int timeerr = 0;
         int scaledtime = game::scaletime(elapsedtime) + timeerr;
@@ -1200,6 +1282,7 @@ int main(int argc, char **argv)
         lastmillis += curtime;
         totalmillis = millis;
         updatetime();
+        profileframe();
 
         vr::update();
         checkinput();
@@ -1207,7 +1290,12 @@ int main(int argc, char **argv)
         menuprocess();
         tryedit();
 
-        if(lastmillis) game::updateworld();
+        if(lastmillis)
+        {
+            simasync = simthread && numcpus > 1 && !minimized;
+            if(!simasync) game::simulateworld();
+            game::updateworld();
+        }
 
         checksleep(lastmillis);
 
@@ -1228,6 +1316,7 @@ int main(int argc, char **argv)
         inbetweenframes = false;
 
         gl_drawframe();
+        if(simasync) startsimulation();
         swapbuffers();
         renderedframe = inbetweenframes = true;
     }
@@ -9,6 +9,10 @@
 #include "cube.h"
 #include <signal.h>
 #include <enet/time.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#define USE_EPOLL
+#endif
 
 #define INPUT_LIMIT 4096
 #define OUTPUT_LIMIT (64*1024)
@@ -23,6 +27,8 @@
 #define KEEPALIVE_TIME (65*60*1000)
 #define SERVER_LIMIT 4096
 #define SERVER_DUP_LIMIT 10
+#define SWEEP_TIME 1000
+#define MAXEVENTS 256
 
 FILE *logfile = NULL;
 
@@ -129,17 +135,20 @@ struct client
     char input[INPUT_LIMIT];
     messagebuf *message;
     vector<char> output;
-    int inputpos, outputpos;
+    int index, inputpos, outputpos, messagepos;
     enet_uint32 connecttime, lastinput;
     int servport;
     enet_uint32 lastauth;
     vector<authreq> authreqs;
     bool shouldpurge;
     bool registeredserver;
+    bool active, readable, writable, hangup;
+
+    client() : message(NULL), index(-1), inputpos(0), outputpos(0), messagepos(0), servport(-1), lastauth(0), shouldpurge(false), registeredserver(false), active(false), readable(false), writable(false), hangup(false) {}
 
-    client() : message(NULL), inputpos(0), outputpos(0), servport(-1), lastauth(0), shouldpurge(false), registeredserver(false) {}
+    bool pending() const { return message || output.length(); }
 };
-vector<client *> clients;
+vector<client *> clients, activeclients;
 
 ENetSocket serversocket = ENET_SOCKET_NULL;
 
@@ -182,15 +191,33 @@ void purgeclient(int n)
 {
     client &c = *clients[n];
     if(c.message) c.message->purge();
+    if(c.active) activeclients.removeobj(&c);
     enet_socket_destroy(c.socket);
     delete clients[n];
-    clients.remove(n);
+    clients.removeunordered(n);
+    if(clients.inrange(n)) clients[n]->index = n;
+}
+
+void activateclient(client &c)
+{
+    if(c.active) return;
+    c.active = true;
+    activeclients.add(&c);
+}
+
+void queuemessage(client &c, messagebuf *m)
+{
+    c.message = m;
+    c.message->refs++;
+    c.messagepos = 0;
+    activateclient(c);
 }
 
 void output(client &c, const char *msg, int len = 0)
 {
     if(!len) len = strlen(msg);
     c.output.put(msg, len);
+    activateclient(c);
 }
 
 void outputf(client &c, const char *fmt, ...)
@@ -212,6 +239,86 @@ bool setuppingsocket(ENetAddress *address)
     return true;
 }
 
+#ifdef USE_EPOLL
+int epollfd = -1;
+
+bool setuppoll()
+{
+    epollfd = epoll_create(MAXEVENTS);
+    if(epollfd < 0) return false;
+    epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = &serversocket;
+    if(epoll_ctl(epollfd, EPOLL_CTL_ADD, serversocket, &ev) < 0) return false;
+    ev.data.ptr = &pingsocket;
+    if(epoll_ctl(epollfd, EPOLL_CTL_ADD, pingsocket, &ev) < 0) return false;
+    return true;
+}
+
+bool watchclient(client &c)
+{
+    epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = &c;
+    return epoll_ctl(epollfd, EPOLL_CTL_ADD, c.socket, &ev) >= 0;
+}
+
+// edge-triggered: readiness stays set on the client until a read or write comes up short
+void pollclients(int timeout, bool &acceptready, bool &pingready)
+{
+    static epoll_event events[MAXEVENTS];
+    int numevents = epoll_wait(epollfd, events, MAXEVENTS, timeout);
+    loopi(numevents)
+    {
+        epoll_event &ev = events[i];
+        if(ev.data.ptr == &serversocket) acceptready = true;
+        else if(ev.data.ptr == &pingsocket) pingready = true;
+        else
+        {
+            client &c = *(client *)ev.data.ptr;
+            if(ev.events&EPOLLIN) c.readable = true;
+            if(ev.events&EPOLLOUT) c.writable = true;
+            if(ev.events&(EPOLLRDHUP|EPOLLHUP|EPOLLERR)) c.hangup = true;
+            activateclient(c);
+        }
+    }
+}
+#else
+bool setuppoll() { return true; }
+bool watchclient(client &c) { return true; }
+
+void pollclients(int timeout, bool &acceptready, bool &pingready)
+{
+    ENetSocketSet readset, writeset;
+    ENetSocket maxsock = max(serversocket, pingsocket);
+    ENET_SOCKETSET_EMPTY(readset);
+    ENET_SOCKETSET_EMPTY(writeset);
+    ENET_SOCKETSET_ADD(readset, serversocket);
+    ENET_SOCKETSET_ADD(readset, pingsocket);
+    loopv(clients)
+    {
+        client &c = *clients[i];
+        if(c.pending()) ENET_SOCKETSET_ADD(writeset, c.socket);
+        else ENET_SOCKETSET_ADD(readset, c.socket);
+        maxsock = max(maxsock, c.socket);
+    }
+    if(enet_socketset_select(maxsock, &readset, &writeset, timeout)<=0) return;
+
+    if(ENET_SOCKETSET_CHECK(readset, pingsocket)) pingready = true;
+    if(ENET_SOCKETSET_CHECK(readset, serversocket)) acceptready = true;
+    loopv(clients)
+    {
+        client &c = *clients[i];
+        if(c.pending() ? ENET_SOCKETSET_CHECK(writeset, c.socket) : ENET_SOCKETSET_CHECK(readset, c.socket))
+        {
+            if(c.pending()) c.writable = true;
+            else c.readable = true;
+            activateclient(c);
+        }
+    }
+}
+#endif
+
 void setupserver(int port, const char *ip = NULL)
 {
     ENetAddress address;
@@ -233,6 +340,8 @@ void setupserver(int port, const char *ip = NULL)
         fatal("failed to make server socket non-blocking");
     if(!setuppingsocket(&address))
         fatal("failed to create ping socket");
+    if(!setuppoll())
+        fatal("failed to create poll set");
 
     enet_time_set(0);
 
@@ -289,11 +398,7 @@ void gengbanlist()
     loopv(clients)
     {
         client &c = *clients[i];
-        if(c.servport >= 0 && !c.message)
-        {
-            c.message = l;
-            c.message->refs++;
-        }
+        if(c.servport >= 0 && !c.message) queuemessage(c, l);
     }
 }
 
@@ -373,11 +478,7 @@ void checkserverpongs()
                     {
                         c->registeredserver = true;
                         outputf(*c, "succreg\n");
-                        if(!c->message && gbanlists.length())
-                        {
-                            c->message = gbanlists.last();
-                            c->message->refs++;
-                        }
+                        if(!c->message && gbanlists.length()) queuemessage(*c, gbanlists.last());
                     }
                 }
                 if(!s.lastpong) updateserverlist = true;
@@ -544,10 +645,9 @@ bool checkclientinput(client &c)
         {
             genserverlist();
             if(gameserverlists.empty() || c.message) return false;
-            c.message = gameserverlists.last();
-            c.message->refs++;
             c.output.setsize(0);
             c.outputpos = 0;
+            queuemessage(c, gameserverlists.last());
             c.shouldpurge = true;
             return true;
         }
@@ -574,103 +674,160 @@ bool checkclientinput(client &c)
 
         end = (char *)memchr(c.input, '\n', c.inputpos);
     }
-    return c.inputpos<(int)sizeof(c.input);
+    return c.inputpos<(int)sizeof(c.input)-1;
 }
 
-ENetSocketSet readset, writeset;
-
-void checkclients()
+void acceptclients()
 {
-    ENetSocketSet readset, writeset;
-    ENetSocket maxsock = max(serversocket, pingsocket);
-    ENET_SOCKETSET_EMPTY(readset);
-    ENET_SOCKETSET_EMPTY(writeset);
-    ENET_SOCKETSET_ADD(readset, serversocket);
-    ENET_SOCKETSET_ADD(readset, pingsocket);
-    loopv(clients)
-    {
-        client &c = *clients[i];
-        if(c.authreqs.length()) purgeauths(c);
-        if(c.message || c.output.length()) ENET_SOCKETSET_ADD(writeset, c.socket);
-        else ENET_SOCKETSET_ADD(readset, c.socket);
-        maxsock = max(maxsock, c.socket);
-    }
-    if(enet_socketset_select(maxsock, &readset, &writeset, 1000)<=0) return;
-
-    if(ENET_SOCKETSET_CHECK(readset, pingsocket)) checkserverpongs();
-    if(ENET_SOCKETSET_CHECK(readset, serversocket))
+    for(;;)
     {
         ENetAddress address;
         ENetSocket clientsocket = enet_socket_accept(serversocket, &address);
-        if(clients.length()>=CLIENT_LIMIT || checkban(bans, address.host)) enet_socket_destroy(clientsocket);
-        else if(clientsocket!=ENET_SOCKET_NULL)
+        if(clientsocket==ENET_SOCKET_NULL) break;
+        if(clients.length()>=CLIENT_LIMIT || checkban(bans, address.host)) { enet_socket_destroy(clientsocket); continue; }
+
+        int dups = 0, oldest = -1;
+        loopv(clients) if(clients[i]->address.host == address.host)
         {
-            int dups = 0, oldest = -1;
-            loopv(clients) if(clients[i]->address.host == address.host)
-            {
-                dups++;
-                if(oldest<0 || clients[i]->connecttime < clients[oldest]->connecttime) oldest = i;
-            }
-            if(dups >= DUP_LIMIT) purgeclient(oldest);
-
-            client *c = new client;
-            c->address = address;
-            c->socket = clientsocket;
-            c->connecttime = servtime;
-            c->lastinput = servtime;
-            clients.add(c);
+            dups++;
+            if(oldest<0 || clients[i]->connecttime < clients[oldest]->connecttime) oldest = i;
         }
+        if(dups >= DUP_LIMIT) purgeclient(oldest);
+
+        client *c = new client;
+        c->address = address;
+        c->socket = clientsocket;
+        c->connecttime = servtime;
+        c->lastinput = servtime;
+        if(enet_socket_set_option(clientsocket, ENET_SOCKOPT_NONBLOCK, 1)<0 || !watchclient(*c))
+        {
+            enet_socket_destroy(clientsocket);
+            delete c;
+            continue;
+        }
+        c->index = clients.length();
+        clients.add(c);
     }
+}
 
-    loopv(clients)
+// sends the private output and the shared message with a single scatter write; a partially sent message is finished first so its lines are not split
+bool flushclient(client &c)
+{
+    while(c.pending())
     {
-        client &c = *clients[i];
-        if((c.message || c.output.length()) && ENET_SOCKETSET_CHECK(writeset, c.socket))
+        ENetBuffer bufs[2];
+        int numbufs = 0, outputlen = c.output.length() - c.outputpos, messagelen = c.message ? c.message->length() - c.messagepos : 0;
+        bool messagefirst = c.messagepos > 0;
+        if(messagefirst && messagelen > 0) { bufs[numbufs].data = (void *)&c.message->getbuf()[c.messagepos]; bufs[numbufs].dataLength = messagelen; numbufs++; }
+        if(outputlen > 0) { bufs[numbufs].data = &c.output[c.outputpos]; bufs[numbufs].dataLength = outputlen; numbufs++; }
+        if(!messagefirst && messagelen > 0) { bufs[numbufs].data = (void *)&c.message->getbuf()[c.messagepos]; bufs[numbufs].dataLength = messagelen; numbufs++; }
+        int res = enet_socket_send(c.socket, NULL, bufs, numbufs);
+        if(res<0) return false;
+        c.writable = res >= outputlen + messagelen;
+
+        int sent = res;
+        if(messagefirst) { int n = min(sent, messagelen); c.messagepos += n; sent -= n; }
+        int n = min(sent, outputlen);
+        c.outputpos += n;
+        sent -= n;
+        if(!messagefirst) c.messagepos += sent;
+
+        if(c.output.length() && c.outputpos >= c.output.length())
         {
-            const char *data = c.output.length() ? c.output.getbuf() : c.message->getbuf();
-            int len = c.output.length() ? c.output.length() : c.message->length();
-            ENetBuffer buf;
-            buf.data = (void *)&data[c.outputpos];
-            buf.dataLength = len-c.outputpos;
-            int res = enet_socket_send(c.socket, NULL, &buf, 1);
-            if(res>=0)
-            {
-                c.outputpos += res;
-                if(c.outputpos>=len)
-                {
-                    if(c.output.length()) c.output.setsize(0);
-                    else
-                    {
-                        c.message->purge();
-                        c.message = NULL;
-                    }
-                    c.outputpos = 0;
-                    if(!c.message && c.output.empty() && c.shouldpurge)
-                    {
-                        purgeclient(i--);
-                        continue;
-                    }
-                }
-            }
-            else { purgeclient(i--); continue; }
+            c.output.setsize(0);
+            c.outputpos = 0;
         }
-        if(ENET_SOCKETSET_CHECK(readset, c.socket))
+        if(c.message && c.messagepos >= c.message->length())
         {
-            ENetBuffer buf;
-            buf.data = &c.input[c.inputpos];
-            buf.dataLength = sizeof(c.input) - c.inputpos;
-            int res = enet_socket_receive(c.socket, NULL, &buf, 1);
-            if(res>0)
-            {
-                c.inputpos += res;
-                c.input[min(c.inputpos, (int)sizeof(c.input)-1)] = '\0';
-                if(!checkclientinput(c)) { purgeclient(i--); continue; }
-            }
-            else { purgeclient(i--); continue; }
+            c.message->purge();
+            c.message = NULL;
+            c.messagepos = 0;
         }
-        if(c.output.length() > OUTPUT_LIMIT) { purgeclient(i--); continue; }
-        if(ENET_TIME_DIFFERENCE(servtime, c.lastinput) >= (c.registeredserver ? KEEPALIVE_TIME : CLIENT_TIME)) { purgeclient(i--); continue; }
+        if(!c.pending() && c.shouldpurge) return false;
+        if(!c.writable) break;
+    }
+    return true;
+}
+
+bool readclient(client &c)
+{
+    for(;;)
+    {
+        ENetBuffer buf;
+        buf.data = &c.input[c.inputpos];
+        // the last byte is kept for the terminator, or a full read would cut a line short
+        buf.dataLength = sizeof(c.input) - 1 - c.inputpos;
+        int res = enet_socket_receive(c.socket, NULL, &buf, 1);
+        if(res<0) return false;
+#ifdef USE_EPOLL
+        // with edge triggering an empty read just means the socket is drained, a closed peer is reported as a hangup
+        if(!res) { c.readable = false; return true; }
+#else
+        if(!res) return false;
+#endif
+        c.inputpos += res;
+        c.input[c.inputpos] = '\0';
+        if(!checkclientinput(c)) return false;
+#ifdef USE_EPOLL
+        if(res < (int)buf.dataLength) { c.readable = false; return true; }
+        // don't read further ahead until queued replies have been sent
+        if(c.pending()) return true;
+#else
+        return true;
+#endif
+    }
+}
+
+bool serviceclient(client &c)
+{
+    if(c.writable && c.pending() && !flushclient(c)) return false;
+    if(c.readable && !c.pending())
+    {
+        if(!readclient(c)) return false;
+        if(c.pending() && c.writable && !flushclient(c)) return false;
     }
+    if(c.output.length() > OUTPUT_LIMIT) return false;
+#ifdef USE_EPOLL
+    // input left unread behind queued replies gets no new edge, so come back for it once they are out, even after a hangup
+    if(c.readable && !c.pending()) { activateclient(c); return true; }
+#endif
+    if(c.hangup && !c.pending()) return false;
+#ifndef USE_EPOLL
+    c.readable = c.writable = false;
+#endif
+    return true;
+}
+
+enet_uint32 lastsweep = 0;
+
+void sweepclients()
+{
+    if(ENET_TIME_DIFFERENCE(servtime, lastsweep) < SWEEP_TIME) return;
+    lastsweep = servtime;
+    loopvrev(clients)
+    {
+        client &c = *clients[i];
+        if(c.authreqs.length()) purgeauths(c);
+        if(c.output.length() > OUTPUT_LIMIT || ENET_TIME_DIFFERENCE(servtime, c.lastinput) >= (c.registeredserver ? KEEPALIVE_TIME : CLIENT_TIME)) purgeclient(i);
+    }
+}
+
+void checkclients()
+{
+    bool acceptready = false, pingready = false;
+    pollclients(activeclients.empty() ? 1000 : 0, acceptready, pingready);
+
+    if(pingready) checkserverpongs();
+    if(acceptready) acceptclients();
+
+    while(activeclients.length())
+    {
+        client &c = *activeclients.pop();
+        c.active = false;
+        if(!serviceclient(c)) purgeclient(c.index);
+    }
+
+    sweepclients();
 }
 
 void banclients()
@@ -32,19 +32,29 @@ struct md5 : skelloader<md5>
     static const char *formatname() { return "md5"; }
     int type() const { return MDL_MD5; }
 
+    static void loadshader(skelmeshgroup *group, const char *texname)
+    {
+        part *p = loading->parts.last();
+        p->initskins(notexture, notexture, group->meshes.length());
+        skin &s = p->skins.last();
+        s.tex = textureload(makerelpath(dir, texname), 0, true, false);
+    }
+
     struct md5mesh : skelmesh
     {
         md5weight *weightinfo;
         int numweights;
         md5vert *vertinfo;
+        char *shader;
 
-        md5mesh() : weightinfo(NULL), numweights(0), vertinfo(NULL)
+        md5mesh() : weightinfo(NULL), numweights(0), vertinfo(NULL), shader(NULL)
         {
         }
 
         ~md5mesh()
         {
             cleanup();
+            DELETEA(shader);
         }
 
         void cleanup()
@@ -106,12 +116,9 @@ struct md5 : skelloader<md5>
                     char *start = strchr(buf, '"'), *end = start ? strchr(start+1, '"') : NULL;
                     if(start && end)
                     {
-                        char *texname = newstring(start+1, end-(start+1));
-                        part *p = loading->parts.last();
-                        p->initskins(notexture, notexture, group->meshes.length());
-                        skin &s = p->skins.last();
-                        s.tex = textureload(makerelpath(dir, texname), 0, true, false);
-                        delete[] texname;
+                        DELETEA(shader);
+                        shader = newstring(start+1, end-(start+1));
+                        loadshader((skelmeshgroup *)group, shader);
                     }
                 }
                 else if(sscanf(buf, " numverts %d", &numverts)==1)
@@ -266,6 +273,10 @@ struct md5 : skelloader<md5>
             skelanimspec *sa = skel->findskelanim(filename);
             if(sa) return sa;
 
+            uint cookedkey = cookedanimkey(adjustmentkey());
+            sa = loadcookedanim(filename, cookedkey);
+            if(sa) return sa;
+
             stream *f = openfile(filename, "r");
             if(!f) return NULL;
 
@@ -379,6 +390,7 @@ struct md5 : skelloader<md5>
             if(animdata) delete[] animdata;
             delete f;
 
+            savecookedanim(filename, cookedkey, sa);
             return sa;
         }
 
@@ -390,6 +402,23 @@ struct md5 : skelloader<md5>
 
             return true;
         }
+
+        void savecookedmesh(stream *f, skelmesh &m)
+        {
+            putcookedstring(f, ((md5mesh &)m).shader);
+        }
+
+        bool loadcookedmesh(stream *f, skelmesh &m)
+        {
+            char *shader;
+            if(!getcookedstring(f, shader)) return false;
+            if(shader)
+            {
+                loadshader(this, shader);
+                delete[] shader;
+            }
+            return true;
+        }
     };
 
     skelmeshgroup *newmeshes() { return new md5meshgroup; }
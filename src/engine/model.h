@@ -39,6 +39,7 @@ struct model
     virtual void setcolor(const vec &color) {}
 
     virtual void genshadowmesh(vector<triangle> &tris, const matrix4x3 &orient) {}
+    virtual void genBIH(vector<BIH::mesh> &bih) {}
     virtual void preloadBIH() { if(!bih) setBIH(); }
     virtual void preloadshaders() {}
     virtual void preloadmeshes() {}
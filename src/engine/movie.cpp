@@ -13,6 +13,7 @@
 #else
   #include "SDL_mixer.h"
 #endif
+#include "movieyuv.h"
 
 VAR(dbgmovie, 0, 0, 1);
 
@@ -37,6 +38,98 @@ struct avisegmentinfo
 
 SVARP(moviedir, "movie");
 
+// the encoder thread splits each frame's colour conversion into row slices and shares them with these workers
+VARP(movieencodethreads, 0, 0, 16);
+
+static vector<SDL_Thread *> yuvthreads;
+static SDL_mutex *yuvlock = NULL;
+static SDL_cond *yuvstart = NULL, *yuvdone = NULL;
+static const yuvconverter *yuvwork = NULL;
+static int yuvslices = 0, nextyuvslice = 0, yuvslicesleft = 0;
+static uint yuvgeneration = 0;
+static bool yuvquit = false;
+
+static int runyuvslices()
+{
+    int done = 0;
+    for(;;)
+    {
+        int i = atomicadd(nextyuvslice, 1) - 1;
+        if(i >= yuvslices) break;
+        yuvwork->convertslice(i);
+        done++;
+    }
+    return done;
+}
+
+static int yuvworker(void *data)
+{
+    profilethread("movie yuv worker");
+    uint seen = 0;
+    SDL_LockMutex(yuvlock);
+    for(;;)
+    {
+        while(seen == yuvgeneration && !yuvquit) SDL_CondWait(yuvstart, yuvlock);
+        if(yuvquit) break;
+        seen = yuvgeneration;
+        SDL_UnlockMutex(yuvlock);
+        int done = runyuvslices();
+        SDL_LockMutex(yuvlock);
+        if(done && (yuvslicesleft -= done) <= 0) SDL_CondSignal(yuvdone);
+    }
+    SDL_UnlockMutex(yuvlock);
+    profilethreaddone();
+    return 0;
+}
+
+static void startyuvthreads()
+{
+    int numthreads = (movieencodethreads > 0 ? movieencodethreads : numcpus) - 1;
+    if(numthreads <= 0) return;
+    yuvlock = SDL_CreateMutex();
+    yuvstart = SDL_CreateCond();
+    yuvdone = SDL_CreateCond();
+    yuvquit = false;
+    loopi(numthreads) yuvthreads.add(SDL_CreateThread(yuvworker, "movie yuv worker", NULL));
+}
+
+static void stopyuvthreads()
+{
+    if(yuvthreads.empty()) return;
+    SDL_LockMutex(yuvlock);
+    yuvquit = true;
+    SDL_CondBroadcast(yuvstart);
+    SDL_UnlockMutex(yuvlock);
+    loopv(yuvthreads) SDL_WaitThread(yuvthreads[i], NULL);
+    yuvthreads.setsize(0);
+    SDL_DestroyMutex(yuvlock);
+    SDL_DestroyCond(yuvstart);
+    SDL_DestroyCond(yuvdone);
+    yuvlock = NULL;
+    yuvstart = yuvdone = NULL;
+}
+
+static void convertyuv(const yuvconverter &conv)
+{
+    if(yuvthreads.empty())
+    {
+        loopi(conv.numslices()) conv.convertslice(i);
+        return;
+    }
+    SDL_LockMutex(yuvlock);
+    yuvwork = &conv;
+    yuvslices = yuvslicesleft = conv.numslices();
+    atomicstore(nextyuvslice, 0);
+    yuvgeneration++;
+    SDL_CondBroadcast(yuvstart);
+    SDL_UnlockMutex(yuvlock);
+    int done = runyuvslices();
+    SDL_LockMutex(yuvlock);
+    yuvslicesleft -= done;
+    while(yuvslicesleft > 0) SDL_CondWait(yuvdone, yuvlock);
+    SDL_UnlockMutex(yuvlock);
+}
+
 struct aviwriter
 {
     stream *f;
@@ -399,196 +492,6 @@ struct aviwriter
         return true;
     }
 
-    static inline void boxsample(const uchar *src, const uint stride,
-                                 const uint area, const uint w, uint h,
-                                 const uint xlow, const uint xhigh, const uint ylow, const uint yhigh,
-                                 uint &bdst, uint &gdst, uint &rdst)
-    {
-        const uchar *end = &src[w<<2];
-        uint bt = 0, gt = 0, rt = 0;
-        for(const uchar *cur = &src[4]; cur < end; cur += 4)
-        {
-            bt += cur[0];
-            gt += cur[1];
-            rt += cur[2];
-        }
-        bt = ylow*(bt + ((src[0]*xlow + end[0]*xhigh)>>12));
-        gt = ylow*(gt + ((src[1]*xlow + end[1]*xhigh)>>12));
-        rt = ylow*(rt + ((src[2]*xlow + end[2]*xhigh)>>12));
-        if(h)
-        {
-            for(src += stride, end += stride; --h; src += stride, end += stride)
-            {
-                uint b = 0, g = 0, r = 0;
-                for(const uchar *cur = &src[4]; cur < end; cur += 4)
-                {
-                    b += cur[0];
-                    g += cur[1];
-                    r += cur[2];
-                }
-                bt += (b<<12) + src[0]*xlow + end[0]*xhigh;
-                gt += (g<<12) + src[1]*xlow + end[1]*xhigh;
-                rt += (r<<12) + src[2]*xlow + end[2]*xhigh;
-            }
-            uint b = 0, g = 0, r = 0;
-            for(const uchar *cur = &src[4]; cur < end; cur += 4)
-            {
-                b += cur[0];
-                g += cur[1];
-                r += cur[2];
-            }
-            bt += yhigh*(b + ((src[0]*xlow + end[0]*xhigh)>>12));
-            gt += yhigh*(g + ((src[1]*xlow + end[1]*xhigh)>>12));
-            rt += yhigh*(r + ((src[2]*xlow + end[2]*xhigh)>>12));
-        }
-        bdst = (bt*area)>>24;
-        gdst = (gt*area)>>24;
-        rdst = (rt*area)>>24;
-    }
-
-    void scaleyuv(const uchar *pixels, uint srcw, uint srch)
-    {
-        const int flip = -1;
-        const uint planesize = videow * videoh;
-        if(!yuv) yuv = new uchar[(planesize*3)/2];
-        uchar *yplane = yuv, *uplane = yuv + planesize, *vplane = yuv + planesize + planesize/4;
-        const int ystride = flip*int(videow), uvstride = flip*int(videow)/2;
-        if(flip < 0) { yplane -= int(videoh-1)*ystride; uplane -= int(videoh/2-1)*uvstride; vplane -= int(videoh/2-1)*uvstride; }
-
-        const uint stride = srcw<<2;
-        srcw &= ~1;
-        srch &= ~1;
-        const uint wfrac = (srcw<<12)/videow, hfrac = (srch<<12)/videoh,
-                   area = ((ullong)planesize<<12)/(srcw*srch + 1),
-                   dw = videow*wfrac, dh = videoh*hfrac;
-
-        for(uint y = 0; y < dh;)
-        {
-            uint yn = y + hfrac - 1, yi = y>>12, h = (yn>>12) - yi, ylow = ((yn|(-int(h)>>24))&0xFFFU) + 1 - (y&0xFFFU), yhigh = (yn&0xFFFU) + 1;
-            y += hfrac;
-            uint y2n = y + hfrac - 1, y2i = y>>12, h2 = (y2n>>12) - y2i, y2low = ((y2n|(-int(h2)>>24))&0xFFFU) + 1 - (y&0xFFFU), y2high = (y2n&0xFFFU) + 1;
-            y += hfrac;
-
-            const uchar *src = &pixels[yi*stride], *src2 = &pixels[y2i*stride];
-            uchar *ydst = yplane, *ydst2 = yplane + ystride, *udst = uplane, *vdst = vplane;
-            for(uint x = 0; x < dw;)
-            {
-                uint xn = x + wfrac - 1, xi = x>>12, w = (xn>>12) - xi, xlow = ((w+0xFFFU)&0x1000U) - (x&0xFFFU), xhigh = (xn&0xFFFU) + 1;
-                x += wfrac;
-                uint x2n = x + wfrac - 1, x2i = x>>12, w2 = (x2n>>12) - x2i, x2low = ((w2+0xFFFU)&0x1000U) - (x&0xFFFU), x2high = (x2n&0xFFFU) + 1;
-                x += wfrac;
-
-                uint b1, g1, r1, b2, g2, r2, b3, g3, r3, b4, g4, r4;
-                boxsample(&src[xi<<2], stride, area, w, h, xlow, xhigh, ylow, yhigh, b1, g1, r1);
-                boxsample(&src[x2i<<2], stride, area, w2, h, x2low, x2high, ylow, yhigh, b2, g2, r2);
-                boxsample(&src2[xi<<2], stride, area, w, h2, xlow, xhigh, y2low, y2high, b3, g3, r3);
-                boxsample(&src2[x2i<<2], stride, area, w2, h2, x2low, x2high, y2low, y2high, b4, g4, r4);
-
-
-                // Y  = 16 + 65.481*R + 128.553*G + 24.966*B
-                // Cb = 128 - 37.797*R - 74.203*G + 112.0*B
-                // Cr = 128 + 112.0*R - 93.786*G - 18.214*B
-                *ydst++ = ((16<<12) + 1052*r1 + 2065*g1 + 401*b1)>>12;
-                *ydst++ = ((16<<12) + 1052*r2 + 2065*g2 + 401*b2)>>12;
-                *ydst2++ = ((16<<12) + 1052*r3 + 2065*g3 + 401*b3)>>12;;
-                *ydst2++ = ((16<<12) + 1052*r4 + 2065*g4 + 401*b4)>>12;;
-
-                const uint b = b1 + b2 + b3 + b4,
-                           g = g1 + g2 + g3 + g4,
-                           r = r1 + r2 + r3 + r4;
-                // note: weights here are scaled by 1<<10, as opposed to 1<<12, since r/g/b are already *4
-                *udst++ = ((128<<12) - 152*r - 298*g + 450*b)>>12;
-                *vdst++ = ((128<<12) + 450*r - 377*g - 73*b)>>12;
-            }
-
-            yplane += 2*ystride;
-            uplane += uvstride;
-            vplane += uvstride;
-        }
-    }
-
-    void encodeyuv(const uchar *pixels)
-    {
-        const int flip = -1;
-        const uint planesize = videow * videoh;
-        if(!yuv) yuv = new uchar[(planesize*3)/2];
-        uchar *yplane = yuv, *uplane = yuv + planesize, *vplane = yuv + planesize + planesize/4;
-        const int ystride = flip*int(videow), uvstride = flip*int(videow)/2;
-        if(flip < 0) { yplane -= int(videoh-1)*ystride; uplane -= int(videoh/2-1)*uvstride; vplane -= int(videoh/2-1)*uvstride; }
-
-        const uint stride = videow<<2;
-        const uchar *src = pixels, *yend = src + videoh*stride;
-        while(src < yend)
-        {
-            const uchar *src2 = src + stride, *xend = src2;
-            uchar *ydst = yplane, *ydst2 = yplane + ystride, *udst = uplane, *vdst = vplane;
-            while(src < xend)
-            {
-                const uint b1 = src[0], g1 = src[1], r1 = src[2],
-                           b2 = src[4], g2 = src[5], r2 = src[6],
-                           b3 = src2[0], g3 = src2[1], r3 = src2[2],
-                           b4 = src2[4], g4 = src2[5], r4 = src2[6];
-
-                // Y  = 16 + 65.481*R + 128.553*G + 24.966*B
-                // Cb = 128 - 37.797*R - 74.203*G + 112.0*B
-                // Cr = 128 + 112.0*R - 93.786*G - 18.214*B
-                *ydst++ = ((16<<12) + 1052*r1 + 2065*g1 + 401*b1)>>12;
-                *ydst++ = ((16<<12) + 1052*r2 + 2065*g2 + 401*b2)>>12;
-                *ydst2++ = ((16<<12) + 1052*r3 + 2065*g3 + 401*b3)>>12;;
-                *ydst2++ = ((16<<12) + 1052*r4 + 2065*g4 + 401*b4)>>12;;
-
-                const uint b = b1 + b2 + b3 + b4,
-                           g = g1 + g2 + g3 + g4,
-                           r = r1 + r2 + r3 + r4;
-                // note: weights here are scaled by 1<<10, as opposed to 1<<12, since r/g/b are already *4
-                *udst++ = ((128<<12) - 152*r - 298*g + 450*b)>>12;
-                *vdst++ = ((128<<12) + 450*r - 377*g - 73*b)>>12;
-
-                src += 8;
-                src2 += 8;
-            }
-            src = src2;
-            yplane += 2*ystride;
-            uplane += uvstride;
-            vplane += uvstride;
-        }
-    }
-
-    void compressyuv(const uchar *pixels)
-    {
-        const int flip = -1;
-        const uint planesize = videow * videoh;
-        if(!yuv) yuv = new uchar[(planesize*3)/2];
-        uchar *yplane = yuv, *uplane = yuv + planesize, *vplane = yuv + planesize + planesize/4;
-        const int ystride = flip*int(videow), uvstride = flip*int(videow)/2;
-        if(flip < 0) { yplane -= int(videoh-1)*ystride; uplane -= int(videoh/2-1)*uvstride; vplane -= int(videoh/2-1)*uvstride; }
-
-        const uint stride = videow<<2;
-        const uchar *src = pixels, *yend = src + videoh*stride;
-        while(src < yend)
-        {
-            const uchar *src2 = src + stride, *xend = src2;
-            uchar *ydst = yplane, *ydst2 = yplane + ystride, *udst = uplane, *vdst = vplane;
-            while(src < xend)
-            {
-                *ydst++ = src[0];
-                *ydst++ = src[4];
-                *ydst2++ = src2[0];
-                *ydst2++ = src2[4];
-
-                *udst++ = (uint(src[1]) + uint(src[5]) + uint(src2[1]) + uint(src2[5])) >> 2;
-                *vdst++ = (uint(src[2]) + uint(src[6]) + uint(src2[2]) + uint(src2[6])) >> 2;
-
-                src += 8;
-                src2 += 8;
-            }
-            src = src2;
-            yplane += 2*ystride;
-            uplane += uvstride;
-            vplane += uvstride;
-        }
-    }
-
     bool writesound(uchar *data, uint framesize, uint frame)
     {
         // do conversion in-place to little endian format
@@ -733,15 +636,12 @@ struct aviwriter
     {
         if(frame < videoframes) return true;
 
-        switch(format)
+        if(format != VID_YUV420)
         {
-            case VID_RGB:
-                if(srcw != videow || srch != videoh) scaleyuv(pixels, srcw, srch);
-                else encodeyuv(pixels);
-                break;
-            case VID_YUV:
-                compressyuv(pixels);
-                break;
+            if(!yuv) yuv = new uchar[(videow*videoh*3)/2];
+            yuvconverter conv;
+            conv.setup(pixels, srcw, srch, format == VID_YUV, yuv, videow, videoh);
+            convertyuv(conv);
         }
 
         const uint framesize = (videow * videoh * 3) / 2;
@@ -801,7 +701,7 @@ namespace recorder
     static queue<soundbuffer, MAXSOUNDBUFFERS> soundbuffers;
     static SDL_mutex *soundlock = NULL;
 
-    enum { MAXVIDEOBUFFERS = 2 }; // double buffer
+    enum { MAXVIDEOBUFFERS = 4 }; // ring of captured frames, so a slow frame on the encoder thread does not drop the next ones
     struct videobuffer
     {
         uchar *video;
@@ -957,6 +857,7 @@ namespace recorder
         videolock = SDL_CreateMutex();
         shouldencode = SDL_CreateCond();
         shouldread = SDL_CreateCond();
+        startyuvthreads();
         thread = SDL_CreateThread(videoencoder, "video encoder", NULL);
         if(file->soundfrequency > 0) Mix_SetPostMix(soundencoder, NULL);
     }
@@ -981,6 +882,7 @@ namespace recorder
         SDL_UnlockMutex(videolock);
 
         SDL_WaitThread(thread, NULL); // block until thread is finished
+        stopyuvthreads();
 
         cleanup();
 
@@ -0,0 +1,239 @@
+// moviebench.cpp: times the movie recorder's bgra to i420 conversion on synthetic frames, from 1 to N threads
+// the scalar and sse2 paths are checked against each other before anything is timed
+
+#include "cube.h"
+#include "movieyuv.h"
+
+#ifndef WIN32
+#include <pthread.h>
+#endif
+
+static int maxthreads = 8, numframes = 120, videow = 1920, videoh = 1080, capturew = 2560, captureh = 1440;
+
+// as many captured frames as the recorder's ring holds, so the source does not just sit in cache
+#define NUMCAPTURES 4
+
+static uchar *captures[NUMCAPTURES], *yuvs[NUMCAPTURES];
+static yuvconverter converters[NUMCAPTURES];
+
+static void makecaptures(int sw, int sh)
+{
+    seedMT(1);
+    loopi(NUMCAPTURES)
+    {
+        DELETEA(captures[i]);
+        captures[i] = new uchar[sw*sh*4];
+        uchar *dst = captures[i];
+        // smooth gradients with some noise on top, roughly what a rendered frame looks like to the filter
+        loop(y, sh) loop(x, sw)
+        {
+            uint noise = randomMT();
+            *dst++ = uchar((x*255)/sw + (noise&0x1F));
+            *dst++ = uchar((y*255)/sh + ((noise>>5)&0x1F));
+            *dst++ = uchar(((x+y+i*64)*255)/(sw+sh) + ((noise>>10)&0x1F));
+            *dst++ = 0xFF;
+        }
+    }
+}
+
+static void setupconverters(int sw, int sh, bool simd)
+{
+    loopi(NUMCAPTURES)
+    {
+        converters[i].setup(captures[i], sw, sh, false, yuvs[i], videow, videoh);
+        converters[i].simd = simd;
+    }
+}
+
+// a counting semaphore, the recorder's sdl mutex and conditions are not available to a standalone tool
+#ifdef WIN32
+typedef HANDLE benchsem;
+static void initsem(benchsem &s) { s = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL); if(!s) fatal("could not create semaphore"); }
+static void destroysem(benchsem &s) { CloseHandle(s); }
+static void postsem(benchsem &s, int n = 1) { ReleaseSemaphore(s, n, NULL); }
+static void waitsem(benchsem &s) { WaitForSingleObject(s, INFINITE); }
+#else
+struct benchsem
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int count;
+};
+static void initsem(benchsem &s) { pthread_mutex_init(&s.lock, NULL); pthread_cond_init(&s.cond, NULL); s.count = 0; }
+static void destroysem(benchsem &s) { pthread_cond_destroy(&s.cond); pthread_mutex_destroy(&s.lock); }
+static void postsem(benchsem &s, int n = 1)
+{
+    pthread_mutex_lock(&s.lock);
+    s.count += n;
+    if(n > 1) pthread_cond_broadcast(&s.cond);
+    else pthread_cond_signal(&s.cond);
+    pthread_mutex_unlock(&s.lock);
+}
+static void waitsem(benchsem &s)
+{
+    pthread_mutex_lock(&s.lock);
+    while(s.count <= 0) pthread_cond_wait(&s.cond, &s.lock);
+    s.count--;
+    pthread_mutex_unlock(&s.lock);
+}
+#endif
+
+// like the recorder's convertyuv, each frame's slices are shared with the workers and the frame is finished before the next starts
+static benchsem yuvstart, yuvdone;
+static const yuvconverter *yuvwork = NULL;
+static int yuvslices = 0, nextyuvslice = 0, yuvslicesleft = 0;
+static bool yuvquit = false;
+
+static int runyuvslices()
+{
+    int done = 0;
+    for(;;)
+    {
+        int i = atomicadd(nextyuvslice, 1) - 1;
+        if(i >= yuvslices) break;
+        yuvwork->convertslice(i);
+        done++;
+    }
+    return done;
+}
+
+#ifdef WIN32
+static DWORD WINAPI benchthread(LPVOID data)
+#else
+static void *benchthread(void *data)
+#endif
+{
+    for(;;)
+    {
+        waitsem(yuvstart);
+        if(yuvquit) break;
+        // the last slice of a frame to finish wakes the thread waiting on it
+        int done = runyuvslices();
+        if(done && atomicadd(yuvslicesleft, -done) <= 0) postsem(yuvdone);
+    }
+    return 0;
+}
+
+static void convertyuv(const yuvconverter &conv, int numworkers)
+{
+    yuvwork = &conv;
+    yuvslices = conv.numslices();
+    atomicstore(yuvslicesleft, yuvslices);
+    atomicstore(nextyuvslice, 0);
+    if(numworkers) postsem(yuvstart, numworkers);
+    int done = runyuvslices();
+    if(atomicadd(yuvslicesleft, -done) > 0) waitsem(yuvdone);
+}
+
+static double runbench(int numthreads)
+{
+    initsem(yuvstart);
+    initsem(yuvdone);
+    yuvquit = false;
+#ifdef WIN32
+    vector<HANDLE> threads;
+    loopi(numthreads-1)
+    {
+        HANDLE thread = CreateThread(NULL, 0, benchthread, NULL, 0, NULL);
+        if(!thread) fatal("could not create thread");
+        threads.add(thread);
+    }
+#else
+    vector<pthread_t> threads;
+    loopi(numthreads-1)
+    {
+        pthread_t thread;
+        if(pthread_create(&thread, NULL, benchthread, NULL)) fatal("could not create thread");
+        threads.add(thread);
+    }
+#endif
+    uint start = getclockmicros();
+    loopi(numframes) convertyuv(converters[i%NUMCAPTURES], threads.length());
+    uint elapsed = getclockmicros() - start;
+    yuvquit = true;
+    postsem(yuvstart, threads.length());
+#ifdef WIN32
+    loopv(threads)
+    {
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+    }
+#else
+    loopv(threads) pthread_join(threads[i], NULL);
+#endif
+    destroysem(yuvstart);
+    destroysem(yuvdone);
+    return numframes*1000000.0/max(elapsed, 1U);
+}
+
+static void checkframe(int sw, int sh)
+{
+    int size = videow*videoh*3/2;
+    uchar *scalar = new uchar[size];
+    yuvconverter conv;
+    conv.setup(captures[0], sw, sh, false, scalar, videow, videoh);
+    conv.simd = false;
+    loopi(conv.numslices()) conv.convertslice(i);
+    conv.yuv = yuvs[0];
+    conv.simd = true;
+    loopi(conv.numslices()) conv.convertslice(i);
+    loopi(size) if(scalar[i] != yuvs[0][i]) fatal("sse2 and scalar conversion differ at byte %d: %d != %d", i, yuvs[0][i], scalar[i]);
+    delete[] scalar;
+}
+
+static void benchsize(int sw, int sh)
+{
+    makecaptures(sw, sh);
+    checkframe(sw, sh);
+    printf("%dx%d -> %dx%d%s, %d frames\n", sw&~1, sh&~1, videow, videoh, converters[0].scaled() ? " (scaled)" : "", numframes);
+    for(int numthreads = 1; numthreads <= maxthreads; numthreads *= 2)
+    {
+        setupconverters(sw, sh, false);
+        double scalar = runbench(numthreads);
+        // only the direct conversion has an sse2 path
+        if(converters[0].scaled()) { printf("%2d threads: box filter %.1f fps\n", numthreads, scalar); continue; }
+#ifdef __SSE2__
+        setupconverters(sw, sh, true);
+        double simd = runbench(numthreads);
+        printf("%2d threads: scalar %.1f fps, sse2 %.1f fps\n", numthreads, scalar, simd);
+#else
+        printf("%2d threads: scalar %.1f fps\n", numthreads, scalar);
+#endif
+    }
+}
+
+static bool loadoption(const char *arg)
+{
+    if(arg[0] != '-') return false;
+    switch(arg[1])
+    {
+        case 't': maxthreads = clamp(atoi(&arg[2]), 1, 64); return true;
+        case 'n': numframes = max(atoi(&arg[2]), 1); return true;
+        case 'w': videow = clamp(atoi(&arg[2]), 2, 8192)&~1; return true;
+        case 'h': videoh = clamp(atoi(&arg[2]), 2, 8192)&~1; return true;
+        case 'W': capturew = clamp(atoi(&arg[2]), 2, 8192); return true;
+        case 'H': captureh = clamp(atoi(&arg[2]), 2, 8192); return true;
+    }
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    for(int i = 1; i < argc; i++) if(!loadoption(argv[i]))
+    {
+        printf("usage: tess_moviebench [-tMAXTHREADS] [-nFRAMES] [-wVIDEOWIDTH] [-hVIDEOHEIGHT] [-WCAPTUREWIDTH] [-HCAPTUREHEIGHT]\n");
+        return EXIT_FAILURE;
+    }
+    // each captured frame gets its own output, so a frame never writes over the one converted before it
+    loopi(NUMCAPTURES) yuvs[i] = new uchar[videow*videoh*3/2];
+    // a capture the size of the video is converted directly, a larger one is box filtered down first
+    benchsize(videow, videoh);
+    if(capturew != videow || captureh != videoh)
+    {
+        // the box filter is far slower, so fewer frames keep the run short
+        numframes = max(numframes/4, 1);
+        benchsize(capturew, captureh);
+    }
+    loopi(NUMCAPTURES) { DELETEA(captures[i]); DELETEA(yuvs[i]); }
+    return EXIT_SUCCESS;
+}
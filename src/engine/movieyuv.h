@@ -0,0 +1,265 @@
+// movieyuv.h: bgra to i420 conversion for movie recording
+// a frame is converted in independent slices of output rows so several threads can share it,
+// and the unscaled path converts 8 pixels at a time with sse2 where available
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+struct yuvconverter
+{
+    const uchar *pixels;
+    uint srcw, srch, stride;
+    uchar *yuv;
+    uint w, h;
+    bool packed, simd;
+    uint wfrac, hfrac, area;
+
+    yuvconverter() : pixels(NULL), srcw(0), srch(0), stride(0), yuv(NULL), w(0), h(0), packed(false), simd(true), wfrac(0), hfrac(0), area(0) {}
+
+    // packed sources were already turned into yuv by the movieyuv shader and only need their chroma subsampled
+    void setup(const uchar *src, uint sw, uint sh, bool ispacked, uchar *dst, uint dw, uint dh)
+    {
+        pixels = src;
+        stride = sw<<2;
+        srcw = sw&~1;
+        srch = sh&~1;
+        packed = ispacked;
+        yuv = dst;
+        w = dw;
+        h = dh;
+        wfrac = (srcw<<12)/w;
+        hfrac = (srch<<12)/h;
+        area = ((ullong)(w*h)<<12)/(srcw*srch + 1);
+    }
+
+    bool scaled() const { return !packed && (srcw != w || srch != h); }
+
+    // the avi stores rows bottom up, so source row pair y lands on the planes' rows counted from the end
+    void planes(uint y, uchar *&yplane, uchar *&uplane, uchar *&vplane) const
+    {
+        const uint planesize = w*h;
+        yplane = &yuv[(h-1-y)*w];
+        uplane = &yuv[planesize + (h/2-1-y/2)*(w/2)];
+        vplane = &yuv[planesize + planesize/4 + (h/2-1-y/2)*(w/2)];
+    }
+
+    static inline void boxsample(const uchar *src, const uint stride,
+                                 const uint area, const uint w, uint h,
+                                 const uint xlow, const uint xhigh, const uint ylow, const uint yhigh,
+                                 uint &bdst, uint &gdst, uint &rdst)
+    {
+        const uchar *end = &src[w<<2];
+        uint bt = 0, gt = 0, rt = 0;
+        for(const uchar *cur = &src[4]; cur < end; cur += 4)
+        {
+            bt += cur[0];
+            gt += cur[1];
+            rt += cur[2];
+        }
+        bt = ylow*(bt + ((src[0]*xlow + end[0]*xhigh)>>12));
+        gt = ylow*(gt + ((src[1]*xlow + end[1]*xhigh)>>12));
+        rt = ylow*(rt + ((src[2]*xlow + end[2]*xhigh)>>12));
+        if(h)
+        {
+            for(src += stride, end += stride; --h; src += stride, end += stride)
+            {
+                uint b = 0, g = 0, r = 0;
+                for(const uchar *cur = &src[4]; cur < end; cur += 4)
+                {
+                    b += cur[0];
+                    g += cur[1];
+                    r += cur[2];
+                }
+                bt += (b<<12) + src[0]*xlow + end[0]*xhigh;
+                gt += (g<<12) + src[1]*xlow + end[1]*xhigh;
+                rt += (r<<12) + src[2]*xlow + end[2]*xhigh;
+            }
+            uint b = 0, g = 0, r = 0;
+            for(const uchar *cur = &src[4]; cur < end; cur += 4)
+            {
+                b += cur[0];
+                g += cur[1];
+                r += cur[2];
+            }
+            bt += yhigh*(b + ((src[0]*xlow + end[0]*xhigh)>>12));
+            gt += yhigh*(g + ((src[1]*xlow + end[1]*xhigh)>>12));
+            rt += yhigh*(r + ((src[2]*xlow + end[2]*xhigh)>>12));
+        }
+        bdst = (bt*area)>>24;
+        gdst = (gt*area)>>24;
+        rdst = (rt*area)>>24;
+    }
+
+    // Y  = 16 + 65.481*R + 128.553*G + 24.966*B
+    // Cb = 128 - 37.797*R - 74.203*G + 112.0*B
+    // Cr = 128 + 112.0*R - 93.786*G - 18.214*B
+    static inline uchar rgbtoy(uint r, uint g, uint b) { return ((16<<12) + 1052*r + 2065*g + 401*b)>>12; }
+    // note: weights here are scaled by 1<<10, as opposed to 1<<12, since r/g/b are sums of 4 pixels
+    static inline uchar rgbtou(uint r, uint g, uint b) { return ((128<<12) - 152*r - 298*g + 450*b)>>12; }
+    static inline uchar rgbtov(uint r, uint g, uint b) { return ((128<<12) + 450*r - 377*g - 73*b)>>12; }
+
+    void scalerows(uint y1, uint y2) const
+    {
+        for(uint row = y1; row < y2; row += 2)
+        {
+            uint y = row*hfrac;
+            uint yn = y + hfrac - 1, yi = y>>12, h = (yn>>12) - yi, ylow = ((yn|(-int(h)>>24))&0xFFFU) + 1 - (y&0xFFFU), yhigh = (yn&0xFFFU) + 1;
+            y += hfrac;
+            uint y2n = y + hfrac - 1, y2i = y>>12, h2 = (y2n>>12) - y2i, y2low = ((y2n|(-int(h2)>>24))&0xFFFU) + 1 - (y&0xFFFU), y2high = (y2n&0xFFFU) + 1;
+
+            const uchar *src = &pixels[yi*stride], *src2 = &pixels[y2i*stride];
+            uchar *ydst, *udst, *vdst;
+            planes(row, ydst, udst, vdst);
+            uchar *ydst2 = ydst - w;
+            const uint dw = w*wfrac;
+            for(uint x = 0; x < dw;)
+            {
+                uint xn = x + wfrac - 1, xi = x>>12, w = (xn>>12) - xi, xlow = ((w+0xFFFU)&0x1000U) - (x&0xFFFU), xhigh = (xn&0xFFFU) + 1;
+                x += wfrac;
+                uint x2n = x + wfrac - 1, x2i = x>>12, w2 = (x2n>>12) - x2i, x2low = ((w2+0xFFFU)&0x1000U) - (x&0xFFFU), x2high = (x2n&0xFFFU) + 1;
+                x += wfrac;
+
+                uint b1, g1, r1, b2, g2, r2, b3, g3, r3, b4, g4, r4;
+                boxsample(&src[xi<<2], stride, area, w, h, xlow, xhigh, ylow, yhigh, b1, g1, r1);
+                boxsample(&src[x2i<<2], stride, area, w2, h, x2low, x2high, ylow, yhigh, b2, g2, r2);
+                boxsample(&src2[xi<<2], stride, area, w, h2, xlow, xhigh, y2low, y2high, b3, g3, r3);
+                boxsample(&src2[x2i<<2], stride, area, w2, h2, x2low, x2high, y2low, y2high, b4, g4, r4);
+
+                *ydst++ = rgbtoy(r1, g1, b1);
+                *ydst++ = rgbtoy(r2, g2, b2);
+                *ydst2++ = rgbtoy(r3, g3, b3);
+                *ydst2++ = rgbtoy(r4, g4, b4);
+
+                const uint b = b1 + b2 + b3 + b4,
+                           g = g1 + g2 + g3 + g4,
+                           r = r1 + r2 + r3 + r4;
+                *udst++ = rgbtou(r, g, b);
+                *vdst++ = rgbtov(r, g, b);
+            }
+        }
+    }
+
+#ifdef __SSE2__
+    // luma of the 4 pixels in p, still scaled by 1<<12
+    static inline __m128i ysum4(__m128i p)
+    {
+        const __m128i zero = _mm_setzero_si128(), ycoef = _mm_setr_epi16(401, 2065, 1052, 0, 401, 2065, 1052, 0);
+        __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(p, zero), ycoef),
+                hi = _mm_madd_epi16(_mm_unpackhi_epi8(p, zero), ycoef);
+        lo = _mm_add_epi32(lo, _mm_srli_epi64(lo, 32));
+        hi = _mm_add_epi32(hi, _mm_srli_epi64(hi, 32));
+        __m128i y = _mm_unpacklo_epi64(_mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 3, 2, 0)), _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 3, 2, 0)));
+        return _mm_srai_epi32(_mm_add_epi32(y, _mm_set1_epi32(16<<12)), 12);
+    }
+
+    // b/g/r/a sums of the 2x2 blocks under the 4 pixels in p and q as 16 bit lanes
+    static inline __m128i blocksum2(__m128i p, __m128i q)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(p, zero), _mm_unpacklo_epi8(q, zero)),
+                hi = _mm_add_epi16(_mm_unpackhi_epi8(p, zero), _mm_unpackhi_epi8(q, zero));
+        lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+        hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+        return _mm_unpacklo_epi64(lo, hi);
+    }
+
+    static inline __m128i chroma2(__m128i blocks, __m128i coef)
+    {
+        __m128i c = _mm_madd_epi16(blocks, coef);
+        c = _mm_add_epi32(c, _mm_srli_epi64(c, 32));
+        return _mm_shuffle_epi32(c, _MM_SHUFFLE(3, 3, 2, 0));
+    }
+
+    static inline int chroma4(__m128i b1, __m128i b2, __m128i coef)
+    {
+        __m128i c = _mm_unpacklo_epi64(chroma2(b1, coef), chroma2(b2, coef));
+        c = _mm_srai_epi32(_mm_add_epi32(c, _mm_set1_epi32(128<<12)), 12);
+        c = _mm_packs_epi32(c, c);
+        return _mm_cvtsi128_si32(_mm_packus_epi16(c, c));
+    }
+#endif
+
+    void encoderows(uint y1, uint y2) const
+    {
+        for(uint row = y1; row < y2; row += 2)
+        {
+            const uchar *src = &pixels[row*stride], *src2 = src + stride;
+            uchar *ydst, *udst, *vdst;
+            planes(row, ydst, udst, vdst);
+            uchar *ydst2 = ydst - w;
+            uint x = 0;
+#ifdef __SSE2__
+            if(simd)
+            {
+                const __m128i ucoef = _mm_setr_epi16(450, -298, -152, 0, 450, -298, -152, 0),
+                              vcoef = _mm_setr_epi16(-73, -377, 450, 0, -73, -377, 450, 0);
+                for(; x + 8 <= w; x += 8, src += 32, src2 += 32, ydst += 8, ydst2 += 8, udst += 4, vdst += 4)
+                {
+                    __m128i a1 = _mm_loadu_si128((const __m128i *)src), a2 = _mm_loadu_si128((const __m128i *)&src[16]),
+                            b1 = _mm_loadu_si128((const __m128i *)src2), b2 = _mm_loadu_si128((const __m128i *)&src2[16]);
+                    __m128i luma = _mm_packus_epi16(_mm_packs_epi32(ysum4(a1), ysum4(a2)), _mm_packs_epi32(ysum4(b1), ysum4(b2)));
+                    _mm_storel_epi64((__m128i *)ydst, luma);
+                    _mm_storel_epi64((__m128i *)ydst2, _mm_srli_si128(luma, 8));
+                    __m128i blocks1 = blocksum2(a1, b1), blocks2 = blocksum2(a2, b2);
+                    int u = chroma4(blocks1, blocks2, ucoef), v = chroma4(blocks1, blocks2, vcoef);
+                    memcpy(udst, &u, 4);
+                    memcpy(vdst, &v, 4);
+                }
+            }
+#endif
+            for(; x < w; x += 2, src += 8, src2 += 8)
+            {
+                const uint b1 = src[0], g1 = src[1], r1 = src[2],
+                           b2 = src[4], g2 = src[5], r2 = src[6],
+                           b3 = src2[0], g3 = src2[1], r3 = src2[2],
+                           b4 = src2[4], g4 = src2[5], r4 = src2[6];
+
+                *ydst++ = rgbtoy(r1, g1, b1);
+                *ydst++ = rgbtoy(r2, g2, b2);
+                *ydst2++ = rgbtoy(r3, g3, b3);
+                *ydst2++ = rgbtoy(r4, g4, b4);
+
+                const uint b = b1 + b2 + b3 + b4,
+                           g = g1 + g2 + g3 + g4,
+                           r = r1 + r2 + r3 + r4;
+                *udst++ = rgbtou(r, g, b);
+                *vdst++ = rgbtov(r, g, b);
+            }
+        }
+    }
+
+    void compressrows(uint y1, uint y2) const
+    {
+        for(uint row = y1; row < y2; row += 2)
+        {
+            const uchar *src = &pixels[row*stride], *src2 = src + stride;
+            uchar *ydst, *udst, *vdst;
+            planes(row, ydst, udst, vdst);
+            uchar *ydst2 = ydst - w;
+            for(uint x = 0; x < w; x += 2, src += 8, src2 += 8)
+            {
+                *ydst++ = src[0];
+                *ydst++ = src[4];
+                *ydst2++ = src2[0];
+                *ydst2++ = src2[4];
+
+                *udst++ = (uint(src[1]) + uint(src[5]) + uint(src2[1]) + uint(src2[5])) >> 2;
+                *vdst++ = (uint(src[2]) + uint(src[6]) + uint(src2[2]) + uint(src2[6])) >> 2;
+            }
+        }
+    }
+
+    enum { SLICEROWS = 32 };
+
+    int numslices() const { return (h + SLICEROWS - 1)/SLICEROWS; }
+
+    void convertslice(int slice) const
+    {
+        uint y1 = slice*SLICEROWS, y2 = min(y1 + SLICEROWS, h);
+        if(packed) compressrows(y1, y2);
+        else if(scaled()) scalerows(y1, y2);
+        else encoderows(y1, y2);
+    }
+};
+
@@ -152,15 +152,92 @@ void show_addnormals_progress()
     renderprogress(bar1, "computing normals...");
 }
 
-void addnormals(cube &c, const ivec &o, int size)
+// normals found by a worker are queued and replayed on the main thread in octree order,
+// so the normal lists come out exactly as a serial pass would build them
+
+struct pendingnormal
+{
+    vec pos, surface;
+    int smooth, axis; // axis < 0 for a surface normal, 0..5 for a flat face, 6 for a t-joint
+};
+
+struct pendingtnormal
+{
+    vec pos1, pos2;
+    float offset;
+    int normals[2];
+};
+
+struct normalqueue
+{
+    vector<pendingnormal> normals;
+    vector<pendingtnormal> tnormals;
+    int numsurfaces;
+
+    normalqueue() : numsurfaces(0) {}
+
+    int addnormal(const vec &pos, int smooth, const vec &surface)
+    {
+        pendingnormal &n = normals.add();
+        n.pos = pos;
+        n.surface = surface;
+        n.smooth = smooth;
+        n.axis = -1;
+        return numsurfaces++;
+    }
+
+    int addnormal(const vec &pos, int smooth, int axis)
+    {
+        pendingnormal &n = normals.add();
+        n.pos = pos;
+        n.smooth = smooth;
+        n.axis = axis;
+        return axis - 6;
+    }
+
+    void addtnormal(const vec &pos, int smooth, float offset, int normal1, int normal2, const vec &pos1, const vec &pos2)
+    {
+        pendingnormal &n = normals.add();
+        n.pos = pos;
+        n.smooth = smooth;
+        n.axis = 6;
+        pendingtnormal &t = tnormals.add();
+        t.pos1 = pos1;
+        t.pos2 = pos2;
+        t.offset = offset;
+        t.normals[0] = normal1;
+        t.normals[1] = normal2;
+    }
+
+    void flush()
+    {
+        int base = ::normals.length(), tnormal = 0;
+        loopv(normals)
+        {
+            const pendingnormal &n = normals[i];
+            if(n.axis < 0) ::addnormal(n.pos, n.smooth, n.surface);
+            else if(n.axis < 6) ::addnormal(n.pos, n.smooth, n.axis);
+            else
+            {
+                const pendingtnormal &t = tnormals[tnormal++];
+                ::addtnormal(n.pos, n.smooth, t.offset, t.normals[0] >= 0 ? base + t.normals[0] : t.normals[0], t.normals[1] >= 0 ? base + t.normals[1] : t.normals[1], t.pos1, t.pos2);
+            }
+        }
+        delete[] (uchar *)normals.disown();
+        delete[] (uchar *)tnormals.disown();
+        numsurfaces = 0;
+    }
+};
+
+static void addnormals(normalqueue &q, cube &c, const ivec &o, int size)
 {
-    CHECK_CALCLIGHT_PROGRESS(return, show_addnormals_progress);
+    if(atomicload(calclight_canceled)) return;
 
     if(c.children)
     {
-        normalprogress++;
+        atomicadd(normalprogress, 1U);
         size >>= 1;
-        loopi(8) addnormals(c.children[i], ivec(i, o, size), size);
+        loopi(8) addnormals(q, c.children[i], ivec(i, o, size), size);
         return;
     }
     else if(isempty(c)) return;
@@ -170,7 +247,6 @@ void addnormals(cube &c, const ivec &o, int size)
     int tj = usetnormals && c.ext ? c.ext->tjoints : -1, vis;
     loopi(6) if((vis = visibletris(c, i, o, size)))
     {
-        CHECK_CALCLIGHT_PROGRESS(return, show_addnormals_progress);
         if(c.texture[i] == DEFAULT_SKY) continue;
 
         vec planes[2];
@@ -209,15 +285,15 @@ void addnormals(cube &c, const ivec &o, int size)
         VSlot &vslot = lookupvslot(c.texture[i], false);
         int smooth = vslot.slot->smooth;
 
-        if(!numplanes) loopk(numverts) norms[k] = addnormal(pos[k], smooth, i);
-        else if(numplanes==1) loopk(numverts) norms[k] = addnormal(pos[k], smooth, planes[0]);
+        if(!numplanes) loopk(numverts) norms[k] = q.addnormal(pos[k], smooth, i);
+        else if(numplanes==1) loopk(numverts) norms[k] = q.addnormal(pos[k], smooth, planes[0]);
         else
         {
             vec avg = vec(planes[0]).add(planes[1]).normalize();
-            norms[0] = addnormal(pos[0], smooth, avg);
-            norms[1] = addnormal(pos[1], smooth, planes[0]);
-            norms[2] = addnormal(pos[2], smooth, avg);
-            for(int k = 3; k < numverts; k++) norms[k] = addnormal(pos[k], smooth, planes[1]);
+            norms[0] = q.addnormal(pos[0], smooth, avg);
+            norms[1] = q.addnormal(pos[1], smooth, planes[0]);
+            norms[2] = q.addnormal(pos[2], smooth, avg);
+            for(int k = 3; k < numverts; k++) norms[k] = q.addnormal(pos[k], smooth, planes[1]);
         }
 
         while(tj >= 0 && tjoints[tj].edge < i*(MAXFACEVERTS+1)) tj = tjoints[tj].next;
@@ -241,19 +317,35 @@ void addnormals(cube &c, const ivec &o, int size)
                 if(t.edge != edge) break;
                 float offset = (t.offset - offset1) * doffset;
                 vec tpos = vec(d).mul(t.offset/8.0f).add(o);
-                addtnormal(tpos, smooth, offset, norms[e1], norms[e2], v1, v2);
+                q.addtnormal(tpos, smooth, offset, norms[e1], norms[e2], v1, v2);
                 tj = t.next;
             }
         }
     }
 }
 
+static normalqueue *normalqueues = NULL;
+
+static void addnormalstask(lighttask &t)
+{
+    addnormals(normalqueues[t.id], *t.c, t.o, t.size);
+}
+
+static void flushnormalstask(lighttask &t)
+{
+    normalqueues[t.id].flush();
+}
+
 void calcnormals(bool lerptjoints)
 {
     usetnormals = lerptjoints;
     if(usetnormals) findtjoints();
     normalprogress = 1;
-    loopi(8) addnormals(worldroot[i], ivec(i, ivec(0, 0, 0), worldsize/2), worldsize/2);
+    vector<lighttask> tasks;
+    genlighttasks(tasks, worldroot, ivec(0, 0, 0), worldsize/2);
+    normalqueues = new normalqueue[tasks.length()];
+    runlighttasks(tasks, addnormalstask, flushnormalstask, show_addnormals_progress);
+    DELETEA(normalqueues);
 }
 
 void clearnormals()
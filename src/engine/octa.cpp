@@ -16,12 +16,116 @@ static struct emptycube : cube
     }
 } emptycube;
 
+// cube families and cube extensions come from pools of fixed size blocks carved out of large slabs
+// freed blocks are kept on a free list for reuse, and a pool's slabs are released in bulk once it is empty
+#define OCTAPOOLSLAB (64*1024)
+
+struct octapool
+{
+    struct slab
+    {
+        slab *next;
+        int size;
+    };
+
+    int blocksize, numused, numslabs;
+    void *freelist;
+    slab *slabs;
+
+    void grow()
+    {
+        int headersize = (sizeof(slab) + 15)&~15, numblocks = max((OCTAPOOLSLAB - headersize)/blocksize, 1);
+        slab *s = (slab *)new uchar[headersize + numblocks*blocksize];
+        s->next = slabs;
+        s->size = numblocks;
+        slabs = s;
+        numslabs++;
+        uchar *block = (uchar *)s + headersize;
+        loopi(numblocks)
+        {
+            *(void **)block = freelist;
+            freelist = block;
+            block += blocksize;
+        }
+    }
+
+    void *alloc()
+    {
+        if(!freelist) grow();
+        void *block = freelist;
+        freelist = *(void **)block;
+        numused++;
+        return block;
+    }
+
+    void release(void *block)
+    {
+        *(void **)block = freelist;
+        freelist = block;
+        numused--;
+    }
+
+    void trim()
+    {
+        if(numused) return;
+        while(slabs)
+        {
+            slab *s = slabs;
+            slabs = s->next;
+            delete[] (uchar *)s;
+        }
+        numslabs = 0;
+        freelist = NULL;
+    }
+};
+
+// extensions are rounded up to a size class of vertex slots, every 4 verts up to 32 and then roughly every 1.5x
+static const uchar cubeextclasses[] = { 0, 4, 8, 12, 16, 20, 24, 28, 32, 48, 64, 96, 128, 192, 255 };
+#define NUMCUBEEXTCLASSES int(sizeof(cubeextclasses)/sizeof(cubeextclasses[0]))
+
+static octapool cubepool = { 8*sizeof(cube), 0, 0, NULL, NULL }, cubeextpools[NUMCUBEEXTCLASSES];
+// calclight's workers grow and replace extensions concurrently, so the extension pools are only touched under this lock
+static SDL_SpinLock cubeextlock = 0;
+
+static inline int cubeextclass(int maxverts)
+{
+    int n = 0;
+    while(cubeextclasses[n] < maxverts) n++;
+    return n;
+}
+
+static inline octapool &cubeextpool(int maxverts)
+{
+    octapool &pool = cubeextpools[cubeextclass(maxverts)];
+    if(!pool.blocksize) pool.blocksize = sizeof(cubeext) + maxverts*sizeof(vertinfo);
+    return pool;
+}
+
+void trimoctapools()
+{
+    cubepool.trim();
+    loopi(NUMCUBEEXTCLASSES) cubeextpools[i].trim();
+}
+
+ICOMMAND(octapoolstats, "", (),
+{
+    conoutf("cubes: %d families in use, %d slabs, %d KB", cubepool.numused, cubepool.numslabs, cubepool.numslabs*OCTAPOOLSLAB/1024);
+    loopi(NUMCUBEEXTCLASSES)
+    {
+        octapool &pool = cubeextpools[i];
+        if(pool.numslabs) conoutf("cubeext %d verts: %d in use, %d slabs, %d KB", cubeextclasses[i], pool.numused, pool.numslabs, pool.numslabs*OCTAPOOLSLAB/1024);
+    }
+});
+
 cube *worldroot = newcubes(F_SOLID);
 int allocnodes = 0;
 
 cubeext *growcubeext(cubeext *old, int maxverts)
 {
-    cubeext *ext = (cubeext *)new uchar[sizeof(cubeext) + maxverts*sizeof(vertinfo)];
+    maxverts = cubeextclasses[cubeextclass(maxverts)];
+    SDL_AtomicLock(&cubeextlock);
+    cubeext *ext = (cubeext *)cubeextpool(maxverts).alloc();
+    SDL_AtomicUnlock(&cubeextlock);
     if(old)
     {
         ext->va = old->va;
@@ -43,7 +147,10 @@ void setcubeext(cube &c, cubeext *ext)
     cubeext *old = c.ext;
     if(old == ext) return;
     c.ext = ext;
-    if(old) delete[] (uchar *)old;
+    if(!old) return;
+    SDL_AtomicLock(&cubeextlock);
+    cubeextpool(old->maxverts).release(old);
+    SDL_AtomicUnlock(&cubeextlock);
 }
 
 cubeext *newcubeext(cube &c, int maxverts, bool init)
@@ -65,7 +172,7 @@ cubeext *newcubeext(cube &c, int maxverts, bool init)
 
 cube *newcubes(uint face, int mat)
 {
-    cube *c = new cube[8];
+    cube *c = (cube *)cubepool.alloc();
     loopi(8)
     {
         c->children = NULL;
@@ -92,7 +199,7 @@ void freeocta(cube *c)
 {
     if(!c) return;
     loopi(8) discardchildren(c[i]);
-    delete[] c;
+    cubepool.release(c);
     allocnodes--;
 }
 
@@ -100,7 +207,9 @@ void freecubeext(cube &c)
 {
     if(c.ext)
     {
-        delete[] (uchar *)c.ext;
+        SDL_AtomicLock(&cubeextlock);
+        cubeextpool(c.ext->maxverts).release(c.ext);
+        SDL_AtomicUnlock(&cubeextlock);
         c.ext = NULL;
     }
 }
@@ -131,7 +240,8 @@ void discardchildren(cube &c, bool fixtex, int depth)
             loopi(6) c.texture[i] = getmippedtexture(c, i);
             if(depth > 0 && filled != F_EMPTY) c.faces[0] = F_SOLID;
         }
-        DELETEA(c.children);
+        cubepool.release(c.children);
+        c.children = NULL;
         allocnodes--;
     }
 }
@@ -475,7 +585,7 @@ VAR(mipvis, 0, 0, 1);
 
 static int remipprogress = 0, remiptotal = 0;
 
-bool remip(cube &c, const ivec &co, int size)
+bool remip(cube &c, const ivec &co, int size, const ivec &bbmin, const ivec &bbmax)
 {
     cube *ch = c.children;
     if(!ch)
@@ -487,10 +597,13 @@ bool remip(cube &c, const ivec &co, int size)
     else if((remipprogress++&0xFFF)==1) renderprogress(float(remipprogress)/remiptotal, "remipping...");
 
     bool perfect = true;
+    uchar possible = octaboxoverlap(co, size, bbmin, bbmax);
     loopi(8)
     {
+        // children outside the region were already remipped, so any that still have children could not be merged
+        if(!(possible&(1<<i))) { if(ch[i].children || size > 0x1000) perfect = false; continue; }
         ivec o(i, co, size);
-        if(!remip(ch[i], o, size>>1)) perfect = false;
+        if(!remip(ch[i], o, size>>1, bbmin, bbmax)) perfect = false;
     }
 
     solidfaces(c); // so texmip is more consistent
@@ -564,24 +677,36 @@ bool remip(cube &c, const ivec &co, int size)
     return true;
 }
 
-void remip()
+editregion remipregion;
+
+// only remips what was edited since the last remip, returns true if that was the whole world
+bool remip()
 {
+    if(remipregion.empty()) return false;
+    bool all = remipregion.whole();
+    ivec bbmin = remipregion.bbmin, bbmax = remipregion.bbmax;
+    // drop the vertex arrays and merges around the region first, so only those get merged again below
+    if(!all) changed(bbmin, bbmax, false);
+    remipregion.reset();
+
     remipprogress = 1;
     remiptotal = allocnodes;
-    loopi(8)
+    uchar possible = octaboxoverlap(ivec(0, 0, 0), worldsize>>1, bbmin, bbmax);
+    loopi(8) if(possible&(1<<i))
     {
         ivec o(i, ivec(0, 0, 0), worldsize>>1);
-        remip(worldroot[i], o, worldsize>>2);
+        remip(worldroot[i], o, worldsize>>2, bbmin, bbmax);
     }
-    calcmerges();
+    calcmerges(!all);
+    return all;
 }
 
 void mpremip(bool local)
 {
     extern selinfo sel;
     if(local) game::edittrigger(sel, EDIT_REMIP);
-    remip();
-    allchanged();
+    if(remip()) allchanged();
+    else commitchanges();
 }
 
 ICOMMAND(remip, "", (), mpremip(true));
@@ -1769,7 +1894,7 @@ struct cfpolys
 
 static hashtable<cfkey, cfpolys> cpolys;
 
-void genmerges(cube *c = worldroot, const ivec &o = ivec(0, 0, 0), int size = worldsize>>1)
+void genmerges(cube *c = worldroot, const ivec &o = ivec(0, 0, 0), int size = worldsize>>1, bool dirtyonly = false)
 {
     if((genmergeprogress++&0xFFF)==0) renderprogress(float(genmergeprogress)/allocnodes, "merging faces...");
     neighbourstack[++neighbourdepth] = c;
@@ -1777,7 +1902,8 @@ void genmerges(cube *c = worldroot, const ivec &o = ivec(0, 0, 0), int size = wo
     {
         ivec co(i, o, size);
         int vis;
-        if(c[i].children) genmerges(c[i].children, co, size>>1);
+        if(dirtyonly && c[i].ext && c[i].ext->va) continue; // still built, so its merges are intact
+        if(c[i].children) genmerges(c[i].children, co, size>>1, dirtyonly);
         else if(!isempty(c[i])) loopj(6) if((vis = visibletris(c[i], j, co, size)))
         {
             cfkey k;
@@ -1879,9 +2005,9 @@ void invalidatemerges(cube &c, const ivec &co, int size, bool msg)
     invalidatemerges(c);
 }
 
-void calcmerges()
+void calcmerges(bool dirtyonly)
 {
     genmergeprogress = 0;
-    genmerges();
+    genmerges(worldroot, ivec(0, 0, 0), worldsize>>1, dirtyonly);
 }
 
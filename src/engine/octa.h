@@ -225,17 +225,14 @@ struct editinfo
 };
 
 struct undoent   { int i; entity e; };
+struct undopack; // compressed cubes of a cube undo record, shared between identical records
 struct undoblock // undo header, all data sits in payload
 {
     undoblock *prev, *next;
     int size, timestamp, numents; // if numents is 0, is a cube undo record, otherwise an entity undo record
+    undopack *pack;
 
-    block3 *block() { return (block3 *)(this + 1); }
-    uchar *gridmap()
-    {
-        block3 *ub = block();
-        return (uchar *)(ub->c() + ub->size());
-    }
+    block3 *block() { return (block3 *)(this + 1); } // only the header, the cubes are in pack
     undoent *ents() { return (undoent *)(this + 1); }
 };
 
@@ -531,6 +531,7 @@ void tryedit()
 //////////// ready changes to vertex arrays ////////////
 
 static bool haschanged = false;
+static editregion commitregion;
 
 void readychanges(const ivec &bbmin, const ivec &bbmax, cube *c, const ivec &cor, int size)
 {
@@ -572,17 +573,30 @@ void commitchanges(bool force)
     resetclipplanes();
     entitiesinoctanodes();
     inbetweenframes = false;
+    extern int filltjoints;
+    if(filltjoints && !commitregion.empty()) findtjoints(commitregion.bbmin, commitregion.bbmax);
+    ivec bbmin = commitregion.bbmin, bbmax = commitregion.bbmax;
+    commitregion.reset();
     octarender();
     inbetweenframes = true;
     setupmaterials(oldlen);
-    clearshadowcache();
+    clearshadowmaps();
+    clearshadowmeshes(bbmin, bbmax);
     updatevabbs();
 }
 
-void changed(const ivec &bbmin, const ivec &bbmax, bool commit)
+static inline void markchanged(const ivec &bbmin, const ivec &bbmax)
 {
     readychanges(bbmin, bbmax, worldroot, ivec(0, 0, 0), worldsize/2);
     haschanged = true;
+    commitregion.add(bbmin, bbmax);
+    remipregion.add(bbmin, bbmax);
+    recalcregion.add(bbmin, bbmax);
+}
+
+void changed(const ivec &bbmin, const ivec &bbmax, bool commit)
+{
+    markchanged(bbmin, bbmax);
 
     if(commit) commitchanges();
 }
@@ -590,8 +604,7 @@ void changed(const ivec &bbmin, const ivec &bbmax, bool commit)
 void changed(const block3 &sel, bool commit)
 {
     if(sel.s.iszero()) return;
-    readychanges(ivec(sel.o).sub(1), ivec(sel.s).mul(sel.grid).add(sel.o).add(1), worldroot, ivec(0, 0, 0), worldsize/2);
-    haschanged = true;
+    markchanged(ivec(sel.o).sub(1), ivec(sel.s).mul(sel.grid).add(sel.o).add(1));
 
     if(commit) commitchanges();
 }
@@ -644,36 +657,8 @@ void selgridmap(const selinfo &sel, uchar *g)                           // gener
     loopxyz(sel, -sel.grid, (*g++ = bitscan(lusize), (void)c));
 }
 
-void freeundo(undoblock *u)
-{
-    if(!u->numents) freeblock(u->block(), false);
-    delete[] (uchar *)u;
-}
-
-void pasteundoblock(block3 *b, uchar *g)
-{
-    cube *s = b->c();
-    loopxyz(*b, 1<<min(int(*g++), worldscale-1), pastecube(*s++, c));
-}
-
-void pasteundo(undoblock *u)
-{
-    if(u->numents) pasteundoents(u);
-    else pasteundoblock(u->block(), u->gridmap());
-}
-
-static inline int undosize(undoblock *u)
-{
-    if(u->numents) return u->numents*sizeof(undoent);
-    else
-    {
-        block3 *b = u->block();
-        cube *q = b->c();
-        int size = b->size(), total = size;
-        loopj(size) total += familysize(*q++)*sizeof(cube);
-        return total;
-    }
-}
+template<class B> static void packcube(cube &c, B &buf);
+template<class B> static void unpackcube(cube &c, B &buf);
 
 struct undolist
 {
@@ -718,6 +703,106 @@ undolist undos, redos;
 VARP(undomegs, 0, 5, 100);                              // bounded by n megs
 int totalundos = 0;
 
+// cube undo records keep the grid map and cubes of the selection packed in the encoding used to send edits,
+// deflated at the fastest level, and records with identical contents (undoing and redoing an edit) share one pack
+struct undopack
+{
+    undopack *next;
+    uint hash;
+    int refs, len, rawlen, numgrids, numcubes, remap;
+
+    uchar *data() { return (uchar *)(this + 1); }
+    int size() const { return sizeof(undopack) + len; }
+};
+
+#define UNDOPACKHASH 256
+
+static undopack *undopacks[UNDOPACKHASH];
+static int numundopacks = 0, undopackbytes = 0, undorawbytes = 0;
+static vector<uchar> undobuf, undozbuf;
+
+static undopack *shareundopack(const uchar *raw, int rawlen, int numgrids, int numcubes)
+{
+    uLongf len = compressBound(rawlen);
+    undozbuf.setsize(0);
+    if(compress2(undozbuf.pad(len), &len, raw, rawlen, Z_BEST_SPEED) != Z_OK) return NULL;
+    uint hash = crc32(crc32(0, NULL, 0), undozbuf.getbuf(), len);
+    undopack *&bucket = undopacks[hash&(UNDOPACKHASH-1)];
+    for(undopack *p = bucket; p; p = p->next) if(p->hash == hash && p->len == int(len) && p->numgrids == numgrids && !memcmp(p->data(), undozbuf.getbuf(), len))
+    {
+        p->refs++;
+        return p;
+    }
+    undopack *p = (undopack *)new (false) uchar[sizeof(undopack) + len];
+    if(!p) return NULL;
+    p->next = bucket;
+    p->hash = hash;
+    p->refs = 1;
+    p->len = len;
+    p->rawlen = rawlen;
+    p->numgrids = numgrids;
+    p->numcubes = numcubes;
+    memcpy(p->data(), undozbuf.getbuf(), len);
+    bucket = p;
+    numundopacks++;
+    undopackbytes += p->size();
+    undorawbytes += rawlen;
+    totalundos += p->size();
+    return p;
+}
+
+static void releaseundopack(undopack *p)
+{
+    if(--p->refs > 0) return;
+    for(undopack **prev = &undopacks[p->hash&(UNDOPACKHASH-1)]; *prev; prev = &(*prev)->next) if(*prev == p)
+    {
+        *prev = p->next;
+        break;
+    }
+    numundopacks--;
+    undopackbytes -= p->size();
+    undorawbytes -= p->rawlen;
+    totalundos -= p->size();
+    delete[] (uchar *)p;
+}
+
+// inflates a pack into undobuf
+static bool unpackundopack(undopack *p)
+{
+    undobuf.setsize(0);
+    uLongf len = p->rawlen;
+    return uncompress(undobuf.pad(p->rawlen), &len, p->data(), p->len) == Z_OK && int(len) == p->rawlen;
+}
+
+void freeundo(undoblock *u)
+{
+    if(!u->numents && u->pack) releaseundopack(u->pack);
+    delete[] (uchar *)u;
+}
+
+void pasteundoblock(block3 *b, uchar *g)
+{
+    cube *s = b->c();
+    loopxyz(*b, 1<<min(int(*g++), worldscale-1), pastecube(*s++, c));
+}
+
+void pasteundo(undoblock *u)
+{
+    if(u->numents) pasteundoents(u);
+    else if(unpackundopack(u->pack))
+    {
+        block3 &b = *u->block();
+        ucharbuf buf(undobuf.getbuf(), undobuf.length());
+        const uchar *g = buf.pad(b.size());
+        loopxyz(b, 1<<min(int(*g++), worldscale-1), { discardchildren(c); unpackcube(c, buf); });
+    }
+}
+
+static inline int undosize(undoblock *u)
+{
+    return sizeof(undoblock) + (u->numents ? u->numents*sizeof(undoent) : sizeof(block3));
+}
+
 void pruneundos(int maxremain)                          // bound memory
 {
     while(totalundos > maxremain && !undos.empty())
@@ -739,19 +824,31 @@ void clearundos() { pruneundos(0); }
 
 COMMAND(clearundos, "");
 
+void undostats()
+{
+    int numundos = 0, numredos = 0;
+    for(undoblock *u = undos.first; u; u = u->next) numundos++;
+    for(undoblock *u = redos.first; u; u = u->next) numredos++;
+    conoutf("undo: %d undos, %d redos, %d cube packs, %d KB packed from %d KB, %d KB of %d KB used",
+        numundos, numredos, numundopacks, undopackbytes>>10, undorawbytes>>10, totalundos>>10, undomegs<<10);
+}
+
+COMMAND(undostats, "");
+
 undoblock *newundocube(const selinfo &s)
 {
-    int ssize = s.size(),
-        selgridsize = ssize,
-        blocksize = sizeof(block3)+ssize*sizeof(cube);
-    if(blocksize <= 0 || blocksize > (undomegs<<20)) return NULL;
-    undoblock *u = (undoblock *)new (false) uchar[sizeof(undoblock) + blocksize + selgridsize];
-    if(!u) return NULL;
+    int ssize = s.size(), numcubes = 0;
+    if(ssize <= 0 || ssize > (1<<20)) return NULL;
+    undobuf.setsize(0);
+    selgridmap(s, undobuf.pad(ssize));
+    loopxyz(s, -s.grid, { numcubes += familysize(c); packcube(c, undobuf); });
+    undopack *p = shareundopack(undobuf.getbuf(), undobuf.length(), ssize, numcubes);
+    if(!p) return NULL;
+    undoblock *u = p->size() <= (undomegs<<20) ? (undoblock *)new (false) uchar[sizeof(undoblock) + sizeof(block3)] : NULL;
+    if(!u) { releaseundopack(p); return NULL; }
     u->numents = 0;
-    block3 *b = u->block();
-    blockcopy(s, -s.grid, b);
-    uchar *g = u->gridmap();
-    selgridmap(s, g);
+    u->pack = p;
+    *u->block() = s;
     return u;
 }
 
@@ -779,15 +876,6 @@ void makeundo()                        // stores state of selected cubes before
     makeundo(sel);
 }
 
-static inline int countblock(cube *c, int n = 8)
-{
-    int r = n;
-    loopi(n) if(c[i].children) r += countblock(c[i].children);
-    return r;
-}
-                
-static int countblock(block3 *b) { return countblock(b->c(), b->size()); }
-
 void swapundo(undolist &a, undolist &b, int op)
 {
     if(noedit()) return;
@@ -799,7 +887,7 @@ void swapundo(undolist &a, undolist &b, int op)
         for(undoblock *u = a.last; u && ts==u->timestamp; u = u->prev)
         {
             ++ops;
-            n += u->numents ? u->numents : countblock(u->block());
+            n += u->numents ? u->numents : u->pack->numcubes;
             if(ops > 10 || n > 500)
             {
                 if(nompedit) { multiplayer(); return; }
@@ -1087,10 +1175,25 @@ bool packundo(undoblock *u, int &inlen, uchar *&outbuf, int &outlen)
     }
     else
     {
-        block3 &b = *u->block();
-        if(!packblock(b, buf)) return false;
-        buf.put(u->gridmap(), b.size());
-        packvslots(b, buf);
+        // vslots are gathered from real cubes, so the pack is expanded into a temporary block
+        block3 &hdr = *u->block();
+        if(!unpackundopack(u->pack)) return false;
+        block3 *b = (block3 *)new (false) uchar[sizeof(block3)+hdr.size()*sizeof(cube)];
+        if(!b) return false;
+        *b = hdr;
+        cube *c = b->c();
+        memset(c, 0, b->size()*sizeof(cube));
+        ucharbuf ubuf(undobuf.getbuf(), undobuf.length());
+        const uchar *g = ubuf.pad(b->size());
+        loopi(b->size()) unpackcube(c[i], ubuf);
+        bool packed = packblock(*b, buf);
+        if(packed)
+        {
+            buf.put(g, b->size());
+            packvslots(*b, buf);
+        }
+        freeblock(b);
+        if(!packed) return false;
     }
     inlen = buf.length();
     return compresseditinfo(buf.getbuf(), buf.length(), outbuf, outlen);
@@ -1522,6 +1625,61 @@ struct vslotref
 };
 #define editingvslot(...) vslotref vslotrefs[] = { __VA_ARGS__ }; (void)vslotrefs;
  
+// remaps the vslot indices of a cube packed by packcube in place
+static bool compactundocube(uchar *&p, const uchar *end)
+{
+    if(p >= end) return false;
+    if(*p++ == 0xFF)
+    {
+        loopi(8) if(!compactundocube(p, end)) return false;
+        return true;
+    }
+    cube c;
+    if(end - p < int(1 + sizeof(c.edges) + sizeof(c.texture))) return false;
+    p += 1 + sizeof(c.edges);
+    memcpy(c.texture, p, sizeof(c.texture));
+    lilswap(c.texture, 6);
+    loopi(6)
+    {
+        int index = c.texture[i];
+        compactvslot(index);
+        c.texture[i] = index;
+    }
+    lilswap(c.texture, 6);
+    memcpy(p, c.texture, sizeof(c.texture));
+    p += sizeof(c.texture);
+    return true;
+}
+
+// every pack is inflated, remapped and shared again, so packs that now come out identical are merged
+static void compactundopacks()
+{
+    vector<undopack *> packs, remapped;
+    loopi(UNDOPACKHASH) for(undopack *p = undopacks[i]; p; p = p->next) packs.add(p);
+    loopv(packs)
+    {
+        undopack *p = packs[i], *np = NULL;
+        p->remap = i;
+        if(unpackundopack(p))
+        {
+            uchar *buf = undobuf.getbuf() + p->numgrids, *end = undobuf.getbuf() + undobuf.length();
+            bool valid = true;
+            loopj(p->numgrids) if(!compactundocube(buf, end)) { valid = false; break; }
+            if(valid) np = shareundopack(undobuf.getbuf(), undobuf.length(), p->numgrids, p->numcubes);
+        }
+        if(!np) { np = p; p->refs++; }
+        remapped.add(np);
+    }
+    loopk(2) for(undoblock *u = k ? redos.first : undos.first; u; u = u->next) if(!u->numents)
+    {
+        undopack *p = u->pack;
+        u->pack = remapped[p->remap];
+        u->pack->refs++;
+        releaseundopack(p);
+    }
+    loopv(remapped) releaseundopack(remapped[i]);
+}
+
 void compacteditvslots()
 {
     loopv(editingvslots) if(*editingvslots[i]) compactvslot(*editingvslots[i]);
@@ -1531,12 +1689,7 @@ void compacteditvslots()
         editinfo *e = editinfos[i];
         compactvslots(e->copy->c(), e->copy->size());
     }
-    for(undoblock *u = undos.first; u; u = u->next)
-        if(!u->numents)
-            compactvslots(u->block()->c(), u->block()->size());
-    for(undoblock *u = redos.first; u; u = u->next)
-        if(!u->numents)
-            compactvslots(u->block()->c(), u->block()->size());
+    compactundopacks();
 }
 
 ///////////// height maps ////////////////
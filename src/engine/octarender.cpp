@@ -946,7 +946,8 @@ enum
     CE_START = 1<<0,
     CE_END   = 1<<1,
     CE_FLIP  = 1<<2,
-    CE_DUP   = 1<<3
+    CE_DUP   = 1<<3,
+    CE_KEEP  = 1<<4  // only checked against, its cube keeps the t-joints it has
 };
 
 struct cubeedge
@@ -960,7 +961,7 @@ struct cubeedge
 vector<cubeedge> cubeedges;
 hashtable<edgegroup, int> edgegroups(1<<13);
 
-void gencubeedges(cube &c, const ivec &co, int size)
+void gencubeedges(cube &c, const ivec &co, int size, int flags = 0)
 {
     ivec pos[MAXFACEVERTS];
     int vis;
@@ -1014,7 +1015,7 @@ void gencubeedges(cube &c, const ivec &co, int size)
             ce.offset = t1;
             ce.size = t2 - t1;
             ce.index = i*(MAXFACEVERTS+1)+j;
-            ce.flags = CE_START | CE_END | (e1!=j ? CE_FLIP : 0);
+            ce.flags = CE_START | CE_END | (e1!=j ? CE_FLIP : 0) | flags;
             ce.next = -1;
 
             bool insert = true;
@@ -1075,6 +1076,38 @@ void gencubeedges(cube *c = worldroot, const ivec &co = ivec(0, 0, 0), int size
     --neighbourdepth;
 }
 
+// bounds of the leaf cubes touching a region, which are the ones that get new t-joints
+static void tjointbounds(cube *c, const ivec &co, int size, const ivec &bbmin, const ivec &bbmax, ivec &leafmin, ivec &leafmax)
+{
+    loopoctabox(co, size, bbmin, bbmax)
+    {
+        ivec o(i, co, size);
+        if(c[i].children) tjointbounds(c[i].children, o, size>>1, bbmin, bbmax, leafmin, leafmax);
+        else if(!isempty(c[i]))
+        {
+            leafmin.min(o);
+            leafmax.max(ivec(o).add(size));
+        }
+    }
+}
+
+// edges of every cube along those leaves are gathered, but only the cubes touching the region are refilled
+static void gencubeedges(cube *c, const ivec &co, int size, const ivec &bbmin, const ivec &bbmax, const ivec &leafmin, const ivec &leafmax, int flags = 0)
+{
+    progress("fixing t-joints...");
+    neighbourstack[++neighbourdepth] = c;
+    uchar touched = flags ? 0 : octaboxoverlap(co, size, bbmin, bbmax);
+    loopoctabox(co, size, leafmin, leafmax)
+    {
+        ivec o(i, co, size);
+        int cflags = touched&(1<<i) ? 0 : CE_KEEP;
+        if(!cflags && c[i].ext) c[i].ext->tjoints = -1;
+        if(c[i].children) gencubeedges(c[i].children, o, size>>1, bbmin, bbmax, leafmin, leafmax, cflags);
+        else if(!isempty(c[i])) gencubeedges(c[i], o, size, cflags);
+    }
+    --neighbourdepth;
+}
+
 void gencubeverts(cube &c, const ivec &co, int size, int csi)
 {
     if(!(c.visible&0xC0)) return;
@@ -1638,14 +1671,14 @@ void findtjoints(int cur, const edgegroup &g)
             else
             {
                 prevactive = curactive;
-                if(!(a.flags&CE_DUP))
+                if(!(a.flags&(CE_DUP|CE_KEEP)))
                 {
                     if(e.flags&CE_START && e.offset > a.offset && e.offset < a.offset+a.size)
                         addtjoint(g, a, e.offset);
                     if(e.flags&CE_END && e.offset+e.size > a.offset && e.offset+e.size < a.offset+a.size)
                         addtjoint(g, a, e.offset+e.size);
                 }
-                if(!(e.flags&CE_DUP))
+                if(!(e.flags&(CE_DUP|CE_KEEP)))
                 {
                     if(a.flags&CE_START && a.offset > e.offset && a.offset < e.offset+e.size)
                         addtjoint(g, e, a.offset);
@@ -1662,6 +1695,8 @@ void findtjoints(int cur, const edgegroup &g)
     }
 }
 
+static int livetjoints = 0;
+
 void findtjoints()
 {
     recalcprogress = 0;
@@ -1670,6 +1705,51 @@ void findtjoints()
     enumeratekt(edgegroups, edgegroup, g, int, e, findtjoints(e, g));
     cubeedges.setsize(0);
     edgegroups.clear();
+    livetjoints = tjoints.length();
+}
+
+static void compacttjoints(cube *c, vector<tjoint> &dst)
+{
+    loopi(8)
+    {
+        if(c[i].ext && c[i].ext->tjoints >= 0)
+        {
+            int cur = c[i].ext->tjoints;
+            c[i].ext->tjoints = dst.length();
+            while(cur >= 0)
+            {
+                tjoint &tj = dst.add(tjoints[cur]);
+                cur = tj.next;
+                tj.next = cur >= 0 ? dst.length() : -1;
+            }
+        }
+        if(c[i].children) compacttjoints(c[i].children, dst);
+    }
+}
+
+// refills the t-joints of the cubes touching a region, whose vertex arrays must already be invalidated
+void findtjoints(const ivec &bbmin, const ivec &bbmax)
+{
+    ivec leafmin(INT_MAX, INT_MAX, INT_MAX), leafmax(INT_MIN, INT_MIN, INT_MIN);
+    tjointbounds(worldroot, ivec(0, 0, 0), worldsize>>1, bbmin, bbmax, leafmin, leafmax);
+    if(leafmin.x > leafmax.x) return;
+    leafmin.sub(1);
+    leafmax.add(1);
+
+    recalcprogress = 0;
+    gencubeedges(worldroot, ivec(0, 0, 0), worldsize>>1, bbmin, bbmax, leafmin, leafmax);
+    enumeratekt(edgegroups, edgegroup, g, int, e, findtjoints(e, g));
+    cubeedges.setsize(0);
+    edgegroups.clear();
+
+    // lists of refilled cubes are left behind, so squeeze them out once they outweigh the live ones
+    if(tjoints.length() > max(2*livetjoints, 1<<16))
+    {
+        vector<tjoint> live;
+        compacttjoints(worldroot, live);
+        tjoints.move(live);
+        livetjoints = tjoints.length();
+    }
 }
 
 void octarender()                               // creates va s for all leaf cubes that don't already have them
@@ -1744,13 +1824,27 @@ void allchanged(bool load)
         seedparticles();
         genenvmaps();
         drawminimap();
+        recalcregion.reset();
     }
 }
 
-void recalc()
+editregion recalcregion;
+
+// with edits since the last recalc only redoes what they touched, unless asked to redo all
+void recalc(bool all)
 {
-    allchanged(true);
+    if(all || recalcregion.empty() || recalcregion.whole())
+    {
+        allchanged(true);
+        return;
+    }
+    ivec bbmin = recalcregion.bbmin, bbmax = recalcregion.bbmax;
+    commitchanges();
+    genshadowmeshes(bbmin, bbmax);
+    updateblendtextures(bbmin.x, bbmin.y, bbmax.x, bbmax.y);
+    drawminimap();
+    recalcregion.reset();
 }
 
-COMMAND(recalc, "");
+ICOMMAND(recalc, "i", (int *all), recalc(*all!=0));
 
@@ -1946,6 +1946,7 @@ void interppos(physent *pl)
 
 void moveplayer(physent *pl, int moveres, bool local)
 {
+    PROFILE("physics");
     if(physsteps <= 0)
     {
         if(local) interppos(pl);
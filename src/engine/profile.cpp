@@ -0,0 +1,287 @@
+// profile.cpp: hierarchical cpu zone timers for the client and the dedicated server
+// every thread records finished zones into its own ring, which only that thread writes, so recording takes no locks
+// the main thread folds its ring into per-frame averages for the hud and the server status log,
+// and profiledump writes every ring out as a chrome://tracing json file
+
+#include "engine.h"
+
+#ifdef __GNUC__
+#define PROFILETLS __thread
+#else
+#define PROFILETLS __declspec(thread)
+#endif
+
+#ifdef STANDALONE
+// the client's clock in main.cpp comes from SDL, which the dedicated server does not link
+uint getclockmicros()
+{
+#ifdef WIN32
+    static LARGE_INTEGER freq = { 0 };
+    if(!freq.QuadPart) QueryPerformanceFrequency(&freq);
+    LARGE_INTEGER ticks;
+    QueryPerformanceCounter(&ticks);
+    return uint((ticks.QuadPart/freq.QuadPart)*1000000 + ((ticks.QuadPart%freq.QuadPart)*1000000)/freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint(ts.tv_sec*1000000ULL + ts.tv_nsec/1000);
+#endif
+}
+#endif
+
+struct profilerecord
+{
+    const char *name;
+    uint start, end;
+    int depth;
+};
+
+struct profilering
+{
+    enum { SIZE = 1<<14, MAXDEPTH = 32 };
+
+    profilerecord records[SIZE];
+    uint head, framehead;
+    int used, depth, tid;
+    bool framed;
+    const char *name;
+    const char *stacknames[MAXDEPTH];
+    uint stackstarts[MAXDEPTH];
+};
+
+#define MAXPROFILERINGS 64
+
+static profilering *profilerings[MAXPROFILERINGS];
+static int numprofilerings = 0, nextprofiletid = 0;
+static uint profileepoch = 0;
+static PROFILETLS profilering *curprofilering = NULL;
+static PROFILETLS const char *curprofilethread = NULL;
+static PROFILETLS bool curprofileframed = false;
+static profilering *mainprofilering = NULL;
+
+VARFN(profile, profiling, 0, 0, 1,
+{
+    if(profiling && !profileepoch) profileepoch = getclockmicros();
+});
+
+// rings outlive the threads that wrote them so their zones can still be dumped, and a finished thread's ring is handed to the next new one
+static profilering *claimprofilering()
+{
+    loopi(min(atomicload(numprofilerings), MAXPROFILERINGS))
+    {
+        profilering *r = profilerings[i];
+        if(r && atomiccas(r->used, 0, 1)) { r->framehead = atomicload(r->head); return r; }
+    }
+    int i = atomicadd(numprofilerings, 1) - 1;
+    if(i >= MAXPROFILERINGS) return NULL;
+    profilering *r = new profilering;
+    r->head = r->framehead = 0;
+    r->used = 1;
+    r->tid = atomicadd(nextprofiletid, 1);
+    atomicstore(profilerings[i], r);
+    return r;
+}
+
+static inline profilering *getprofilering()
+{
+    if(!curprofilering)
+    {
+        curprofilering = claimprofilering();
+        if(!curprofilering) return NULL;
+        curprofilering->depth = 0;
+        curprofilering->framed = curprofileframed;
+        curprofilering->name = curprofilethread ? curprofilethread : "thread";
+    }
+    return curprofilering;
+}
+
+// framed threads do their work in step with the main thread, so their zones are folded into its frames as well
+void profilethread(const char *name, bool framed)
+{
+    curprofilethread = name;
+    curprofileframed = framed;
+    if(curprofilering)
+    {
+        curprofilering->name = name;
+        curprofilering->framed = framed;
+    }
+}
+
+void profilethreaddone()
+{
+    if(!curprofilering) return;
+    atomicstore(curprofilering->used, 0);
+    curprofilering = NULL;
+}
+
+void beginprofile(const char *name)
+{
+    profilering *r = getprofilering();
+    if(!r) return;
+    if(r->depth < profilering::MAXDEPTH)
+    {
+        r->stacknames[r->depth] = name;
+        r->stackstarts[r->depth] = getclockmicros() - profileepoch;
+    }
+    r->depth++;
+}
+
+void endprofile()
+{
+    profilering *r = curprofilering;
+    if(!r || r->depth <= 0) return;
+    r->depth--;
+    if(r->depth >= profilering::MAXDEPTH) return;
+    profilerecord &rec = r->records[r->head&(profilering::SIZE-1)];
+    rec.name = r->stacknames[r->depth];
+    rec.start = r->stackstarts[r->depth];
+    rec.end = getclockmicros() - profileepoch;
+    rec.depth = r->depth;
+    atomicstore(r->head, r->head+1);
+}
+
+struct profilezonestats
+{
+    const char *name;
+    int depth, calls;
+    uint micros, first;
+};
+
+static vector<profilezonestats> profilewindow;
+static vector<profilestat> profilestats;
+static int profileframes = 0;
+
+static int sortprofilestats(const profilezonestats &x, const profilezonestats &y)
+{
+    return x.first < y.first;
+}
+
+static void foldprofile(profilering *r)
+{
+    uint head = atomicload(r->head);
+    if(head - r->framehead > uint(profilering::SIZE)) r->framehead = head - profilering::SIZE;
+    for(uint i = r->framehead; i != head; i++)
+    {
+        const profilerecord &rec = r->records[i&(profilering::SIZE-1)];
+        profilezonestats *s = NULL;
+        loopvj(profilewindow) if(profilewindow[j].name == rec.name && profilewindow[j].depth == rec.depth) { s = &profilewindow[j]; break; }
+        if(!s)
+        {
+            s = &profilewindow.add();
+            s->name = rec.name;
+            s->depth = rec.depth;
+            s->calls = 0;
+            s->micros = 0;
+            s->first = rec.start;
+        }
+        s->calls++;
+        s->micros += rec.end - rec.start;
+    }
+    r->framehead = head;
+}
+
+// called once per frame or server tick by the thread whose zones the hud and status log summarize
+void profileframe()
+{
+    if(!profiling) return;
+    profilering *r = getprofilering();
+    if(!r) return;
+    if(r != mainprofilering)
+    {
+        mainprofilering = r;
+        r->framehead = r->head;
+        profilewindow.setsize(0);
+        profileframes = 0;
+    }
+    foldprofile(r);
+    loopi(min(atomicload(numprofilerings), MAXPROFILERINGS))
+    {
+        profilering *f = atomicload(profilerings[i]);
+        if(f && f != r && f->framed && atomicload(f->used)) foldprofile(f);
+    }
+    profileframes++;
+}
+
+// averages the frames seen since the last call into per-frame times, listed parents first
+const vector<profilestat> &publishprofile()
+{
+    profilestats.setsize(0);
+    if(profileframes > 0)
+    {
+        profilewindow.sort(sortprofilestats);
+        loopv(profilewindow)
+        {
+            profilezonestats &s = profilewindow[i];
+            profilestat &p = profilestats.add();
+            p.name = s.name;
+            p.depth = s.depth;
+            p.millis = s.micros/(1000.0f*profileframes);
+            p.calls = s.calls/float(profileframes);
+        }
+    }
+    profilewindow.setsize(0);
+    profileframes = 0;
+    return profilestats;
+}
+
+// one status line per top level zone with its direct children, for the dedicated server's log
+void logprofile()
+{
+    const vector<profilestat> &stats = publishprofile();
+    loopv(stats) if(!stats[i].depth)
+    {
+        defformatstring(line, "profile: %s %.3f", stats[i].name, stats[i].millis);
+        for(int j = i+1; j < stats.length() && stats[j].depth; j++) if(stats[j].depth == 1)
+        {
+            defformatstring(zone, ", %s %.3f", stats[j].name, stats[j].millis);
+            concatstring(line, zone);
+        }
+        logoutf("%s (ms/tick)", line);
+    }
+}
+
+static void writejsonstring(stream *f, const char *s)
+{
+    f->putchar('"');
+    for(; *s; s++)
+    {
+        if(*s == '"' || *s == '\\') f->putchar('\\');
+        if(uchar(*s) >= 0x20) f->putchar(*s);
+    }
+    f->putchar('"');
+}
+
+void dumpprofile(const char *name)
+{
+    if(!name[0]) name = "profile.json";
+    stream *f = openutf8file(path(name, true), "w");
+    if(!f) { conoutf(CON_ERROR, "could not write profile to %s", name); return; }
+    f->printf("{\"traceEvents\":[\n");
+    int events = 0;
+    loopi(min(atomicload(numprofilerings), MAXPROFILERINGS))
+    {
+        profilering *r = atomicload(profilerings[i]);
+        if(!r) continue;
+        f->printf("%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", events++ ? ",\n" : "", r->tid);
+        writejsonstring(f, r->name);
+        f->printf("}}");
+        // the owning thread keeps writing while this reads, so anything it may have overwritten meanwhile is dropped
+        uint head = atomicload(r->head), tail = head > uint(profilering::SIZE) ? head - profilering::SIZE : 0;
+        vector<profilerecord> records;
+        for(uint j = tail; j != head; j++) records.add(r->records[j&(profilering::SIZE-1)]);
+        uint newhead = atomicload(r->head);
+        if(newhead + 1 - tail > uint(profilering::SIZE)) records.remove(0, min(int(newhead + 1 - tail - profilering::SIZE), records.length()));
+        loopvj(records)
+        {
+            const profilerecord &rec = records[j];
+            f->printf(",\n{\"name\":");
+            writejsonstring(f, rec.name);
+            f->printf(",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%u,\"dur\":%u}", r->tid, rec.start, rec.end - rec.start);
+            events++;
+        }
+    }
+    f->printf("\n]}\n");
+    delete f;
+    conoutf("wrote %d profile events to %s", events, name);
+}
+COMMANDN(profiledump, dumpprofile, "s");
@@ -245,23 +245,32 @@ struct pvsdata
 
 static vector<uchar> pvsbuf;
 
-static inline uint hthash(const pvsdata &k)
+// unique view cells while genpvs runs, keyed by contents that the worker finding them first copied out
+struct pvskey
+{
+    const uchar *buf;
+    int len;
+
+    pvskey() : buf(NULL), len(0) {}
+    pvskey(const uchar *buf, int len) : buf(buf), len(len) {}
+};
+
+static inline uint hthash(const pvskey &k)
 {
     uint h = 5381;
-    loopi(k.len) h = ((h<<5)+h)^pvsbuf[k.offset+i];
+    loopi(k.len) h = ((h<<5)+h)^k.buf[i];
     return h;
 }
 
-static inline bool htcmp(const pvsdata &x, const pvsdata &y)
+static inline bool htcmp(const pvskey &x, const pvskey &y)
 {
-    return x.len==y.len && !memcmp(&pvsbuf[x.offset], &pvsbuf[y.offset], x.len);
+    return x.len==y.len && !memcmp(x.buf, y.buf, x.len);
 }
 
-static SDL_mutex *pvsmutex = NULL;
-static hashtable<pvsdata, int> pvscompress;
+static concurrenthashtable<pvskey, int> pvscompress;
+static int numpvsids = 0;
 static vector<pvsdata> pvs;
 
-static SDL_mutex *viewcellmutex = NULL;
 struct viewcellrequest
 {
     int *result;
@@ -269,6 +278,7 @@ struct viewcellrequest
     int size;
 };
 static vector<viewcellrequest> viewcellrequests;
+static int nextviewcell = 0;
 
 static bool genpvs_canceled = false;
 static int numviewcells = 0;
@@ -298,6 +308,7 @@ struct pvsworker
 
     SDL_Thread *thread;
     pvsnode *pvsnodes;
+    vector<uchar> cellbuf;
 
     shaftbb viewcellbb;
 
@@ -775,40 +786,37 @@ struct pvsworker
         return buf;
     }
 
+    // returns an id for the cell's contents, shared by every cell with the same contents
+    // ids are unique but may skip numbers where workers raced on the same contents, storepvs() packs them
     int genviewcell(const ivec &co, int size)
     {
         calcpvs(co, size);
 
-        if(pvsmutex) SDL_LockMutex(pvsmutex);
-        numviewcells++;
-        pvsdata key(pvsbuf.length(), waterbytes + outbuf.length());
-        loopi(waterbytes) pvsbuf.add((wateroccluded>>(i*8))&0xFF);
-        pvsbuf.put(outbuf.getbuf(), outbuf.length());
+        atomicadd(numviewcells, 1);
+        cellbuf.setsize(0);
+        loopi(waterbytes) cellbuf.add((wateroccluded>>(i*8))&0xFF);
+        cellbuf.put(outbuf.getbuf(), outbuf.length());
+        pvskey key(cellbuf.getbuf(), cellbuf.length());
         int *val = pvscompress.access(key);
-        if(val) pvsbuf.setsize(key.offset);
-        else
-        {
-            val = &pvscompress[key];
-            *val = pvs.length();
-            pvs.add(key);
-        }
-        if(pvsmutex) SDL_UnlockMutex(pvsmutex);
-        return *val;
+        if(val) return *val;
+        uchar *buf = new uchar[key.len];
+        memcpy(buf, key.buf, key.len);
+        key.buf = buf;
+        int id = atomicadd(numpvsids, 1) - 1, result = pvscompress.access(key, id);
+        if(result != id) delete[] buf;
+        return result;
     }
 
     static int run(void *data)
     {
         pvsworker *w = (pvsworker *)data;
-        SDL_LockMutex(viewcellmutex);
-        while(viewcellrequests.length())
+        while(!atomicload(genpvs_canceled))
         {
-            viewcellrequest req = viewcellrequests.pop();
-            SDL_UnlockMutex(viewcellmutex);
-            int result = w->genviewcell(req.o, req.size);
-            SDL_LockMutex(viewcellmutex);
-            *req.result = result;
+            int i = atomicadd(nextviewcell, 1) - 1;
+            if(i >= viewcellrequests.length()) break;
+            viewcellrequest &req = viewcellrequests[i];
+            *req.result = w->genviewcell(req.o, req.size);
         }
-        SDL_UnlockMutex(viewcellmutex);
         return 0;
     }
 };
@@ -845,7 +853,7 @@ static Uint32 genpvs_timer(Uint32 interval, void *param)
 
 static int totalviewcells = 0;
 
-static void show_genpvs_progress(int unique = pvs.length(), int processed = numviewcells)
+static void show_genpvs_progress(int unique = pvscompress.length(), int processed = numviewcells)
 {
     float bar1 = float(processed) / float(totalviewcells>0 ? totalviewcells : 1);
 
@@ -853,7 +861,7 @@ static void show_genpvs_progress(int unique = pvs.length(), int processed = numv
 
     renderprogress(bar1, text1);
 
-    if(interceptkey(SDLK_ESCAPE)) genpvs_canceled = true;
+    if(interceptkey(SDLK_ESCAPE)) atomicstore(genpvs_canceled, true);
     check_genpvs_progress = false;
 }
 
@@ -946,6 +954,39 @@ static void genviewcells(viewcellnode &p, cube *c, const ivec &co, int size, int
 }
 
 static viewcellnode *viewcells = NULL;
+
+static void remapviewcells(viewcellnode &p, const vector<int> &remap)
+{
+    loopi(8)
+    {
+        if(!(p.leafmask&(1<<i))) remapviewcells(*p.children[i].node, remap);
+        else if(p.children[i].pvs >= 0) p.children[i].pvs = remap[p.children[i].pvs];
+    }
+}
+
+// packs the unique view cells into pvsbuf in the order they were found and renumbers the view cells to match
+static void storepvs(bool keep)
+{
+    vector<pvskey> found;
+    loopi(numpvsids) found.add(pvskey());
+    enumerateconcurrentkt(pvscompress, pvskey, key, int, id, found[id] = key);
+    vector<int> remap;
+    loopv(found)
+    {
+        const pvskey &key = found[i];
+        remap.add(key.buf ? pvs.length() : -1);
+        if(!key.buf) continue;
+        if(keep)
+        {
+            pvs.add(pvsdata(pvsbuf.length(), key.len));
+            pvsbuf.put(key.buf, key.len);
+        }
+        delete[] key.buf;
+    }
+    if(keep && viewcells) remapviewcells(*viewcells, remap);
+    pvscompress.clear();
+    numpvsids = 0;
+}
 static int lockedwaterplanes[MAXWATERPVS];
 static uchar *curpvs = NULL, *lockedpvs = NULL;
 static int curwaterpvs = 0, lockedwaterpvs = 0;
@@ -1122,6 +1163,8 @@ void genpvs(int *viewcellsize)
 
     totalviewcells = countviewcells(worldroot, ivec(0, 0, 0), worldsize>>1, *viewcellsize>0 ? *viewcellsize : 32);
     numviewcells = 0;
+    pvscompress.reserve(totalviewcells);
+    numpvsids = 0;
     genpvs_canceled = false;
     check_genpvs_progress = false;
     SDL_TimerID timer = 0;
@@ -1140,8 +1183,7 @@ void genpvs(int *viewcellsize)
     else
     {
         renderprogress(0, "creating threads");
-        if(!pvsmutex) pvsmutex = SDL_CreateMutex();
-        if(!viewcellmutex) viewcellmutex = SDL_CreateMutex();
+        nextviewcell = 0;
         loopi(numthreads)
         {
             pvsworker *w = pvsworkers.add(new pvsworker);
@@ -1151,21 +1193,16 @@ void genpvs(int *viewcellsize)
         while(!genpvs_canceled)
         {
             SDL_Delay(500);
-            SDL_LockMutex(viewcellmutex);
-            int unique = pvs.length(), processed = numviewcells, remaining = viewcellrequests.length();
-            SDL_UnlockMutex(viewcellmutex);
-            show_genpvs_progress(unique, processed);
-            if(!remaining) break;
+            show_genpvs_progress(pvscompress.length(), atomicload(numviewcells));
+            if(atomicload(nextviewcell) >= viewcellrequests.length()) break;
         }
-        SDL_LockMutex(viewcellmutex);
-        viewcellrequests.setsize(0);
-        SDL_UnlockMutex(viewcellmutex);
         loopv(pvsworkers) SDL_WaitThread(pvsworkers[i]->thread, NULL);
+        viewcellrequests.setsize(0);
     }
     pvsworkers.deletecontents();
 
     origpvsnodes.setsize(0);
-    pvscompress.clear();
+    storepvs(!genpvs_canceled);
 
     Uint32 end = SDL_GetTicks();
     if(genpvs_canceled)
@@ -1179,7 +1179,7 @@ int framemillis = 0; // frame time (ie does not take into account the swap)
 
 void printtimers(int conw, int conh)
 {
-    if(!frametimer && !usetimers) return;
+    if(!frametimer && !usetimers && !profiling) return;
 
     static int lastprint = 0;
     int offset = 0;
@@ -1198,6 +1198,17 @@ void printtimers(int conw, int conh)
         draw_textf("%s%s %5.2f ms", conw-20*FONTH, conh-FONTH*3/2-offset*9*FONTH/8, t.name, t.gpu ? "" : " (cpu)", t.print);
         offset++;
     }
+    if(profiling)
+    {
+        static const vector<profilestat> *printprofile = NULL;
+        if(!printprofile || totalmillis - lastprint >= 200) printprofile = &publishprofile();
+        loopvrev(*printprofile)
+        {
+            const profilestat &p = (*printprofile)[i];
+            draw_textf("%*s%s %5.2f ms", conw-20*FONTH, conh-FONTH*3/2-offset*9*FONTH/8, 2*p.depth, "", p.name, p.millis);
+            offset++;
+        }
+    }
     if(totalmillis - lastprint >= 200) lastprint = totalmillis;
 }
 
@@ -2893,6 +2904,7 @@ void gl_setupframe(bool force)
 
 void gl_drawframe()
 {
+    PROFILE("render");
     synctimers();
     xtravertsva = xtraverts = glde = gbatches = vtris = vverts = 0;
     flipqueries();
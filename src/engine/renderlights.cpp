@@ -1933,11 +1933,17 @@ hashset<lightbatch> lightbatcher(128);
 vector<lightbatch *> lightbatches;
 vector<shadowmapinfo> shadowmaps;
 
-void clearshadowcache()
+// leaves the shadow meshes alone, edits only drop those of the lights they reach
+void clearshadowmaps()
 {
     shadowmaps.setsize(0);
 
     clearradiancehintscache();
+}
+
+void clearshadowcache()
+{
+    clearshadowmaps();
     clearshadowmeshes();
 }
 
@@ -3463,13 +3469,29 @@ void viewlightscissor()
 
 void collectlights()
 {
+    PROFILE("light setup");
     if(lights.length()) return;
 
     // point lights processed here
     const vector<extentity *> &ents = entities::getents();
-    if(!editmode || !fullbright) loopv(ents)
+    static vector<int> lightents;
+    lightents.setsize(0);
+    if(!editmode || !fullbright)
+    {
+        // only lights binned near the visible part of the frustum can survive the fog cull
+        vec bbmin(-1e16f, -1e16f, -1e16f), bbmax(1e16f, 1e16f, 1e16f);
+        if(smviscull)
+        {
+            float tx = tan(curfov/2*RAD), ty = tan(fovy/2*RAD), reach = vfcDfog*sqrtf(1 + tx*tx + ty*ty);
+            bbmin = vec(camera1->o).sub(reach);
+            bbmax = vec(camera1->o).add(reach);
+        }
+        findlights(bbmin, bbmax, lightents);
+    }
+    loopv(lightents)
     {
-        const extentity *e = ents[i];
+        int idx = lightents[i];
+        const extentity *e = ents[idx];
         if(e->type != ET_LIGHT || e->attr1 <= 0) continue;
 
         if(smviscull)
@@ -3478,7 +3500,7 @@ void collectlights()
             if(pvsoccludedsphere(e->o, e->attr1)) continue;
         }
 
-        lightinfo &l = lights.add(lightinfo(i, *e));
+        lightinfo &l = lights.add(lightinfo(idx, *e));
         if(l.validscissor()) lightorder.add(lights.length()-1);
     }
 
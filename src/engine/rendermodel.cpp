@@ -360,6 +360,75 @@ void flushpreloadedmodels(bool msg)
     loadprogress = 0;
 }
 
+// BIH builds only read the meshes gathered for them, so they run on worker threads
+// while the main thread loads the remaining models and uploads their VBOs and shaders
+VARP(modelthreads, 0, 0, 16);
+
+struct bihtask
+{
+    model *m;
+    vector<BIH::mesh> meshes;
+    BIH *bih;
+};
+
+static vector<bihtask> bihtasks;
+static int nextbihtask = 0;
+
+static int bihworker(void *data)
+{
+    for(;;)
+    {
+        int i = atomicadd(nextbihtask, 1) - 1;
+        if(i >= bihtasks.length()) break;
+        bihtask &t = bihtasks[i];
+        PROFILE("bih");
+        t.bih = new BIH(t.meshes);
+    }
+    return 0;
+}
+
+static int bihthread(void *data)
+{
+    profilethread("bih worker");
+    bihworker(data);
+    profilethreaddone();
+    return 0;
+}
+
+static void queueBIH(model *m)
+{
+    if(m->bih) return;
+    loopv(bihtasks) if(bihtasks[i].m == m) return;
+    bihtask &t = bihtasks.add();
+    t.m = m;
+    t.bih = NULL;
+    m->genBIH(t.meshes);
+}
+
+static void buildBIHs(vector<SDL_Thread *> &threads)
+{
+    if(threads.empty()) bihworker(NULL);
+    else
+    {
+        loopv(threads) SDL_WaitThread(threads[i], NULL);
+        threads.setsize(0);
+    }
+    loopv(bihtasks)
+    {
+        bihtask &t = bihtasks[i];
+        if(!t.m->bih) t.m->bih = t.bih;
+        else delete t.bih;
+    }
+    bihtasks.setsize(0);
+}
+
+static void startBIHs(vector<SDL_Thread *> &threads)
+{
+    nextbihtask = 0;
+    int numthreads = min(modelthreads > 0 ? modelthreads : numcpus, bihtasks.length());
+    if(numthreads > 1) loopi(numthreads) threads.add(SDL_CreateThread(bihthread, "bih worker", NULL));
+}
+
 void preloadusedmapmodels(bool msg, bool bih)
 {
     vector<extentity *> &ents = entities::getents();
@@ -370,6 +439,7 @@ void preloadusedmapmodels(bool msg, bool bih)
         if(e.type==ET_MAPMODEL && e.attr1 >= 0 && used.find(e.attr1) < 0) used.add(e.attr1);
     }
 
+    vector<model *> loaded;
     vector<const char *> col;
     loopv(used)
     {
@@ -382,10 +452,9 @@ void preloadusedmapmodels(bool msg, bool bih)
         if(!m) { if(msg) conoutf(CON_WARN, "could not load map model: %s", mmi.name); }
         else
         {
-            if(bih) m->preloadBIH();
+            if(bih) queueBIH(m);
             else if(m->collide == COLLIDE_TRI && !m->collidemodel && m->bih) m->setBIH();
-            m->preloadmeshes();
-            m->preloadshaders();
+            loaded.add(m);
             if(m->collidemodel && col.htfind(m->collidemodel) < 0) col.add(m->collidemodel);
         }
     }
@@ -395,8 +464,19 @@ void preloadusedmapmodels(bool msg, bool bih)
         loadprogress = float(i+1)/col.length();
         model *m = loadmodel(col[i], -1, msg);
         if(!m) { if(msg) conoutf(CON_WARN, "could not load collide model: %s", col[i]); }
-        else if(!m->bih) m->setBIH();
+        else queueBIH(m);
+    }
+
+    vector<SDL_Thread *> threads;
+    startBIHs(threads);
+    loopv(loaded)
+    {
+        loadprogress = float(i+1)/loaded.length();
+        loaded[i]->preloadmeshes();
+        loaded[i]->preloadshaders();
     }
+    buildBIHs(threads);
+    if(bih) loopv(loaded) loaded[i]->preloadBIH();
 
     loadprogress = 0;
 }
@@ -1377,6 +1377,7 @@ void seedparticles()
 
 void updateparticles()
 {
+    PROFILE("particles");
     if(regenemitters) addparticleemitters();
 
     if(minimized) { canemit = false; return; }
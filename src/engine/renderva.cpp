@@ -233,6 +233,7 @@ void restorevfcP()
 
 void visiblecubes(bool cull)
 {
+    PROFILE("va culling");
     if(cull)
     {
         setvfcP();
@@ -2501,6 +2502,7 @@ vector<ushort> shadowtris[6];
 vector<GLuint> shadowvbos;
 hashtable<int, shadowmesh> shadowmeshes;
 vector<shadowdraw> shadowdraws;
+int freeshadowdraws = -1; // chained through next, draws of freed meshes are reused before shadowdraws grows
 
 struct shadowdrawinfo
 {
@@ -2525,11 +2527,14 @@ static void flushshadowmeshdraws(shadowmesh &m, int sides, shadowdrawinfo draws[
     int offset = 0;
     loopi(sides) if(shadowtris[i].length())
     {
-        if(draws[i].last < 0) m.draws[i] = shadowdraws.length();
-        else shadowdraws[draws[i].last].next = shadowdraws.length();
-        draws[i].last = shadowdraws.length();
+        int draw = freeshadowdraws;
+        if(draw >= 0) freeshadowdraws = shadowdraws[draw].next;
+        else { draw = shadowdraws.length(); shadowdraws.add(); }
+        if(draws[i].last < 0) m.draws[i] = draw;
+        else shadowdraws[draws[i].last].next = draw;
+        draws[i].last = draw;
 
-        shadowdraw &d = shadowdraws.add();
+        shadowdraw &d = shadowdraws[draw];
         d.ebuf = ebuf;
         d.vbuf = vbuf;
         d.offset = offset;
@@ -2679,6 +2684,7 @@ void clearshadowmeshes()
     }
     shadowmeshes.clear();
     shadowdraws.setsize(0);
+    freeshadowdraws = -1;
 }
 
 VARF(smmesh, 0, 1, 1, { if(!smmesh) clearshadowmeshes(); });
@@ -2700,6 +2706,85 @@ void genshadowmeshes()
     }
 }
 
+static void freeshadowmesh(shadowmesh &m)
+{
+    loopi(6) for(int d = m.draws[i], next; d >= 0; d = next)
+    {
+        shadowdraw &draw = shadowdraws[d];
+        GLuint bufs[2] = { draw.ebuf, draw.vbuf };
+        loopj(2)
+        {
+            int idx = shadowvbos.find(bufs[j]);
+            if(idx < 0) continue;
+            glDeleteBuffers_(1, &bufs[j]);
+            shadowvbos.removeunordered(idx);
+        }
+        next = draw.next;
+        draw.next = freeshadowdraws;
+        freeshadowdraws = d;
+    }
+}
+
+extern bool getentboundingbox(const extentity &e, ivec &o, ivec &r);
+
+static inline bool shadowmeshreaches(const shadowmesh &m, const ivec &bbmin, const ivec &bbmax)
+{
+    return m.origin.x + m.radius >= bbmin.x && m.origin.x - m.radius <= bbmax.x &&
+           m.origin.y + m.radius >= bbmin.y && m.origin.y - m.radius <= bbmax.y &&
+           m.origin.z + m.radius >= bbmin.z && m.origin.z - m.radius <= bbmax.z;
+}
+
+// drops the meshes of lights reaching into a region, or that went away, the rest stay valid across edits
+void clearshadowmeshes(const ivec &bbmin, const ivec &bbmax)
+{
+    if(!shadowmeshes.numelems) return;
+    vector<extentity *> &ents = entities::getents();
+    vector<int> stale;
+    enumeratekt(shadowmeshes, int, idx, shadowmesh, m,
+    {
+        if(ents.inrange(idx) && ents[idx]->type == ET_LIGHT && !shadowmeshreaches(m, bbmin, bbmax)) continue;
+        freeshadowmesh(m);
+        stale.add(idx);
+    });
+    loopv(stale) shadowmeshes.remove(stale[i]);
+    loopv(ents)
+    {
+        extentity &e = *ents[i];
+        if(e.type != ET_MAPMODEL || !(e.flags&EF_SHADOWMESH)) continue;
+        ivec eo, er;
+        if(getentboundingbox(e, eo, er) && eo.x <= bbmax.x && er.x >= bbmin.x && eo.y <= bbmax.y && er.y >= bbmin.y && eo.z <= bbmax.z && er.z >= bbmin.z)
+            e.flags &= ~EF_SHADOWMESH;
+    }
+}
+
+// only regenerates the meshes of lights reaching into a region, or that moved or lost their mesh to an edit since
+void genshadowmeshes(const ivec &bbmin, const ivec &bbmax)
+{
+    if(!smmesh) return;
+
+    renderprogress(0, "generating shadow meshes..");
+
+    clearshadowmeshes(bbmin, bbmax);
+    vector<extentity *> &ents = entities::getents();
+    loopv(ents)
+    {
+        extentity &e = *ents[i];
+        if(e.type != ET_LIGHT) continue;
+        shadowmesh *m = shadowmeshes.access(i);
+        if(m)
+        {
+            vec origin, spotloc;
+            float radius, bias;
+            int spotangle, type = calcshadowinfo(e, origin, radius, spotloc, spotangle, bias);
+            if(m->type == type && m->origin == origin && m->radius == radius && (type != SM_SPOT || (m->spotloc == spotloc && m->spotangle == spotangle)))
+                continue;
+            freeshadowmesh(*m);
+            shadowmeshes.remove(i);
+        }
+        genshadowmesh(i, e);
+    }
+}
+
 shadowmesh *findshadowmesh(int idx, extentity &e)
 {
     shadowmesh *m = shadowmeshes.access(idx);
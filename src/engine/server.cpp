@@ -2,6 +2,7 @@
 // runs dedicated or as client coroutine
 
 #include "engine.h"
+#include <enet/time.h>
 
 #define LOGSTRLEN 512
 
@@ -112,6 +113,7 @@ struct client                   // server side version of "dynent" type
     int type;
     int num;
     ENetPeer *peer;
+    enet_uint32 connectid;
     string hostname;
     void *info;
 };
@@ -121,6 +123,7 @@ vector<client *> clients;
 ENetHost *serverhost = NULL;
 int laststatus = 0;
 ENetSocket lansock = ENET_SOCKET_NULL;
+bool netthreadrunning = false;
 
 int localclients = 0, nonlocalclients = 0;
 
@@ -169,8 +172,12 @@ void delclient(client *c)
     }
 }
 
+void stopnetthread();
+
 void cleanupserver()
 {
+    stopnetthread();
+
     if(serverhost) enet_host_destroy(serverhost);
     serverhost = NULL;
 
@@ -183,6 +190,8 @@ VARF(maxdupclients, 0, 0, MAXCLIENTS, { if(serverhost) serverhost->duplicatePeer
 
 void process(ENetPacket *packet, int sender, int chan);
 //void disconnect_client(int n, int reason);
+void queuenetpacket(client &c, int chan, ENetPacket *packet);
+void queuenetkick(client &c, int reason);
 
 int getservermtu() { return serverhost ? serverhost->mtu : -1; }
 void *getclientinfo(int i) { return !clients.inrange(i) || clients[i]->type==ST_EMPTY ? NULL : clients[i]->info; }
@@ -192,6 +201,8 @@ uint getclientip(int n)    { return clients.inrange(n) && clients[n]->type==ST_T
 
 void sendpacket(int n, int chan, ENetPacket *packet, int exclude)
 {
+    // reliable messages on a channel arrive in the order they were sent, so broadcasts the game queued must go out first
+    if(chan==1 && packet->flags&ENET_PACKET_FLAG_RELIABLE) server::flushbroadcasts();
     if(n<0)
     {
         server::recordpacket(chan, packet->data, packet->dataLength);
@@ -202,7 +213,8 @@ void sendpacket(int n, int chan, ENetPacket *packet, int exclude)
     {
         case ST_TCPIP:
         {
-            enet_peer_send(clients[n]->peer, chan, packet);
+            if(netthreadrunning) queuenetpacket(*clients[n], chan, packet);
+            else enet_peer_send(clients[n]->peer, chan, packet);
             break;
         }
 
@@ -219,7 +231,9 @@ ENetPacket *sendf(int cn, int chan, const char *format, ...)
     int exclude = -1;
     bool reliable = false;
     if(*format=='r') { reliable = true; ++format; }
-    packetbuf p(MAXTRANS, reliable ? ENET_PACKET_FLAG_RELIABLE : 0);
+    // built in a reused buffer, so broadcasts the game queues for its next worldstate never allocate
+    static vector<uchar> p;
+    p.setsize(0);
     va_list args;
     va_start(args, format);
     while(*format) switch(*format++)
@@ -257,9 +271,15 @@ ENetPacket *sendf(int cn, int chan, const char *format, ...)
         }
     }
     va_end(args);
-    ENetPacket *packet = p.finalize();
+    bool queued = cn<0 && server::queuebroadcast(chan, p.getbuf(), p.length(), exclude, reliable);
+    ENetPacket *packet = queued ? NULL : enet_packet_create(p.getbuf(), p.length(), reliable ? ENET_PACKET_FLAG_RELIABLE : 0);
+    // large blobs such as demos don't get to keep the buffer
+    if(p.capacity() > MAXTRANS) delete[] p.disown();
+    if(!packet) return NULL;
     sendpacket(cn, chan, packet, exclude);
-    return packet->referenceCount > 0 ? packet : NULL;
+    if(packet->referenceCount > 0) return packet;
+    enet_packet_destroy(packet);
+    return NULL;
 }
 
 ENetPacket *sendfile(int cn, int chan, stream *file, const char *format, ...)
@@ -323,7 +343,8 @@ const char *disconnectreason(int reason)
 void disconnect_client(int n, int reason)
 {
     if(!clients.inrange(n) || clients[n]->type!=ST_TCPIP) return;
-    enet_peer_disconnect(clients[n]->peer, reason);
+    if(netthreadrunning) queuenetkick(*clients[n], reason);
+    else enet_peer_disconnect(clients[n]->peer, reason);
     server::clientdisconnect(n);
     delclient(clients[n]);
     const char *msg = disconnectreason(reason);
@@ -530,6 +551,35 @@ void sendserverinforeply(ucharbuf &p)
 
 #define MAXPINGDATA 32
 
+VAR(serverinforate, 0, 20, 1000);  // info replies per second to a single address, 0 for no limit
+
+struct pinglimiter
+{
+    hashtable<uint, int> counts;
+    enet_uint32 window;
+
+    pinglimiter() : window(0) {}
+
+    bool check(const ENetAddress &address)
+    {
+        if(!serverinforate) return true;
+        enet_uint32 millis = enet_time_get();
+        if(ENET_TIME_DIFFERENCE(millis, window) >= 1000)
+        {
+            counts.clear();
+            window = millis;
+        }
+        int *n = counts.access(address.host);
+        if(!n) { counts[address.host] = 1; return true; }
+        if(*n >= serverinforate) return false;
+        (*n)++;
+        return true;
+    }
+};
+
+// each limiter is only used by the thread reading its socket
+static pinglimiter hostpinglimiter, lanpinglimiter;
+
 void checkserversockets()        // reply all server info requests
 {
     static ENetSocketSet readset, writeset;
@@ -556,7 +606,7 @@ void checkserversockets()        // reply all server info requests
         buf.data = data;
         buf.dataLength = sizeof(data);
         int len = enet_socket_receive(lansock, &serverinfoaddress, &buf, 1);
-        if(len < 2 || data[0] != 0xFF || data[1] != 0xFF || len-2 > MAXPINGDATA) return;
+        if(len < 2 || data[0] != 0xFF || data[1] != 0xFF || len-2 > MAXPINGDATA || !lanpinglimiter.check(serverinfoaddress)) return;
         ucharbuf req(data+2, len-2), p(data+2, sizeof(data)-2);
         p.len += len-2;
         server::serverinforeply(req, p);
@@ -586,9 +636,17 @@ void checkserversockets()        // reply all server info requests
     }
 }
 
+void postnetping(const ENetAddress &address, const uchar *data, int len);
+
 static int serverinfointercept(ENetHost *host, ENetEvent *event)
 {
     if(host->receivedDataLength < 2 || host->receivedData[0] != 0xFF || host->receivedData[1] != 0xFF || host->receivedDataLength-2 > MAXPINGDATA) return 0;
+    if(!hostpinglimiter.check(host->receivedAddress)) return 1;
+    if(netthreadrunning)
+    {
+        postnetping(host->receivedAddress, host->receivedData+2, host->receivedDataLength-2);
+        return 1;
+    }
     serverinfoaddress = host->receivedAddress;
     ucharbuf req(host->receivedData+2, host->receivedDataLength-2), p(host->receivedData+2, sizeof(host->packetData[0])-2);
     p.len += host->receivedDataLength-2;
@@ -596,6 +654,327 @@ static int serverinfointercept(ENetHost *host, ENetEvent *event)
     return 1;
 }
 
+// the network thread owns serverhost while it runs, the game thread only talks to it through netin/netout
+
+VAR(netthread, 0, 1, 1);
+
+enum { NET_CONNECT = 0, NET_RECEIVE, NET_DISCONNECT, NET_RELEASE, NET_PING, NET_SEND, NET_KICK, NET_FLUSH };
+
+struct netevent
+{
+    int type, chan, data;
+    ENetPeer *peer;
+    enet_uint32 connectid;
+    ENetPacket *packet;
+    ENetAddress address;
+};
+
+static spscqueue<netevent, 8192> netin, netout;
+static vector<netevent> netqueued, netoverflow;
+static vector<enet_uint32> netconnectids;
+static int netquit = 0;
+static uint netsentdata = 0, netreceiveddata = 0;
+static bool netposted = false;
+
+#ifdef WIN32
+static HANDLE netthreadhandle = NULL, netwake = NULL;
+#else
+#include <pthread.h>
+#include <sched.h>
+static pthread_t netthreadhandle;
+static pthread_mutex_t netwakemutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t netwakecond = PTHREAD_COND_INITIALIZER;
+static bool netwoken = false;
+#endif
+
+static void wakegamethread()
+{
+#ifdef WIN32
+    SetEvent(netwake);
+#else
+    pthread_mutex_lock(&netwakemutex);
+    netwoken = true;
+    pthread_cond_signal(&netwakecond);
+    pthread_mutex_unlock(&netwakemutex);
+#endif
+}
+
+static void waitfornetthread(uint timeout)
+{
+#ifdef WIN32
+    WaitForSingleObject(netwake, timeout);
+#else
+    pthread_mutex_lock(&netwakemutex);
+    if(!netwoken && timeout)
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += long(timeout)*1000000;
+        ts.tv_sec += ts.tv_nsec/1000000000;
+        ts.tv_nsec %= 1000000000;
+        pthread_cond_timedwait(&netwakecond, &netwakemutex, &ts);
+    }
+    netwoken = false;
+    pthread_mutex_unlock(&netwakemutex);
+#endif
+}
+
+static void yieldnetthread()
+{
+#ifdef WIN32
+    Sleep(0);
+#else
+    sched_yield();
+#endif
+}
+
+// network thread side
+
+static void postnetevent(const netevent &ev)
+{
+    if(netoverflow.length() || !netin.add(ev)) netoverflow.add(ev);
+    netposted = true;
+}
+
+static void flushnetoverflow()
+{
+    int n = 0;
+    while(n < netoverflow.length() && netin.add(netoverflow[n])) n++;
+    if(n) netoverflow.remove(0, n);
+}
+
+void postnetping(const ENetAddress &address, const uchar *data, int len)
+{
+    netevent ev;
+    ev.type = NET_PING;
+    ev.address = address;
+    ev.packet = enet_packet_create(data, len, 0);
+    if(ev.packet) postnetevent(ev);
+}
+
+static void releasenetpacket(ENetPacket *packet)
+{
+    netevent ev;
+    ev.type = NET_RELEASE;
+    ev.packet = (ENetPacket *)packet->userData;
+    postnetevent(ev);
+}
+
+static inline bool validnetpeer(const netevent &ev)
+{
+    return netconnectids.inrange(int(ev.peer->incomingPeerID)) && netconnectids[ev.peer->incomingPeerID] == ev.connectid;
+}
+
+static void handlenetout()
+{
+    PROFILE("send");
+    netevent ev;
+    while(netout.remove(ev)) switch(ev.type)
+    {
+        case NET_SEND:
+            if(validnetpeer(ev)) enet_peer_send(ev.peer, ev.chan, ev.packet);
+            if(ev.data && !--ev.packet->referenceCount) enet_packet_destroy(ev.packet);
+            break;
+
+        case NET_KICK:
+            if(validnetpeer(ev)) enet_peer_disconnect(ev.peer, ev.data);
+            break;
+
+        case NET_FLUSH:
+            enet_host_flush(serverhost);
+            break;
+    }
+}
+
+static void servicenethost()
+{
+    ENetEvent event;
+    if(enet_host_service(serverhost, &event, 1) > 0) do
+    {
+        PROFILE("receive");
+        netevent ev;
+        ev.peer = event.peer;
+        ev.chan = event.channelID;
+        ev.data = event.data;
+        ev.packet = event.packet;
+        enet_uint32 &connectid = netconnectids[event.peer->incomingPeerID];
+        switch(event.type)
+        {
+            case ENET_EVENT_TYPE_CONNECT:
+                ev.type = NET_CONNECT;
+                ev.address = event.peer->address;
+                connectid = event.peer->connectID;
+                break;
+            case ENET_EVENT_TYPE_RECEIVE:
+                ev.type = NET_RECEIVE;
+                break;
+            case ENET_EVENT_TYPE_DISCONNECT:
+                ev.type = NET_DISCONNECT;
+                break;
+            default:
+                continue;
+        }
+        ev.connectid = connectid;
+        if(event.type == ENET_EVENT_TYPE_DISCONNECT) connectid = 0;
+        postnetevent(ev);
+    } while(enet_host_check_events(serverhost, &event) > 0);
+
+    atomicadd(netsentdata, uint(serverhost->totalSentData));
+    atomicadd(netreceiveddata, uint(serverhost->totalReceivedData));
+    serverhost->totalSentData = serverhost->totalReceivedData = 0;
+}
+
+#ifdef WIN32
+static DWORD WINAPI netthreadmain(LPVOID)
+#else
+static void *netthreadmain(void *)
+#endif
+{
+    profilethread("net thread");
+    while(!atomicload(netquit))
+    {
+        handlenetout();
+        flushnetoverflow();
+        servicenethost();
+        if(netposted)
+        {
+            netposted = false;
+            wakegamethread();
+        }
+    }
+    profilethreaddone();
+    return 0;
+}
+
+// game thread side
+
+static void startnetthread()
+{
+    if(!netthread || !serverhost || netthreadrunning) return;
+    netconnectids.setsize(0);
+    loopi(serverhost->peerCount) netconnectids.add(0);
+    netquit = 0;
+    netthreadrunning = true;
+#ifdef WIN32
+    netwake = CreateEvent(NULL, FALSE, FALSE, NULL);
+    netthreadhandle = netwake ? CreateThread(NULL, 0, netthreadmain, NULL, 0, NULL) : NULL;
+    if(!netthreadhandle)
+#else
+    if(pthread_create(&netthreadhandle, NULL, netthreadmain, NULL))
+#endif
+    {
+        netthreadrunning = false;
+        logoutf("could not start network thread");
+    }
+}
+
+void stopnetthread()
+{
+    if(!netthreadrunning) return;
+    atomicstore(netquit, 1);
+#ifdef WIN32
+    WaitForSingleObject(netthreadhandle, INFINITE);
+    CloseHandle(netthreadhandle);
+    CloseHandle(netwake);
+    netthreadhandle = netwake = NULL;
+#else
+    pthread_join(netthreadhandle, NULL);
+#endif
+    netthreadrunning = false;
+    netqueued.setsize(0);
+    netoverflow.setsize(0);
+}
+
+void queuenetpacket(client &c, int chan, ENetPacket *packet)
+{
+    // hold a reference until the network thread releases its copy, so referenceCount behaves as with enet_peer_send
+    packet->referenceCount++;
+    netevent &ev = netqueued.add();
+    ev.type = NET_SEND;
+    ev.peer = c.peer;
+    ev.connectid = c.connectid;
+    ev.chan = chan;
+    ev.data = 0;
+    ev.packet = packet;
+}
+
+void queuenetkick(client &c, int reason)
+{
+    netevent &ev = netqueued.add();
+    ev.type = NET_KICK;
+    ev.peer = c.peer;
+    ev.connectid = c.connectid;
+    ev.data = reason;
+}
+
+static void commitnetout()
+{
+    if(netqueued.empty()) return;
+    // broadcasts send the same packet to consecutive clients, so they share a single wrapper packet
+    ENetPacket *source = NULL, *wrapper = NULL;
+    int lastuse = -1;
+    loopv(netqueued)
+    {
+        netevent &ev = netqueued[i];
+        if(ev.type != NET_SEND) continue;
+        if(ev.packet != source)
+        {
+            if(lastuse >= 0) netqueued[lastuse].data = 1;
+            source = ev.packet;
+            wrapper = enet_packet_create(source->data, source->dataLength, (source->flags&(ENET_PACKET_FLAG_RELIABLE|ENET_PACKET_FLAG_UNSEQUENCED|ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT)) | ENET_PACKET_FLAG_NO_ALLOCATE);
+            wrapper->referenceCount = 1;
+            wrapper->userData = source;
+            wrapper->freeCallback = releasenetpacket;
+        }
+        else source->referenceCount--;
+        ev.packet = wrapper;
+        lastuse = i;
+    }
+    if(lastuse >= 0) netqueued[lastuse].data = 1;
+    loopv(netqueued) while(!netout.add(netqueued[i])) yieldnetthread();
+    netqueued.setsize(0);
+}
+
+static void flushnethost()
+{
+    if(netthreadrunning)
+    {
+        netevent &ev = netqueued.add();
+        ev.type = NET_FLUSH;
+        commitnetout();
+    }
+    else enet_host_flush(serverhost);
+}
+
+static void getnetstats(uint &sent, uint &received)
+{
+    if(netthreadrunning)
+    {
+        static uint lastsent = 0, lastreceived = 0;
+        uint cursent = atomicload(netsentdata), curreceived = atomicload(netreceiveddata);
+        sent = cursent - lastsent;
+        received = curreceived - lastreceived;
+        lastsent = cursent;
+        lastreceived = curreceived;
+    }
+    else
+    {
+        sent = serverhost->totalSentData;
+        received = serverhost->totalReceivedData;
+        serverhost->totalSentData = serverhost->totalReceivedData = 0;
+    }
+}
+
+static vector<uint> ticktimes;
+
+static void logticktimes()
+{
+    if(ticktimes.empty()) return;
+    ticktimes.sort();
+    logoutf("tick: %d ticks, %.2f p50, %.2f p99, %.2f max (ms)", ticktimes.length(), ticktimes[ticktimes.length()/2]/1000.0f, ticktimes[(ticktimes.length()*99)/100]/1000.0f, ticktimes.last()/1000.0f);
+    ticktimes.setsize(0);
+}
+
 VAR(serveruprate, 0, 0, INT_MAX);
 SVAR(serverip, "");
 VARF(serverport, 0, server::serverport(), 0xFFFF, { if(!serverport) serverport = server::serverport(); });
@@ -624,8 +1003,80 @@ void updatetime()
     }
 }
 
+static void connectclient(ENetPeer *peer, enet_uint32 connectid, const ENetAddress &address)
+{
+    client &c = addclient(ST_TCPIP);
+    c.peer = peer;
+    c.peer->data = &c;
+    c.connectid = connectid;
+    string hn;
+    copystring(c.hostname, (enet_address_get_host_ip(&address, hn, sizeof(hn))==0) ? hn : "unknown");
+    logoutf("client connected (%s)", c.hostname);
+    int reason = server::clientconnect(c.num, address.host);
+    if(reason) disconnect_client(c.num, reason);
+}
+
+static void receivepacket(client *c, ENetPacket *packet, int chan)
+{
+    if(c) process(packet, c->num, chan);
+    if(packet->referenceCount==0) enet_packet_destroy(packet);
+}
+
+static void disconnectedclient(client *c)
+{
+    if(!c) return;
+    logoutf("disconnected client (%s)", c->hostname);
+    server::clientdisconnect(c->num);
+    delclient(c);
+}
+
+static inline client *findnetclient(const netevent &ev)
+{
+    client *c = (client *)ev.peer->data;
+    return c && c->connectid == ev.connectid ? c : NULL;
+}
+
+static void dispatchnetevents()
+{
+    netevent ev;
+    while(netin.remove(ev)) switch(ev.type)
+    {
+        case NET_CONNECT:
+            connectclient(ev.peer, ev.connectid, ev.address);
+            break;
+
+        case NET_RECEIVE:
+            receivepacket(findnetclient(ev), ev.packet, ev.chan);
+            break;
+
+        case NET_DISCONNECT:
+            disconnectedclient(findnetclient(ev));
+            break;
+
+        case NET_RELEASE:
+            if(!--ev.packet->referenceCount) enet_packet_destroy(ev.packet);
+            break;
+
+        case NET_PING:
+        {
+            uchar data[MAXTRANS];
+            int len = int(ev.packet->dataLength);
+            memcpy(data, ev.packet->data, len);
+            enet_packet_destroy(ev.packet);
+            serverinfoaddress = ev.address;
+            ucharbuf req(data, len), p(data, sizeof(data));
+            p.len += len;
+            server::serverinforeply(req, p);
+            break;
+        }
+    }
+}
+
 void serverslice(bool dedicated, uint timeout)   // main server update, called from main loop in sp, or from below in dedicated server
 {
+    if(dedicated) profileframe();
+    PROFILE("server");
+
     if(!serverhost)
     {
         server::serverupdate();
@@ -635,6 +1086,7 @@ void serverslice(bool dedicated, uint timeout)   // main server update, called f
 
     // below is network only
 
+    uint tickstart = getclockmicros();
     if(dedicated)
     {
         int millis = (int)enet_time_get();
@@ -659,59 +1111,72 @@ void serverslice(bool dedicated, uint timeout)   // main server update, called f
     if(totalmillis-laststatus>60*1000)   // display bandwidth stats, useful for server ops
     {
         laststatus = totalmillis;
-        if(nonlocalclients || serverhost->totalSentData || serverhost->totalReceivedData) logoutf("status: %d remote clients, %.1f send, %.1f rec (K/sec)", nonlocalclients, serverhost->totalSentData/60.0f/1024, serverhost->totalReceivedData/60.0f/1024);
-        serverhost->totalSentData = serverhost->totalReceivedData = 0;
+        uint sent, received;
+        getnetstats(sent, received);
+        if(nonlocalclients || sent || received)
+        {
+            logoutf("status: %d remote clients, %.1f send, %.1f rec (K/sec)", nonlocalclients, sent/60.0f/1024, received/60.0f/1024);
+            if(dedicated) { logticktimes(); logprofile(); }
+        }
+        else if(dedicated) publishprofile();
+        ticktimes.setsize(0);
     }
 
-    ENetEvent event;
-    bool serviced = false;
-    while(!serviced)
+    uint waited = 0;
+    if(netthreadrunning)
     {
-        if(enet_host_check_events(serverhost, &event) <= 0)
+        if(netin.empty())
         {
-            if(enet_host_service(serverhost, &event, timeout) <= 0) break;
-            serviced = true;
+            PROFILE("wait");
+            uint waitstart = getclockmicros();
+            waitfornetthread(timeout);
+            waited += getclockmicros() - waitstart;
         }
-        switch(event.type)
+        PROFILE("enet");
+        dispatchnetevents();
+    }
+    else
+    {
+        ENetEvent event;
+        bool serviced = false;
+        while(!serviced)
         {
-            case ENET_EVENT_TYPE_CONNECT:
+            if(enet_host_check_events(serverhost, &event) <= 0)
             {
-                client &c = addclient(ST_TCPIP);
-                c.peer = event.peer;
-                c.peer->data = &c;
-                string hn;
-                copystring(c.hostname, (enet_address_get_host_ip(&c.peer->address, hn, sizeof(hn))==0) ? hn : "unknown");
-                logoutf("client connected (%s)", c.hostname);
-                int reason = server::clientconnect(c.num, c.peer->address.host);
-                if(reason) disconnect_client(c.num, reason);
-                break;
+                PROFILE("wait");
+                uint waitstart = getclockmicros();
+                int serviceresult = enet_host_service(serverhost, &event, timeout);
+                waited += getclockmicros() - waitstart;
+                if(serviceresult <= 0) break;
+                serviced = true;
             }
-            case ENET_EVENT_TYPE_RECEIVE:
+            PROFILE("enet");
+            switch(event.type)
             {
-                client *c = (client *)event.peer->data;
-                if(c) process(event.packet, c->num, event.channelID);
-                if(event.packet->referenceCount==0) enet_packet_destroy(event.packet);
-                break;
-            }
-            case ENET_EVENT_TYPE_DISCONNECT:
-            {
-                client *c = (client *)event.peer->data;
-                if(!c) break;
-                logoutf("disconnected client (%s)", c->hostname);
-                server::clientdisconnect(c->num);
-                delclient(c);
-                break;
+                case ENET_EVENT_TYPE_CONNECT:
+                    connectclient(event.peer, event.peer->connectID, event.peer->address);
+                    break;
+                case ENET_EVENT_TYPE_RECEIVE:
+                    receivepacket((client *)event.peer->data, event.packet, event.channelID);
+                    break;
+                case ENET_EVENT_TYPE_DISCONNECT:
+                    disconnectedclient((client *)event.peer->data);
+                    break;
+                default:
+                    break;
             }
-            default:
-                break;
         }
     }
-    if(server::sendpackets()) enet_host_flush(serverhost);
+    if(server::sendpackets()) flushnethost();
+    else if(netthreadrunning) commitnetout();
+
+    if(dedicated) ticktimes.add(getclockmicros() - tickstart - waited);
 }
 
 void flushserver(bool force)
 {
-    if(server::sendpackets(force) && serverhost) enet_host_flush(serverhost);
+    if(server::sendpackets(force) && serverhost) flushnethost();
+    else if(netthreadrunning) commitnetout();
 }
 
 #ifndef STANDALONE
@@ -1018,7 +1483,8 @@ bool isdedicatedserver() { return dedicatedserver; }
 void rundedicatedserver()
 {
     dedicatedserver = true;
-    logoutf("dedicated server started, waiting for clients...");
+    startnetthread();
+    logoutf("dedicated server started%s, waiting for clients...", netthreadrunning ? " with network thread" : "");
 #ifdef WIN32
     SetPriorityClass(GetCurrentProcess(), HIGH_PRIORITY_CLASS);
     for(;;)
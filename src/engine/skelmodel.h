@@ -1477,6 +1477,164 @@ struct skelmodel : animmodel
         }
 
         virtual bool load(const char *name, float smooth) = 0;
+
+        // loaders with side effects beyond the mesh data can store and replay them per mesh
+        virtual void savecookedmesh(stream *f, skelmesh &m) {}
+        virtual bool loadcookedmesh(stream *f, skelmesh &m) { return true; }
+
+        // only groups owning their skeleton are cooked, as a shared skeleton depends on every group that uses it
+        void savecooked(const char *filename, float smooth)
+        {
+            if(skel->shared) return;
+            stream *f = opencooked(filename, "mesh", 0, smooth, true);
+            if(!f) return;
+            f->putlil<int>(skel->numbones);
+            loopi(skel->numbones)
+            {
+                boneinfo &b = skel->bones[i];
+                putcookedstring(f, b.name);
+                f->putlil<int>(b.parent);
+                putcookedwords<float>(f, &b.base, 1);
+            }
+            f->putlil<int>(blendcombos.length());
+            loopv(blendcombos)
+            {
+                blendcombo &c = blendcombos[i];
+                f->putlil<int>(c.uses);
+                putcookedwords<float>(f, c.weights, 4);
+                f->write(c.bones, 4);
+            }
+            putcookedwords<int>(f, numblends, 4);
+            f->putlil<int>(meshes.length());
+            loopv(meshes)
+            {
+                skelmesh &m = *(skelmesh *)meshes[i];
+                putcookedstring(f, m.name);
+                f->putlil<int>(m.numverts);
+                f->putlil<int>(m.numtris);
+                f->putlil<int>(m.maxweights);
+                putcookedwords<uint>(f, m.verts, m.numverts);
+                putcookedwords<ushort>(f, m.tris, m.numtris);
+                savecookedmesh(f, m);
+            }
+            delete f;
+        }
+
+        bool loadcooked(const char *filename, float smooth)
+        {
+            if(skel->shared || skel->numbones) return false;
+            stream *f = opencooked(filename, "mesh", 0, smooth, false);
+            if(!f) return false;
+            int numbones = f->getlil<int>(), numcombos = 0, nummeshes = 0;
+            if(numbones < 0 || numbones > 0xFFFF) goto error;
+            if(numbones)
+            {
+                skel->numbones = numbones;
+                skel->bones = new boneinfo[numbones];
+                loopi(numbones)
+                {
+                    boneinfo &b = skel->bones[i];
+                    char *name;
+                    if(!getcookedstring(f, name)) goto error;
+                    b.name = name;
+                    b.parent = f->getlil<int>();
+                    if(b.parent >= numbones || !getcookedwords<float>(f, &b.base, 1)) goto error;
+                    (b.invbase = b.base).invert();
+                }
+                skel->linkchildren();
+            }
+            numcombos = f->getlil<int>();
+            if(numcombos < 0 || numcombos > 0xFFFFFF) goto error;
+            loopi(numcombos)
+            {
+                blendcombo &c = blendcombos.add();
+                c.uses = f->getlil<int>();
+                c.interpindex = i;
+                if(!getcookedwords<float>(f, c.weights, 4) || f->read(c.bones, 4) != 4) goto error;
+                loopk(4) if(c.bones[k] >= max(numbones, 1)) goto error;
+            }
+            if(!getcookedwords<int>(f, numblends, 4)) goto error;
+            nummeshes = f->getlil<int>();
+            if(nummeshes < 0 || nummeshes > 0xFFFF) goto error;
+            loopi(nummeshes)
+            {
+                skelmesh *m = new skelmesh;
+                m->group = this;
+                meshes.add(m);
+                if(!getcookedstring(f, m->name)) goto error;
+                m->numverts = f->getlil<int>();
+                m->numtris = f->getlil<int>();
+                m->maxweights = f->getlil<int>();
+                if(m->numverts <= 0 || m->numverts > 0xFFFF || m->numtris <= 0 || m->numtris > 0xFFFFFF) goto error;
+                m->verts = new vert[m->numverts];
+                m->tris = new tri[m->numtris];
+                if(!getcookedwords<uint>(f, m->verts, m->numverts) || !getcookedwords<ushort>(f, m->tris, m->numtris)) goto error;
+                loopj(m->numverts) if(m->verts[j].blend < 0 || m->verts[j].blend >= numcombos) goto error;
+                loopj(m->numtris) loopk(3) if(m->tris[j].vert[k] >= m->numverts) goto error;
+                if(!loadcookedmesh(f, *m)) goto error;
+            }
+            delete f;
+            name = newstring(filename);
+            return true;
+
+        error:
+            delete f;
+            meshes.deletecontents();
+            blendcombos.setsize(0);
+            memset(numblends, 0, sizeof(numblends));
+            DELETEA(skel->bones);
+            skel->numbones = 0;
+            return false;
+        }
+
+        // animations come out relative to the bind pose and after the loader's bone adjustments, which the key covers
+        uint cookedanimkey(uint adjustkey)
+        {
+            uint key = adjustkey;
+            loopi(skel->numbones) key = crc32(key, (const Bytef *)&skel->bones[i].base, sizeof(dualquat));
+            if(skel->numframes) key = crc32(key, (const Bytef *)skel->framebones, skel->numbones*sizeof(dualquat));
+            return key;
+        }
+
+        // the key has to be taken before the animation is added, as it covers the skeleton's first frame
+        void savecookedanim(const char *filename, uint key, skelanimspec *sa)
+        {
+            if(!sa || !sa->range || skel->numbones <= 0) return;
+            stream *f = opencooked(filename, "anim", key, 0, true);
+            if(!f) return;
+            f->putlil<int>(skel->numbones);
+            f->putlil<int>(sa->range);
+            putcookedwords<float>(f, &skel->framebones[sa->frame*skel->numbones], sa->range*skel->numbones);
+            delete f;
+        }
+
+        skelanimspec *loadcookedanim(const char *filename, uint key)
+        {
+            if(skel->numbones <= 0) return NULL;
+            stream *f = opencooked(filename, "anim", key, 0, false);
+            if(!f) return NULL;
+            int numbones = f->getlil<int>(), numframes = f->getlil<int>();
+            if(numbones != skel->numbones || numframes <= 0 || numframes > 0xFFFF) { delete f; return NULL; }
+            dualquat *framebones = new dualquat[(skel->numframes+numframes)*skel->numbones];
+            if(!getcookedwords<float>(f, &framebones[skel->numframes*skel->numbones], numframes*skel->numbones))
+            {
+                delete[] framebones;
+                delete f;
+                return NULL;
+            }
+            delete f;
+            if(skel->framebones)
+            {
+                memcpy(framebones, skel->framebones, skel->numframes*skel->numbones*sizeof(dualquat));
+                delete[] skel->framebones;
+            }
+            skel->framebones = framebones;
+            skelanimspec *sa = &skel->addskelanim(filename);
+            sa->frame = skel->numframes;
+            sa->range = numframes;
+            skel->numframes += numframes;
+            return sa;
+        }
     };
 
     virtual skelmeshgroup *newmeshes() = 0;
@@ -1485,7 +1643,9 @@ struct skelmodel : animmodel
     {
         skelmeshgroup *group = newmeshes();
         group->shareskeleton(skelname);
+        if(group->loadcooked(name, smooth)) return group;
         if(!group->load(name, smooth)) { delete group; return NULL; }
+        group->savecooked(name, smooth);
         return group;
     }
 
@@ -1625,6 +1785,12 @@ template<class MDL> struct skelloader : modelloader<MDL, skelmodel>
 
     skelloader(const char *name) : modelloader<MDL, skelmodel>(name) {}
 
+    static uint adjustmentkey()
+    {
+        if(adjustments.empty()) return 0;
+        return crc32(crc32(0, NULL, 0), (const Bytef *)adjustments.getbuf(), adjustments.length()*sizeof(skeladjustment));
+    }
+
     void flushpart()
     {
         if(hitzones.length() && skelmodel::parts.length())
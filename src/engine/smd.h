@@ -353,6 +353,10 @@ struct smd : skelloader<smd>
             skelanimspec *sa = skel->findskelanim(filename);
             if(sa || skel->numbones <= 0) return sa;
 
+            uint cookedkey = cookedanimkey(adjustmentkey());
+            sa = loadcookedanim(filename, cookedkey);
+            if(sa) return sa;
+
             stream *f = openfile(filename, "r");
             if(!f) return NULL;
 
@@ -396,6 +400,7 @@ struct smd : skelloader<smd>
 
             delete f;
 
+            savecookedanim(filename, cookedkey, sa);
             return sa;
         }
 
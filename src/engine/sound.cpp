@@ -10,15 +10,27 @@
 
 bool nosound = true;
 
+// bytes of decoded sample data currently held by loaded chunks
+static uint samplememory = 0;
+
 struct soundsample
 {
     char *name;
     Mix_Chunk *chunk;
+    int lastused;
 
-    soundsample() : name(NULL), chunk(NULL) {}
+    soundsample() : name(NULL), chunk(NULL), lastused(0) {}
     ~soundsample() { DELETEA(name); }
 
-    void cleanup() { if(chunk) { Mix_FreeChunk(chunk); chunk = NULL; } }
+    void cleanup()
+    {
+        if(chunk)
+        {
+            samplememory -= chunk->alen;
+            Mix_FreeChunk(chunk);
+            chunk = NULL;
+        }
+    }
     bool load(const char *dir, bool msg = false);
 };
 
@@ -156,6 +168,9 @@ VARF(sound, 0, 1, 1, initwarning("sound configuration", INIT_RESET, CHANGE_SOUND
 VARF(soundchans, 1, 32, 128, initwarning("sound configuration", INIT_RESET, CHANGE_SOUND));
 VARF(soundfreq, 0, 44100, 44100, initwarning("sound configuration", INIT_RESET, CHANGE_SOUND));
 VARF(soundbufferlen, 128, 1024, 4096, initwarning("sound configuration", INIT_RESET, CHANGE_SOUND));
+SVARF(audiodriver, "", initwarning("sound configuration", INIT_RESET, CHANGE_SOUND)); // e.g. "dummy" to run the sound code without an audio device
+
+static bool customaudiodriver = false;
 
 void initsound()
 {
@@ -168,6 +183,17 @@ void initsound()
         return;
     }
 
+    if(sound && (audiodriver[0] || customaudiodriver))
+    {
+        customaudiodriver = audiodriver[0] != '\0';
+        if(SDL_AudioInit(audiodriver[0] ? audiodriver : NULL) < 0)
+        {
+            nosound = true;
+            conoutf(CON_ERROR, "sound init failed (audio driver %s): %s", audiodriver[0] ? audiodriver : "default", SDL_GetError());
+            return;
+        }
+    }
+
     if(!sound || Mix_OpenAudio(soundfreq, MIX_DEFAULT_FORMAT, 2, soundbufferlen)<0)
     {
         nosound = true;
@@ -269,7 +295,13 @@ bool soundsample::load(const char *dir, bool msg)
         if(msg && !i) renderprogress(0, filename);
         path(filename);
         chunk = loadwav(filename);
-        if(chunk) return true;
+        if(chunk)
+        {
+            samplememory += chunk->alen;
+            // preloaded samples count as used when loaded, or they would always be the first dropped by trimsamples
+            lastused = totalmillis;
+            return true;
+        }
     }
 
     conoutf(CON_ERROR, "failed to load sample: media/sound/%s%s", dir, name);
@@ -384,8 +416,36 @@ static struct soundtype
     {
         return chan.inuse && config.hasslot(chan.slot, slots);
     }
+
+    soundsample *oldestsample(soundsample *oldest)
+    {
+        enumerate(samples, soundsample, s,
+        {
+            if(!s.chunk || (oldest && s.lastused - oldest->lastused >= 0)) continue;
+            bool playing = false;
+            loopvj(channels) if(channels[j].inuse && channels[j].slot && channels[j].slot->sample == &s) { playing = true; break; }
+            if(!playing) oldest = &s;
+        });
+        return oldest;
+    }
 } gamesounds("game/"), mapsounds("mapsound/");
 
+VARP(soundcache, 0, 64, 1024);
+
+// chunks are decoded to the mixer's 16 bit stereo format whatever the source, so long ambient loops add up quickly
+// SDL_mixer can only stream its one music track, so samples are always decoded whole and dropping them is what bounds their memory:
+// once the loaded samples outgrow soundcache megabytes, the least recently played ones that are not playing are dropped
+static void trimsamples()
+{
+    if(!soundcache) return;
+    while(samplememory > uint(soundcache)<<20)
+    {
+        soundsample *oldest = mapsounds.oldestsample(gamesounds.oldestsample(NULL));
+        if(!oldest) break;
+        oldest->cleanup();
+    }
+}
+
 void registersound(char *name, int *vol) { intret(gamesounds.addsound(name, *vol, 0)); }
 COMMAND(registersound, "si");
 
@@ -444,34 +504,62 @@ void clearmapsounds()
 {
     stopmapsounds();
     mapsounds.clear();
+    clearmapsoundindex();
 }
 
-void stopmapsound(extentity *e)
+// map sound entities are bucketed by the cells their audible radius overlaps,
+// so each frame only the ones near the camera and the ones already playing are looked at
+#define MAPSOUNDCELLBITS 8
+#define MAXMAPSOUNDCELLS 64
+
+static hashtable<ivec, vector<int> > mapsoundcells;
+static vector<int> widemapsounds;
+static bool mapsoundsdirty = true;
+
+void clearmapsoundindex()
 {
-    loopv(channels)
-    {
-        soundchannel &chan = channels[i];
-        if(chan.inuse && chan.ent == e)
-        {
-            Mix_HaltChannel(i);
-            freechannel(i);
-        }
-    }
+    mapsoundsdirty = true;
 }
 
-void checkmapsounds()
+static void buildmapsoundindex()
 {
+    mapsoundcells.clear();
+    widemapsounds.setsize(0);
     const vector<extentity *> &ents = entities::getents();
     loopv(ents)
     {
         extentity &e = *ents[i];
-        if(e.type!=ET_SOUND) continue;
-        if(camera1->o.dist(e.o) < e.attr2)
+        if(e.type!=ET_SOUND || e.attr2 <= 0) continue;
+        ivec lo = ivec(vec(e.o).sub(e.attr2)).shr(MAPSOUNDCELLBITS), hi = ivec(vec(e.o).add(e.attr2)).shr(MAPSOUNDCELLBITS);
+        if((hi.x-lo.x+1)*(hi.y-lo.y+1)*(hi.z-lo.z+1) > MAXMAPSOUNDCELLS) { widemapsounds.add(i); continue; }
+        for(int z = lo.z; z <= hi.z; z++) for(int y = lo.y; y <= hi.y; y++) for(int x = lo.x; x <= hi.x; x++)
+            mapsoundcells[ivec(x, y, z)].add(i);
+    }
+    mapsoundsdirty = false;
+}
+
+static inline void checkmapsound(extentity &e)
+{
+    if(e.type==ET_SOUND && !(e.flags&EF_SOUND) && camera1->o.dist(e.o) < e.attr2) playsound(e.attr1, NULL, &e, SND_MAP, -1);
+}
+
+void checkmapsounds()
+{
+    loopv(channels)
+    {
+        soundchannel &chan = channels[i];
+        if(chan.inuse && chan.ent && (chan.ent->type!=ET_SOUND || camera1->o.dist(chan.ent->o) >= chan.ent->attr2))
         {
-            if(!(e.flags&EF_SOUND)) playsound(e.attr1, NULL, &e, SND_MAP, -1);
+            Mix_HaltChannel(i);
+            freechannel(i);
         }
-        else if(e.flags&EF_SOUND) stopmapsound(&e);
     }
+
+    if(mapsoundsdirty) buildmapsoundindex();
+    const vector<extentity *> &ents = entities::getents();
+    vector<int> *cell = mapsoundcells.access(ivec(camera1->o).shr(MAPSOUNDCELLBITS));
+    if(cell) loopv(*cell) if(ents.inrange((*cell)[i])) checkmapsound(*ents[(*cell)[i]]);
+    loopv(widemapsounds) if(ents.inrange(widemapsounds[i])) checkmapsound(*ents[widemapsounds[i]]);
 }
 
 VAR(stereo, 0, 1, 1);
@@ -625,16 +713,32 @@ int playsound(int n, const vec *loc, extentity *ent, int flags, int loops, int f
     if(fade < 0) return -1;
 
     soundslot &slot = sounds.slots[config.chooseslot()];
-    if(!slot.sample->chunk && !slot.sample->load(sounds.dir)) return -1;
-
-    if(dbgsound) conoutf("sound: %s%s", sounds.dir, slot.sample->name);
 
     chanid = -1;
     loopv(channels) if(!channels[i].inuse) { chanid = i; break; }
     if(chanid < 0 && channels.length() < maxchannels) chanid = channels.length();
-    if(chanid < 0) loopv(channels) if(!channels[i].volume) { Mix_HaltChannel(i); freechannel(i); chanid = i; break; }
-    if(chanid < 0) return -1;
+    if(chanid < 0)
+    {
+        // all voices are busy, so only take over the least audible one if the new sound would be louder
+        soundchannel probe(-1);
+        probe.slot = &slot;
+        probe.radius = radius;
+        probe.ent = ent;
+        if(ent) probe.loc = ent->o;
+        else if(loc) probe.loc = *loc;
+        updatechannel(probe);
+        int quietest = -1;
+        loopv(channels) if(channels[i].volume < probe.volume && (quietest < 0 || channels[i].volume < channels[quietest].volume)) quietest = i;
+        if(quietest < 0) return -1;
+        chanid = quietest;
+    }
+
+    if(!slot.sample->chunk && !slot.sample->load(sounds.dir)) return -1;
+    slot.sample->lastused = totalmillis;
+
+    if(dbgsound) conoutf("sound: %s%s", sounds.dir, slot.sample->name);
 
+    if(channels.inrange(chanid) && channels[chanid].inuse) { Mix_HaltChannel(chanid); freechannel(chanid); }
     soundchannel &chan = newchannel(chanid, &slot, loc, ent, flags, radius);
     updatechannel(chan);
     int playing = -1;
@@ -646,6 +750,7 @@ int playsound(int n, const vec *loc, extentity *ent, int flags, int loops, int f
     else playing = expire >= 0 ? Mix_PlayChannelTimed(chanid, slot.sample->chunk, loops, expire) : Mix_PlayChannel(chanid, slot.sample->chunk, loops);
     if(playing >= 0) syncchannel(chan);
     else freechannel(chanid);
+    trimsamples();
     return playing;
 }
 
@@ -865,6 +865,79 @@ namespace UI
         window = NULL;
     }
 
+    // retained subtrees skip re-executing their contents while their key is unchanged and nothing inside them has input state,
+    // and keep their last layout unless the space they are given changes
+    static int uirevision = 0;
+    VARF(uiretaining, 0, 1, 1, uirevision++);
+
+    struct Retained;
+    static Retained *buildretained = NULL;
+
+    struct Retained : Object
+    {
+        char *key;
+        int revision, laststate;
+        bool dirty, pinned;
+        float laidw, laidh, adjustw, adjusth;
+
+        Retained() : key(NULL), revision(-1), laststate(0), dirty(true), pinned(false), laidw(0), laidh(0), adjustw(-1), adjusth(-1) {}
+        ~Retained() { DELETEA(key); }
+
+        static const char *typestr() { return "#Retained"; }
+        const char *gettype() const { return typestr(); }
+
+        void setup()
+        {
+            Object::setup();
+        }
+
+        void buildchildren(const char *key_, uint *contents)
+        {
+            int curstate = (state | childstate) & ~STATE_HIDDEN;
+            if(uiretaining && !pinned && !curstate && !laststate && revision == uirevision && key && !strcmp(key, key_)) return;
+            if(!key || strcmp(key, key_)) { DELETEA(key); key = newstring(key_); }
+            revision = uirevision;
+            laststate = curstate;
+            dirty = true;
+            pinned = false;
+            Retained *oldretained = buildretained;
+            buildretained = this;
+            Object::buildchildren(contents);
+            buildretained = oldretained;
+            // an inner subtree that must rebuild every frame can only do so if its parent rebuilds too
+            if(pinned && buildretained) buildretained->pinned = true;
+        }
+
+        void layout()
+        {
+            if(dirty)
+            {
+                Object::layout();
+                laidw = w;
+                laidh = h;
+            }
+            else
+            {
+                w = laidw;
+                h = laidh;
+            }
+        }
+
+        void adjustchildren()
+        {
+            if(!dirty)
+            {
+                if(w == adjustw && h == adjusth) return;
+                // children were clamped to the old size, so lay them out again before adjusting to the new one
+                loopchildren(o, { o->x = o->y = 0; o->layout(); });
+            }
+            Object::adjustchildren();
+            adjustw = w;
+            adjusth = h;
+            dirty = false;
+        }
+    };
+
     struct HorizontalList : Object
     {
         float space, subw;
@@ -2573,6 +2646,8 @@ namespace UI
         void setup(const char *name, int length, int height, float scale_ = 1, const char *initval = NULL, int mode = EDITORUSED, const char *keyfilter_ = NULL)
         {
             Object::setup();
+            // editors not used this frame are flushed, so a retained subtree holding one has to rebuild every frame
+            if(buildretained) buildretained->pinned = true;
             editor *edit_ = useeditor(name, mode, false, initval);
             if(edit_ != edit)
             {
@@ -3197,6 +3272,16 @@ namespace UI
     ICOMMAND(uigroup, "e", (uint *children),
         BUILD(Object, o, o->setup(), children));
 
+    ICOMMAND(uiretain, "se", (char *key, uint *children),
+    {
+        if(buildparent)
+        {
+            Retained *o = buildparent->buildtype<Retained>();
+            o->setup();
+            o->buildchildren(key, children);
+        }
+    });
+
     ICOMMAND(uihlist, "fe", (float *space, uint *children),
         BUILD(HorizontalList, o, o->setup(*space), children));
 
@@ -3545,16 +3630,19 @@ namespace UI
 
     void calctextscale()
     {
+        float oldtextscale = uitextscale, oldcontextscale = uicontextscale;
         uitextscale = 1.0f/uitextrows;
 
         int tw = hudw, th = hudh;
         if(forceaspect) tw = int(ceil(th*forceaspect));
         gettextres(tw, th);
         uicontextscale = conscale/th;
+        if(uitextscale != oldtextscale || uicontextscale != oldcontextscale) uirevision++;
     }
 
     void update()
     {
+        PROFILE("ui");
         readyeditors();
 
         world->setstate(STATE_HOVER, cursorx, cursory, world->childstate&STATE_HOLD_MASK);
@@ -417,6 +417,78 @@ struct vertmodel : animmodel
         }
 
         virtual bool load(const char *name, float smooth) = 0;
+
+        void savecooked(const char *filename, float smooth)
+        {
+            stream *f = opencooked(filename, "mesh", 0, smooth, true);
+            if(!f) return;
+            f->putlil<int>(numframes);
+            f->putlil<int>(numtags);
+            loopi(numtags) putcookedstring(f, tags[i].name);
+            loopi(numframes*numtags) putcookedwords<float>(f, &tags[i].matrix, 1);
+            f->putlil<int>(meshes.length());
+            loopv(meshes)
+            {
+                vertmesh &m = *(vertmesh *)meshes[i];
+                putcookedstring(f, m.name);
+                f->putlil<int>(m.numverts);
+                f->putlil<int>(m.numtris);
+                putcookedwords<float>(f, m.verts, numframes*m.numverts);
+                putcookedwords<float>(f, m.tcverts, m.numverts);
+                putcookedwords<ushort>(f, m.tris, m.numtris);
+            }
+            delete f;
+        }
+
+        bool loadcooked(const char *filename, float smooth)
+        {
+            stream *f = opencooked(filename, "mesh", 0, smooth, false);
+            if(!f) return false;
+            int nummeshes = 0;
+            numframes = f->getlil<int>();
+            numtags = f->getlil<int>();
+            if(numframes <= 0 || numframes > 0xFFFF || numtags < 0 || numtags > 0xFFFF) goto error;
+            if(numtags)
+            {
+                tags = new tag[numframes*numtags];
+                loopi(numtags) if(!getcookedstring(f, tags[i].name)) goto error;
+                loopi(numframes*numtags) if(!getcookedwords<float>(f, &tags[i].matrix, 1)) goto error;
+            }
+            nummeshes = f->getlil<int>();
+            if(nummeshes < 0 || nummeshes > 0xFFFF) goto error;
+            loopi(nummeshes)
+            {
+                vertmesh *m = new vertmesh;
+                m->group = this;
+                meshes.add(m);
+                if(!getcookedstring(f, m->name)) goto error;
+                m->numverts = f->getlil<int>();
+                m->numtris = f->getlil<int>();
+                if(m->numverts < 0 || m->numverts > 0xFFFF || m->numtris < 0 || m->numtris > 0xFFFFFF) goto error;
+                if(m->numverts)
+                {
+                    m->verts = new vert[numframes*m->numverts];
+                    m->tcverts = new tcvert[m->numverts];
+                    if(!getcookedwords<float>(f, m->verts, numframes*m->numverts) || !getcookedwords<float>(f, m->tcverts, m->numverts)) goto error;
+                }
+                if(m->numtris)
+                {
+                    m->tris = new tri[m->numtris];
+                    if(!getcookedwords<ushort>(f, m->tris, m->numtris)) goto error;
+                    loopj(m->numtris) loopk(3) if(m->tris[j].vert[k] >= m->numverts) goto error;
+                }
+            }
+            delete f;
+            name = newstring(filename);
+            return true;
+
+        error:
+            delete f;
+            meshes.deletecontents();
+            DELETEA(tags);
+            numtags = numframes = 0;
+            return false;
+        }
     };
 
     virtual vertmeshgroup *newmeshes() = 0;
@@ -424,7 +496,9 @@ struct vertmodel : animmodel
     meshgroup *loadmeshes(const char *name, float smooth = 2)
     {
         vertmeshgroup *group = newmeshes();
+        if(group->loadcooked(name, smooth)) return group;
         if(!group->load(name, smooth)) { delete group; return NULL; }
+        group->savecooked(name, smooth);
         return group;
     }
 
@@ -234,7 +234,9 @@ static bool modifyoctaent(int flags, int id, extentity &e)
             break;
         case ET_SPOTLIGHT: if(!(flags&MODOE_ADD ? spotlights++ : --spotlights)) { cleardeferredlightshaders(); cleanupvolumetric(); } break;
         case ET_PARTICLES: clearparticleemitters(); break;
+        case ET_SOUND: clearmapsoundindex(); break;
         case ET_DECAL: if(flags&MODOE_CHANGED) changed(o, r, false); break;
+        case ET_MAPMODEL: if(flags&MODOE_CHANGED) { recalcregion.add(o, r); clearshadowmeshes(o, r); } break; // shadow meshes bake in mapmodels
     }
     return true;
 }
@@ -381,6 +383,7 @@ undoblock *newundoent()
     if(numents <= 0) return NULL;
     undoblock *u = (undoblock *)new uchar[sizeof(undoblock) + numents*sizeof(undoent)];
     u->numents = numents;
+    u->pack = NULL;
     undoent *e = (undoent *)(u + 1);
     loopv(entgroup)
     {
@@ -474,7 +477,7 @@ void attachentities()
         if(oldtype!=e.type) detachentity(e); \
         if(e.type!=ET_EMPTY) { addentityedit(n); if(oldtype!=e.type) attachentity(e); } \
         entities::editent(n, true); \
-        clearshadowcache(); \
+        clearshadowmaps(); \
     }, v); \
 }
 #define entedit(i, f)   enteditv(i, f, entities::getents())
@@ -1414,6 +1417,7 @@ bool emptymap(int scale, bool force, const char *mname, bool usecfg)    // main
 
     texmru.shrink(0);
     freeocta(worldroot);
+    trimoctapools();
     worldroot = newcubes(F_EMPTY);
     loopi(4) solidfaces(worldroot[i]);
 
@@ -1428,6 +1432,7 @@ bool emptymap(int scale, bool force, const char *mname, bool usecfg)    // main
         identflags &= ~IDF_OVERRIDDEN;
     }
 
+    remipregion.all();
     allchanged(true);
 
     startmap(mname);
@@ -1457,6 +1462,7 @@ bool enlargemap(bool force)
 
     enlargeblendmap();
 
+    remipregion.all();
     allchanged();
 
     return true;
@@ -1499,6 +1505,8 @@ void shrinkmap()
 
     shrinkblendmap(octant);
 
+    remipregion.all();
+    recalcregion.all();
     allchanged();
 
     conoutf("shrunk map to size %d", worldscale);
@@ -1541,7 +1549,7 @@ void mpeditent(int i, const vec &o, int type, int attr1, int attr2, int attr3, i
         if(oldtype!=type) attachentity(e);
     }
     entities::editent(i, local);
-    clearshadowcache();
+    clearshadowmaps();
     commitchanges();
 }
 
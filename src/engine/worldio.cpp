@@ -718,6 +718,7 @@ bool load_world(const char *mname, const char *cname)        // still supports a
 
     freeocta(worldroot);
     worldroot = NULL;
+    trimoctapools();
 
     int worldscale = 0;
     while(1<<worldscale < hdr.worldsize) worldscale++;
@@ -895,6 +896,7 @@ bool load_world(const char *mname, const char *cname)        // still supports a
 
     entitiesinoctanodes();
     attachentities();
+    remipregion.all();
     allchanged(true);
 
     renderbackground("loading...", mapshot, mname, game::getmapinfo());
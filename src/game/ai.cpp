@@ -7,7 +7,7 @@ namespace ai
     using namespace game;
 
     avoidset obstacles;
-    int updatemillis = 0, iteration = 0, itermillis = 0, forcegun = -1;
+    int updatemillis = 0, forcegun = -1;
     vec aitarget(0, 0, 0);
 
     VAR(aidebug, 0, 0, 6);
@@ -60,7 +60,7 @@ namespace ai
         return e->state == CS_ALIVE && !isteam(d->team, e->team);
     }
 
-    bool getsight(vec &o, float yaw, float pitch, vec &q, vec &v, float mdist, float fovx, float fovy)
+    static inline bool infov(const vec &o, float yaw, float pitch, const vec &q, float mdist, float fovx, float fovy)
     {
         float dist = o.dist(q);
 
@@ -68,11 +68,16 @@ namespace ai
         {
             float x = fmod(fabs(asin((q.z-o.z)/dist)/RAD-pitch), 360);
             float y = fmod(fabs(-atan2(q.x-o.x, q.y-o.y)/RAD-yaw), 360);
-            if(min(x, 360-x) <= fovx && min(y, 360-y) <= fovy) return raycubelos(o, q, v);
+            if(min(x, 360-x) <= fovx && min(y, 360-y) <= fovy) return true;
         }
         return false;
     }
 
+    bool getsight(vec &o, float yaw, float pitch, vec &q, vec &v, float mdist, float fovx, float fovy)
+    {
+        return infov(o, yaw, pitch, q, mdist, fovx, fovy) && raycubelos(o, q, v);
+    }
+
     bool cansee(gameent *d, vec &x, vec &y, vec &targ)
     {
         aistate &b = d->ai->getstate();
@@ -81,6 +86,47 @@ namespace ai
         return false;
     }
 
+    // enemy, target and process all ask about the same pairs each frame, and target rescans every player after each refusal,
+    // so rays between a bot and each client are kept for the frame and only recast when either end point moves
+    // aisightreuse lets rays to anyone but the current enemy be reused for that long while both ends stay within 8 units
+    VAR(aisightreuse, 0, 0, 1000);
+    static int sightqueries = 0, sightrays = 0;
+
+    static bool sightline(gameent *d, gameent *e, const vec &o, const vec &q, vec &v)
+    {
+        sightqueries++;
+        if(e->clientnum < 0) { sightrays++; return raycubelos(o, q, v); }
+        while(d->ai->sights.length() <= e->clientnum) d->ai->sights.add().millis = -1;
+        aisight &s = d->ai->sights[e->clientnum];
+        if(s.millis >= 0 && (s.millis == lastmillis ? s.from == o && s.to == q :
+            aisightreuse && d->ai->enemy != e->clientnum && lastmillis - s.millis <= aisightreuse && s.from.squaredist(o) <= 64 && s.to.squaredist(q) <= 64))
+        {
+            v = s.hit;
+            return s.visible;
+        }
+        sightrays++;
+        s.from = o;
+        s.to = q;
+        s.millis = lastmillis;
+        s.visible = raycubelos(o, q, s.hit);
+        v = s.hit;
+        return s.visible;
+    }
+
+    bool cansee(gameent *d, gameent *e, vec &x, vec &y, vec &targ)
+    {
+        aistate &b = d->ai->getstate();
+        if(canmove(d) && b.type != AI_S_WAIT && infov(x, d->yaw, d->pitch, y, d->ai->views[2], d->ai->views[0], d->ai->views[1]))
+            return sightline(d, e, x, y, targ);
+        return false;
+    }
+
+    ICOMMAND(aisightstats, "", (),
+    {
+        conoutf("ai sight: %d queries, %d rays cast (%.1f%% reused)", sightqueries, sightrays, sightqueries ? 100.0f*(sightqueries - sightrays)/sightqueries : 0.0f);
+        sightqueries = sightrays = 0;
+    });
+
     bool canshoot(gameent *d, int atk, gameent *e)
     {
         if(attackrange(d, atk, e->o.squaredist(d->o)) && targetable(d, e))
@@ -189,10 +235,22 @@ namespace ai
         else if(d->ai) destroy(d);
     }
 
+    // decision passes (finding interests, planning routes) run once per aithinkrate for each ai,
+    // the most overdue first, for as many ai as fit in aibudget microseconds this frame
+    // the rest wait for the next frame; with a budget of 0 only one ai decides per frame
+    VAR(aithinkrate, 100, 1000, 10000);
+    VAR(aibudget, 0, 1000, 100000);
+
+    static bool overduethink(const gameent *a, const gameent *b)
+    {
+        return a->ai->nextthink < b->ai->nextthink;
+    }
+
     void update()
     {
+        PROFILE("ai");
         if(intermission) { loopv(players) if(players[i]->ai) players[i]->stopmoving(); }
-        else // fixed rate logic done out-of-sequence at 1 frame per second for each ai
+        else // fixed rate logic done out-of-sequence
         {
             if(totalmillis-updatemillis > 1000)
             {
@@ -200,16 +258,45 @@ namespace ai
                 forcegun = multiplayer(false) ? -1 : aiforcegun;
                 updatemillis = totalmillis;
             }
-            if(!iteration && totalmillis-itermillis > 1000)
+            static vector<gameent *> due;
+            due.setsize(0);
+            loopv(players) if(players[i]->ai && totalmillis - players[i]->ai->nextthink >= 0) due.add(players[i]);
+            due.sort(overduethink);
+            uint start = getclockmicros();
+            loopv(due)
             {
-                iteration = 1;
-                itermillis = totalmillis;
+                gameent *d = due[i];
+                uint begin = getclockmicros();
+                if(i && (!aibudget || begin - start >= uint(aibudget)))
+                {
+                    for(int j = i; j < due.length(); j++) due[j]->ai->thinkdeferred++;
+                    due.setsize(i);
+                    break;
+                }
+                think(d, true);
+                if(!d->ai) continue;
+                uint cost = getclockmicros() - begin;
+                d->ai->thinkmicros += cost;
+                d->ai->thinkpeak = max(d->ai->thinkpeak, cost);
+                d->ai->thinkruns++;
+                d->ai->nextthink = totalmillis + aithinkrate;
             }
-            int count = 0;
-            loopv(players) if(players[i]->ai) think(players[i], ++count == iteration ? true : false);
-            if(++iteration > count) iteration = 0;
+            loopv(players) if(players[i]->ai && due.find(players[i]) < 0) think(players[i], false);
+        }
+    }
+
+    void aistats()
+    {
+        loopv(players) if(players[i]->ai)
+        {
+            gameent *d = players[i];
+            aiinfo &ai = *d->ai;
+            conoutf("%s: %d decisions, %.1f us average, %u us peak, %d deferred", colorname(d), ai.thinkruns, ai.thinkruns ? float(ai.thinkmicros)/ai.thinkruns : 0.0f, ai.thinkpeak, ai.thinkdeferred);
+            ai.thinkruns = ai.thinkdeferred = 0;
+            ai.thinkmicros = ai.thinkpeak = 0;
         }
     }
+    COMMAND(aistats, "");
 
     bool checkothers(vector<int> &targets, gameent *d, int state, int targtype, int target, bool teams, int *members)
     { // checks the states of other ai for a match
@@ -287,7 +374,7 @@ namespace ai
             if(e == d || !targetable(d, e)) continue;
             vec ep = getaimpos(d, atk, e);
             float dist = ep.squaredist(dp);
-            if(dist < bestdist && (cansee(d, dp, ep) || dist <= mindist))
+            if(dist < bestdist && (cansee(d, e, dp, ep) || dist <= mindist))
             {
                 t = e;
                 bestdist = dist;
@@ -372,7 +459,7 @@ namespace ai
                 if(e == d || hastried.find(e) >= 0 || !targetable(d, e)) continue;
                 vec ep = getaimpos(d, atk, e);
                 float v = ep.squaredist(dp);
-                if((!t || v < dist) && (mindist <= 0 || v <= mindist) && (force || cansee(d, dp, ep)))
+                if((!t || v < dist) && (mindist <= 0 || v <= mindist) && (force || cansee(d, e, dp, ep)))
                 {
                     t = e;
                     dist = v;
@@ -1014,7 +1101,7 @@ namespace ai
             float yaw, pitch;
             getyawpitch(dp, ep, yaw, pitch);
             fixrange(yaw, pitch);
-            bool insight = cansee(d, dp, ep), hasseen = d->ai->enemyseen && lastmillis-d->ai->enemyseen <= (d->skill*10)+3000,
+            bool insight = cansee(d, e, dp, ep), hasseen = d->ai->enemyseen && lastmillis-d->ai->enemyseen <= (d->skill*10)+3000,
                 quick = d->ai->enemyseen && lastmillis-d->ai->enemyseen <= skmod+30;
             if(insight) d->ai->enemyseen = lastmillis;
             if(idle || insight || hasseen || quick)
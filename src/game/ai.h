@@ -24,23 +24,19 @@ namespace ai
     struct waypoint
     {
         vec o;
-        float curscore, estscore;
         int weight;
-        ushort route, prev;
         ushort links[MAXWAYPOINTLINKS];
 
         waypoint() {}
-        waypoint(const vec &o, int weight = 0) : o(o), weight(weight), route(0) { memset(links, 0, sizeof(links)); }
+        waypoint(const vec &o, int weight = 0) : o(o), weight(weight) { memset(links, 0, sizeof(links)); }
 
-        int score() const { return int(curscore) + int(estscore); }
-
-        int find(int wp)
+        int find(int wp) const
         {
             loopi(MAXWAYPOINTLINKS) if(links[i] == wp) return i;
             return -1;
         }
 
-        bool haslinks() { return links[0]!=0; }
+        bool haslinks() const { return links[0]!=0; }
     };
     extern vector<waypoint> waypoints;
 
@@ -128,7 +124,42 @@ namespace ai
         int remap(gameent *d, int n, vec &pos, bool retry = false);
     };
 
+    // scratch for one route search, kept apart from the graph so each search thread can own one
+    struct routestate
+    {
+        struct opennode
+        {
+            int score;
+            ushort wp;
+        };
+
+        vector<float> curscore, estscore;
+        vector<ushort> route, prev;
+        vector<opennode> queue;
+        ushort routeid;
+
+        routestate() : routeid(0) {}
+
+        void reset(int numwp)
+        {
+            int grow = numwp - route.length();
+            if(grow > 0)
+            {
+                curscore.pad(grow);
+                estscore.pad(grow);
+                memset(route.pad(grow), 0, grow*sizeof(ushort));
+                prev.pad(grow);
+            }
+            if(!++routeid)
+            {
+                memset(route.getbuf(), 0, route.length()*sizeof(ushort));
+                routeid = 1;
+            }
+        }
+    };
+
     extern bool route(gameent *d, int node, int goal, vector<int> &route, const avoidset &obstacles, int retries = 0);
+    extern bool route(routestate &rs, gameent *d, int node, int goal, vector<int> &route, const avoidset &obstacles, int retries = 0);
     extern void navigate();
     extern void clearwaypoints(bool full = false);
     extern void seedwaypoints();
@@ -182,17 +213,27 @@ namespace ai
 
     const int NUMPREVNODES = 6;
 
+    struct aisight
+    {
+        vec from, to, hit;
+        int millis;
+        bool visible;
+    };
+
     struct aiinfo
     {
         vector<aistate> state;
+        vector<aisight> sights; // last line of sight to each client, indexed by client number
         vector<int> route;
         vec target, spot;
         int enemy, enemyseen, enemymillis, weappref, prevnodes[NUMPREVNODES], targnode, targlast, targtime, targseq,
-            lastrun, lasthunt, lastaction, lastcheck, jumpseed, jumprand, blocktime, huntseq, blockseq, lastaimrnd;
+            lastrun, lasthunt, lastaction, lastcheck, jumpseed, jumprand, blocktime, huntseq, blockseq, lastaimrnd,
+            nextthink, thinkruns, thinkdeferred;
+        uint thinkmicros, thinkpeak;
         float targyaw, targpitch, views[3], aimrnd[3];
         bool dontmove, becareful, tryreset, trywipe;
 
-        aiinfo()
+        aiinfo() : nextthink(0), thinkruns(0), thinkdeferred(0), thinkmicros(0), thinkpeak(0)
         {
             clearsetup();
             reset();
@@ -288,6 +329,7 @@ namespace ai
     extern float viewfieldy(int x = 101);
     extern bool targetable(gameent *d, gameent *e);
     extern bool cansee(gameent *d, vec &x, vec &y, vec &targ = aitarget);
+    extern bool cansee(gameent *d, gameent *e, vec &x, vec &y, vec &targ = aitarget);
 
     extern void init(gameent *d, int at, int on, int sk, int bn, int pm, int col, const char *name, int team);
     extern void update();
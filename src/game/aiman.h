@@ -216,6 +216,7 @@ namespace aiman
 
     void checkai()
     {
+        PROFILE("ai");
         if(!dorefresh) return;
         dorefresh = false;
         if(m_botmode && numclients(-1, false, true))
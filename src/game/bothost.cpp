@@ -0,0 +1,507 @@
+// bothost.cpp: protocol load generator that plays a server with many scripted bots
+// each bot is a full network client that follows the map's waypoint graph, fights the other bots and respawns,
+// without any world geometry or renderer
+// the bots do not run the game's ai:: or physics code, which needs the whole client; they use a simple a* over
+// the waypoints, straight line movement and distance only sight, so only the load they put on the server is measured
+// the server needs maxclients set at least as high as the number of bots
+
+#include "game.h"
+#include "loadclient.h"
+
+#define THINKRATE 250
+#define SIGHTDIST 512.0f
+#define BOTSPEED 100.0f
+#define RESPAWNDELAY 2000
+
+struct botnode
+{
+    vec o;
+    ushort links[ai::MAXWAYPOINTLINKS];
+};
+
+static vector<botnode> botnodes;
+static string botmap = "";
+
+struct bot
+{
+    ENetPeer *peer;
+    int index, clientnum, lifesequence;
+    bool connected, alive;
+    int nextspawn, nextthink, lastshot, target;
+    vec o, vel;
+    float yaw, pitch;
+    vector<int> route;
+    int routepos;
+};
+
+static vector<bot> bots;
+static ENetHost *bothost = NULL;
+static int numbots = 16, posrate = 30, duration = 60, accuracy = 25;
+static string hostname = "localhost";
+static int port = TESSERACT_SERVER_PORT;
+static int routes = 0, shots = 0, hits = 0, deaths = 0;
+static uint sentbytes = 0, receivedbytes = 0;
+
+static void loadbotnodes(const char *mname)
+{
+    if(!strcmp(botmap, mname)) return;
+    copystring(botmap, mname);
+    botnodes.setsize(0);
+    if(!mname[0]) return;
+    defformatstring(wptname, "media/map/%s.wpt", mname);
+    path(wptname);
+    stream *f = opengzfile(wptname, "rb");
+    if(!f) { conoutf("no waypoints for %s, bots will wander", mname); return; }
+    char magic[4];
+    if(f->read(magic, 4) < 4 || memcmp(magic, "OWPT", 4)) { delete f; return; }
+    botnodes.add().o = vec(0, 0, 0);
+    memset(botnodes[0].links, 0, sizeof(botnodes[0].links));
+    ushort numwp = f->getlil<ushort>();
+    loopi(numwp)
+    {
+        if(f->end()) break;
+        botnode &n = botnodes.add();
+        n.o.x = f->getlil<float>();
+        n.o.y = f->getlil<float>();
+        n.o.z = f->getlil<float>();
+        memset(n.links, 0, sizeof(n.links));
+        int numlinks = f->getchar(), k = 0;
+        loopj(numlinks)
+        {
+            if((n.links[k] = f->getlil<ushort>()))
+            {
+                if(++k >= ai::MAXWAYPOINTLINKS) break;
+            }
+        }
+    }
+    delete f;
+    loopv(botnodes) loopj(ai::MAXWAYPOINTLINKS) if(botnodes[i].links[j] >= botnodes.length()) botnodes[i].links[j] = 0;
+    conoutf("loaded %d waypoints from %s", botnodes.length()-1, wptname);
+}
+
+static int closestnode(const vec &o)
+{
+    int best = 0;
+    float bestdist = 1e16f;
+    for(int i = 1; i < botnodes.length(); i++)
+    {
+        float dist = botnodes[i].o.squaredist(o);
+        if(dist < bestdist) { best = i; bestdist = dist; }
+    }
+    return best;
+}
+
+// A* over the waypoint graph, with the open list kept as a binary heap
+static vector<int> openheap, nodeprev;
+static vector<float> nodecost, nodescore;
+static vector<uint> nodestamp;
+static uint routestamp = 0;
+
+static inline bool heapless(int a, int b) { return nodescore[a] < nodescore[b]; }
+
+static void heappush(int n)
+{
+    int i = openheap.length();
+    openheap.add(n);
+    while(i > 0)
+    {
+        int parent = (i-1)/2;
+        if(!heapless(openheap[i], openheap[parent])) break;
+        swap(openheap[i], openheap[parent]);
+        i = parent;
+    }
+}
+
+static int heappop()
+{
+    int top = openheap[0], last = openheap.pop();
+    if(openheap.empty()) return top;
+    openheap[0] = last;
+    int i = 0;
+    for(;;)
+    {
+        int child = 2*i+1;
+        if(child >= openheap.length()) break;
+        if(child+1 < openheap.length() && heapless(openheap[child+1], openheap[child])) child++;
+        if(!heapless(openheap[child], openheap[i])) break;
+        swap(openheap[i], openheap[child]);
+        i = child;
+    }
+    return top;
+}
+
+static bool findroute(int from, int to, vector<int> &route)
+{
+    route.setsize(0);
+    if(!from || !to) return false;
+    routes++;
+    if(nodestamp.length() < botnodes.length())
+    {
+        int n = botnodes.length() - nodestamp.length();
+        memset(nodestamp.pad(n), 0, n*sizeof(uint));
+        nodeprev.pad(n);
+        nodecost.pad(n);
+        nodescore.pad(n);
+    }
+    if(!++routestamp) { memset(nodestamp.getbuf(), 0, nodestamp.length()*sizeof(uint)); routestamp = 1; }
+    openheap.setsize(0);
+    nodestamp[from] = routestamp;
+    nodeprev[from] = 0;
+    nodecost[from] = 0;
+    nodescore[from] = botnodes[from].o.dist(botnodes[to].o);
+    heappush(from);
+    while(openheap.length())
+    {
+        int cur = heappop();
+        if(cur == to)
+        {
+            for(int n = to; n; n = nodeprev[n]) route.add(n);
+            route.reverse();
+            return true;
+        }
+        const botnode &n = botnodes[cur];
+        loopi(ai::MAXWAYPOINTLINKS)
+        {
+            int link = n.links[i];
+            if(!link) break;
+            float cost = nodecost[cur] + n.o.dist(botnodes[link].o);
+            if(nodestamp[link] == routestamp && cost >= nodecost[link]) continue;
+            nodestamp[link] = routestamp;
+            nodeprev[link] = cur;
+            nodecost[link] = cost;
+            nodescore[link] = cost + botnodes[link].o.dist(botnodes[to].o);
+            heappush(link);
+        }
+    }
+    return false;
+}
+
+static void sendbotpacket(bot &b, int chan, packetbuf &p)
+{
+    ENetPacket *packet = p.finalize();
+    sentbytes += packet->dataLength;
+    enet_peer_send(b.peer, chan, packet);
+    if(!packet->referenceCount) enet_packet_destroy(packet);
+}
+
+static void sendbotmsg(bot &b, int type, int n = 0, const int *args = NULL)
+{
+    packetbuf p(MAXTRANS, ENET_PACKET_FLAG_RELIABLE);
+    putint(p, type);
+    loopi(n) putint(p, args[i]);
+    sendbotpacket(b, 1, p);
+}
+
+static void spawnbot(bot &b, int lifesequence, int millis)
+{
+    b.lifesequence = lifesequence;
+    b.alive = true;
+    b.target = -1;
+    b.route.setsize(0);
+    b.routepos = 0;
+    b.nextthink = millis;
+    b.vel = vec(0, 0, 0);
+    if(botnodes.length() > 1) b.o = botnodes[1 + rnd(botnodes.length()-1)].o;
+    else b.o = vec(512 + rnd(256), 512 + rnd(256), 512);
+    int args[2] = { lifesequence, GUN_RAIL };
+    sendbotmsg(b, N_SPAWN, 2, args);
+}
+
+static bot *findbot(int cn)
+{
+    loopv(bots) if(bots[i].clientnum == cn) return &bots[i];
+    return NULL;
+}
+
+static inline vec boteye(const bot &b) { return vec(b.o).addz(18); }
+
+static void shoot(bot &b, bot &t, int millis)
+{
+    int atk = ATK_RAIL_SHOOT;
+    vec from = boteye(b), to = boteye(t);
+    bool hit = rnd(100) < accuracy;
+    if(!hit) to.add(vec(rndscale(32)-16, rndscale(32)-16, rndscale(16)));
+    packetbuf p(MAXTRANS, ENET_PACKET_FLAG_RELIABLE);
+    putint(p, N_SHOOT);
+    putint(p, millis);
+    putint(p, atk);
+    loopk(3) putint(p, int(from[k]*DMF));
+    loopk(3) putint(p, int(to[k]*DMF));
+    putint(p, hit ? 1 : 0);
+    if(hit)
+    {
+        vec dir = vec(to).sub(from).normalize();
+        putint(p, t.clientnum);
+        putint(p, t.lifesequence);
+        putint(p, int(from.dist(to)*DMF));
+        putint(p, 1);
+        loopk(3) putint(p, int(dir[k]*DNF));
+        hits++;
+    }
+    sendbotpacket(b, 1, p);
+    b.lastshot = millis;
+    shots++;
+}
+
+static void think(bot &b, int millis)
+{
+    b.nextthink = millis + THINKRATE;
+
+    b.target = -1;
+    float bestdist = SIGHTDIST*SIGHTDIST;
+    loopv(bots)
+    {
+        bot &t = bots[i];
+        if(&t == &b || !t.alive) continue;
+        float dist = t.o.squaredist(b.o);
+        if(dist < bestdist) { b.target = i; bestdist = dist; }
+    }
+
+    if(botnodes.length() > 1 && b.routepos >= b.route.length())
+    {
+        int goal = b.target >= 0 ? closestnode(bots[b.target].o) : 1 + rnd(botnodes.length()-1);
+        findroute(closestnode(b.o), goal, b.route);
+        b.routepos = 0;
+    }
+}
+
+static void move(bot &b, int millis, float secs)
+{
+    vec dir(0, 0, 0);
+    float step = BOTSPEED*secs;
+    if(b.routepos < b.route.length())
+    {
+        vec goal = botnodes[b.route[b.routepos]].o;
+        float dist = goal.dist(b.o);
+        if(dist <= step)
+        {
+            b.o = goal;
+            b.routepos++;
+        }
+        else
+        {
+            dir = vec(goal).sub(b.o).div(dist);
+            b.o.add(vec(dir).mul(step));
+        }
+    }
+    else if(botnodes.length() <= 1)
+    {
+        dir = vec(b.yaw*RAD, 0.0f);
+        b.o.add(vec(dir).mul(step));
+        b.yaw += 90*secs;
+    }
+    b.vel = vec(dir).mul(BOTSPEED);
+
+    if(b.target >= 0 && bots[b.target].alive)
+    {
+        vec aim = vec(boteye(bots[b.target])).sub(boteye(b));
+        vectoyawpitch(aim, b.yaw, b.pitch);
+        if(millis - b.lastshot >= attacks[ATK_RAIL_SHOOT].attackdelay && aim.magnitude() < attacks[ATK_RAIL_SHOOT].range) shoot(b, bots[b.target], millis);
+    }
+    else if(!dir.iszero()) vectoyawpitch(dir, b.yaw, b.pitch);
+
+    packetbuf p(64, 0);
+    putposition(p, b.clientnum, b.lifesequence, b.o, b.yaw, b.pitch, b.vel);
+    sendbotpacket(b, 0, p);
+}
+
+static void parsebotpacket(bot &b, ENetPacket *packet, int chan, int millis)
+{
+    receivedbytes += packet->dataLength;
+    if(chan != 1) return;
+    // the server batches its broadcasts into the worldstate's messages, so messages are read until one the bots don't track
+    ucharbuf p(packet->data, packet->dataLength);
+    while(p.remaining() > 0 && !p.overread())
+    {
+        int type = getint(p);
+        switch(type)
+        {
+            case N_SERVINFO:
+                b.clientnum = getint(p);
+                return;
+
+            case N_WELCOME:
+            {
+                string mname = "";
+                // the welcome may contain the first spawn state
+                int ls = parsewelcome(p, b.clientnum, mname);
+                loadbotnodes(mname);
+                if(ls >= 0) spawnbot(b, ls, millis);
+                else b.nextspawn = millis + RESPAWNDELAY;
+                return;
+            }
+
+            case N_MAPCHANGE:
+            {
+                string mname;
+                getstring(mname, p);
+                getint(p);
+                getint(p);
+                loadbotnodes(mname);
+                b.alive = false;
+                b.nextspawn = millis + RESPAWNDELAY;
+                break;
+            }
+
+            case N_SPAWNSTATE:
+            {
+                int ls, cn = getspawnstate(p, ls);
+                if(cn == b.clientnum) spawnbot(b, ls, millis);
+                break;
+            }
+
+            case N_DIED:
+            {
+                bot *t = findbot(getint(p));
+                loopi(3) getint(p);
+                if(t && t->alive)
+                {
+                    t->alive = false;
+                    t->nextspawn = millis + RESPAWNDELAY;
+                    deaths++;
+                }
+                break;
+            }
+
+            default:
+                if(!skiploadmessage(type, p)) return;
+                break;
+        }
+    }
+}
+
+static bool botoption(const char *opt)
+{
+    if(opt[0] != '-') return false;
+    switch(opt[1])
+    {
+        case 'h': copystring(hostname, opt+2); return true;
+        case 'p': port = atoi(opt+2); return true;
+        case 'c': numbots = clamp(atoi(opt+2), 1, MAXCLIENTS); return true;
+        case 'r': posrate = clamp(atoi(opt+2), 1, 1000); return true;
+        case 't': duration = max(atoi(opt+2), 1); return true;
+        case 'a': accuracy = clamp(atoi(opt+2), 0, 100); return true;
+        default: return false;
+    }
+}
+
+static void printstatus(int elapsed)
+{
+    int connected = 0, alive = 0;
+    loopv(bots)
+    {
+        bot &b = bots[i];
+        if(b.connected) connected++;
+        if(b.alive) alive++;
+    }
+    float secs = max(elapsed, 1)/1000.0f;
+    printf("%d connected, %d alive, %d routes, %d shots, %d hits, %d deaths, %.1f K/sec sent, %.1f K/sec received\n",
+        connected, alive, routes, shots, hits, deaths, sentbytes/1024.0f/secs, receivedbytes/1024.0f/secs);
+    routes = shots = hits = deaths = 0;
+    sentbytes = receivedbytes = 0;
+}
+
+int main(int argc, char **argv)
+{
+    for(int i = 1; i < argc; i++) if(!botoption(argv[i]))
+    {
+        printf("usage: tess_bothost [-hHOST] [-pPORT] [-cBOTS] [-rPOSRATE] [-tSECONDS] [-aACCURACY]\n"
+               "bots are scripted with simplified pathing, movement and sight, not the game's ai, and only load the server\n");
+        return EXIT_FAILURE;
+    }
+    if(enet_initialize() < 0) { printf("unable to initialise network module\n"); return EXIT_FAILURE; }
+    atexit(enet_deinitialize);
+    enet_time_set(0);
+    seedMT(getclockmicros());
+
+    ENetAddress address;
+    if(enet_address_set_host(&address, hostname) < 0) { printf("could not resolve %s\n", hostname); return EXIT_FAILURE; }
+    address.port = port;
+    bothost = enet_host_create(NULL, numbots, 3, 0, 0);
+    if(!bothost) { printf("could not create client host\n"); return EXIT_FAILURE; }
+    loopi(numbots)
+    {
+        bot &b = bots.add();
+        b.peer = enet_host_connect(bothost, &address, 3, 0);
+        b.peer->data = (void *)(intptr_t)i;
+        b.index = i;
+        b.clientnum = -1;
+        b.lifesequence = 0;
+        b.connected = b.alive = false;
+        b.nextspawn = b.nextthink = b.lastshot = 0;
+        b.target = -1;
+        b.o = b.vel = vec(0, 0, 0);
+        b.yaw = i*360.0f/numbots;
+        b.pitch = 0;
+        b.routepos = 0;
+    }
+
+    printf("hosting %d bots on %s:%d for %d seconds\n", numbots, hostname, port, duration);
+    int lastmove = 0, lastping = 0, laststatus = 0;
+    for(;;)
+    {
+        int millis = int(enet_time_get());
+        if(millis >= duration*1000) break;
+        loopv(bots)
+        {
+            bot &b = bots[i];
+            if(!b.connected || b.clientnum < 0) continue;
+            if(!b.alive && b.nextspawn && millis >= b.nextspawn)
+            {
+                // the server ignores this unless the bot is actually dead, so it doubles as a retry
+                sendbotmsg(b, N_TRYSPAWN);
+                b.nextspawn = millis + RESPAWNDELAY;
+            }
+            if(b.alive && millis >= b.nextthink) think(b, millis);
+        }
+        if(millis - lastmove >= 1000/posrate)
+        {
+            float secs = (millis - lastmove)/1000.0f;
+            lastmove = millis;
+            loopv(bots) if(bots[i].alive) move(bots[i], millis, secs);
+        }
+        if(millis - lastping >= 1000)
+        {
+            lastping = millis;
+            loopv(bots) if(bots[i].connected) sendbotmsg(bots[i], N_PING, 1, &millis);
+        }
+        if(millis - laststatus >= 5000)
+        {
+            printstatus(millis - laststatus);
+            laststatus = millis;
+        }
+
+        ENetEvent event;
+        while(enet_host_service(bothost, &event, 1) > 0)
+        {
+            bot &b = bots[(intptr_t)event.peer->data];
+            switch(event.type)
+            {
+                case ENET_EVENT_TYPE_CONNECT:
+                {
+                    b.connected = true;
+                    defformatstring(name, "bot%d", b.index);
+                    packetbuf p(MAXTRANS, ENET_PACKET_FLAG_RELIABLE);
+                    putconnect(p, name);
+                    sendbotpacket(b, 1, p);
+                    break;
+                }
+                case ENET_EVENT_TYPE_RECEIVE:
+                    parsebotpacket(b, event.packet, event.channelID, millis);
+                    enet_packet_destroy(event.packet);
+                    break;
+                case ENET_EVENT_TYPE_DISCONNECT:
+                    printf("bot %d disconnected (%s)\n", b.index, b.connected ? "dropped" : "could not connect");
+                    b.connected = b.alive = false;
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    loopv(bots) if(bots[i].connected) enet_peer_disconnect(bots[i].peer, DISC_NONE);
+    enet_host_flush(bothost);
+    enet_host_destroy(bothost);
+    return EXIT_SUCCESS;
+}
@@ -923,9 +923,12 @@ namespace game
         memset(connectpass, 0, sizeof(connectpass));
     }
 
+    editstream editout;
+
     void gameconnect(bool _remote)
     {
         remote = _remote;
+        editout.reset();
     }
 
     void gamedisconnect(bool cleanup)
@@ -940,6 +943,7 @@ namespace game
         messages.setsize(0);
         messagereliable = false;
         messagecn = -1;
+        editout.reset();
         player1->respawn();
         player1->lifesequence = 0;
         player1->state = CS_ALIVE;
@@ -1061,6 +1065,21 @@ namespace game
         }
     }
 
+    // a tick's worth of coop edits goes out as one batch through the connection's edit stream
+    bool sendeditbatch(packetbuf &p)
+    {
+        static vector<uchar> data;
+        data.setsize(0);
+        int flags = editout.compress(messages.getbuf(), messages.length(), data);
+        if(flags < 0) return false;
+        putint(p, N_EDITBATCH);
+        putint(p, flags);
+        putuint(p, messages.length());
+        putuint(p, data.length());
+        p.put(data.getbuf(), data.length());
+        return true;
+    }
+
     void sendmessages()
     {
         packetbuf p(MAXTRANS);
@@ -1082,7 +1101,8 @@ namespace game
         }
         if(messages.length())
         {
-            p.put(messages.getbuf(), messages.length());
+            if(!m_edit || !remote || !messagereliable || messages.length() < EDITBATCH_MIN || !sendeditbatch(p))
+                p.put(messages.getbuf(), messages.length());
             messages.setsize(0);
             if(messagereliable) p.reliable();
             messagereliable = false;
@@ -1099,6 +1119,7 @@ namespace game
 
     void c2sinfo(bool force) // send update to the server
     {
+        PROFILE("network");
         static int lastupdate = -1000;
         if(totalmillis - lastupdate < 40 && !force) return; // don't update faster than 30fps
         lastupdate = totalmillis;
@@ -1295,6 +1316,26 @@ namespace game
 
     extern int deathscore;
 
+    // stand-ins for the editors while an edit log replays, so their clipboards don't clobber the live ones
+    static vector<gameent *> replayclients;
+    static bool replaying = false;
+
+    gameent *editclient(int cn)
+    {
+        if(!replaying) return getclient(cn);
+        if(cn < 0 || cn >= MAXCLIENTS + MAXBOTS) return NULL;
+        while(replayclients.length() <= cn) replayclients.add(NULL);
+        if(!replayclients[cn])
+        {
+            gameent *d = new gameent;
+            d->clientnum = cn;
+            gameent *o = getclient(cn);
+            if(o) copystring(d->name, o->name);
+            replayclients[cn] = d;
+        }
+        return replayclients[cn];
+    }
+
     void parsemessages(int cn, gameent *d, ucharbuf &p)
     {
         static char text[MAXTRANS];
@@ -1363,6 +1404,22 @@ namespace game
                 break;
             }
 
+            case N_EDITBATCH:
+            {
+                int flags = getint(p), rawlen = getuint(p), packlen = getuint(p);
+                ucharbuf b = p.subbuf(max(packlen, 0));
+                if(!d || rawlen <= 0 || rawlen > EDITBATCH_MAX) break;
+                uchar *raw = new uchar[rawlen];
+                if(d->editbatch.decompress(flags, b.buf, b.maxlen, raw, rawlen))
+                {
+                    ucharbuf q(raw, rawlen);
+                    parsemessages(cn, d, q);
+                }
+                else conoutf(CON_ERROR, "lost edits from %s", colorname(d));
+                delete[] raw;
+                break;
+            }
+
             case N_SOUND:
                 if(!d) return;
                 playsound(getint(p), &d->o);
@@ -1674,7 +1731,7 @@ namespace game
             case N_CLIPBOARD:
             {
                 int cn = getint(p), unpacklen = getint(p), packlen = getint(p);
-                gameent *d = getclient(cn);
+                gameent *d = editclient(cn);
                 ucharbuf q = p.subbuf(max(packlen, 0));
                 if(d) unpackeditinfo(d->edit, q.buf, q.maxlen, unpacklen);
                 break;
@@ -1683,7 +1740,7 @@ namespace game
             case N_REDO:
             {
                 int cn = getint(p), unpacklen = getint(p), packlen = getint(p);
-                gameent *d = getclient(cn);
+                gameent *d = editclient(cn);
                 ucharbuf q = p.subbuf(max(packlen, 0));
                 if(d) unpackundo(q.buf, q.maxlen, unpacklen);
                 break;
@@ -2000,6 +2057,21 @@ namespace game
         }
     }
 
+    void replayedits(uchar *buf, int len)
+    {
+        replaying = true;
+        ucharbuf p(buf, len);
+        while(p.remaining())
+        {
+            int cn = getint(p), msglen = getuint(p);
+            ucharbuf q = p.subbuf(msglen);
+            if(cn < 0) parsemessages(-1, NULL, q);
+            else parsemessages(cn, editclient(cn), q);
+        }
+        replayclients.deletecontents();
+        replaying = false;
+    }
+
     void receivefile(packetbuf &p)
     {
         int type;
@@ -2036,6 +2108,28 @@ namespace game
                 remove(findfile(fname, "rb"));
                 break;
             }
+
+            case N_EDITLOG:
+            {
+                if(!m_edit) return;
+                int crc = getint(p), rawlen = getuint(p), packlen = getuint(p);
+                ucharbuf b = p.subbuf(max(packlen, 0));
+                if(rawlen <= 0 || rawlen > EDITLOG_MAX) return;
+                uchar *raw = new uchar[rawlen];
+                uLongf len = rawlen;
+                string mname;
+                copystring(mname, getclientmap());
+                if(uncompress(raw, &len, b.buf, b.maxlen) != Z_OK || len != uLongf(rawlen)) conoutf(CON_ERROR, "received corrupt edits");
+                else if(!load_world(mname) || int(getmapcrc()) != crc) conoutf(CON_ERROR, "could not reload map \"%s\" to replay edits on", mname);
+                else
+                {
+                    conoutf("received edits");
+                    replayedits(raw, rawlen);
+                    entities::spawnitems(true);
+                }
+                delete[] raw;
+                break;
+            }
         }
     }
 
@@ -0,0 +1,315 @@
+// editbench.cpp: replays a coop-edit session through the edit stream codec to measure the bytes it puts on the wire
+// with -f it replays a session saved by the server's recordedits command, otherwise it generates one of editors
+// pushing faces, retexturing, dragging entities, pasting and undoing
+// undo and clipboard packets are already deflated and go out the same in every scheme, so they are counted apart
+
+#include "game.h"
+
+static int numeditors = 4, numspectators = 0, duration = 300;
+static const char *sessionfile = NULL, *mapfile = NULL;
+
+// same layout as the server's edit recording: millis, editor or -1 for a packet carrying its own client number, message
+struct editframe
+{
+    int millis, cn, offset, len;
+};
+
+static vector<editframe> frames;
+static vector<uchar> framedata;
+
+static void addframe(int millis, int cn, const vector<uchar> &msg)
+{
+    editframe &f = frames.add();
+    f.millis = millis;
+    f.cn = cn;
+    f.offset = framedata.length();
+    f.len = msg.length();
+    framedata.put(msg.getbuf(), msg.length());
+}
+
+static void loadsession(const char *name)
+{
+    stream *f = openrawfile(name, "rb");
+    if(!f) fatal("could not open %s", name);
+    int size = int(f->size());
+    if(size <= 0) fatal("%s is empty", name);
+    uchar *buf = new uchar[size];
+    if(f->read(buf, size) != size_t(size)) fatal("could not read %s", name);
+    delete f;
+    ucharbuf p(buf, size);
+    vector<uchar> msg;
+    while(p.remaining())
+    {
+        int millis = getint(p), cn = getint(p), len = getuint(p);
+        if(len <= 0 || len > p.remaining()) fatal("%s is truncated", name);
+        msg.setsize(0);
+        msg.put(p.subbuf(len).buf, len);
+        addframe(millis, cn, msg);
+    }
+    delete[] buf;
+    vector<int> cns;
+    loopv(frames) if(frames[i].cn >= 0 && cns.find(frames[i].cn) < 0) cns.add(frames[i].cn);
+    numeditors = max(cns.length(), 1);
+}
+
+struct editor
+{
+    selinfo sel;
+    int activity, until, next, tex, ent;
+    vec entpos;
+};
+
+enum { EA_PUSH = 0, EA_TEXTURE, EA_DRAG, EA_PASTE, EA_UNDO, EA_IDLE, NUMEAS };
+
+static void putsel(vector<uchar> &msg, int type, const selinfo &sel)
+{
+    putint(msg, type);
+    putint(msg, sel.o.x); putint(msg, sel.o.y); putint(msg, sel.o.z);
+    putint(msg, sel.s.x); putint(msg, sel.s.y); putint(msg, sel.s.z);
+    putint(msg, sel.grid); putint(msg, sel.orient);
+    putint(msg, sel.cx); putint(msg, sel.cxs); putint(msg, sel.cy); putint(msg, sel.cys);
+    putint(msg, sel.corner);
+}
+
+static void putpacked(vector<uchar> &msg, int type, int cn, int len)
+{
+    putint(msg, type);
+    putint(msg, cn);
+    putint(msg, len*3);
+    putint(msg, len);
+    loopi(len) msg.add(randomMT()&0xFF);
+}
+
+static void pickselection(editor &e)
+{
+    e.sel.grid = 1<<(3 + rnd(3));
+    e.sel.o = ivec(rnd(64), rnd(64), rnd(16)).mul(e.sel.grid).add(ivec(1024, 1024, 512));
+    e.sel.s = ivec(1 + rnd(4), 1 + rnd(4), 1);
+    e.sel.orient = rnd(6);
+    e.sel.cx = e.sel.cy = 0;
+    e.sel.cxs = e.sel.s.x*2;
+    e.sel.cys = e.sel.s.y*2;
+    e.sel.corner = rnd(4);
+}
+
+static void gensession()
+{
+    vector<editor> editors;
+    loopi(numeditors)
+    {
+        editor &e = editors.add();
+        pickselection(e);
+        e.activity = EA_IDLE;
+        e.until = e.next = 0;
+        e.tex = rnd(400);
+        e.ent = rnd(200);
+        e.entpos = vec(1024 + rnd(512), 1024 + rnd(512), 512);
+    }
+    vector<uchar> msg;
+    for(int millis = 0; millis < duration*1000; millis += 10) loopv(editors)
+    {
+        editor &e = editors[i];
+        if(millis >= e.until)
+        {
+            e.activity = rnd(NUMEAS);
+            e.until = millis + 1000 + rnd(5000);
+            e.next = millis;
+            pickselection(e);
+            if(e.activity == EA_DRAG) e.ent = rnd(200);
+        }
+        if(millis < e.next) continue;
+        msg.setsize(0);
+        switch(e.activity)
+        {
+            case EA_PUSH:
+                putsel(msg, N_EDITF, e.sel);
+                putint(msg, rnd(8) ? 1 : -1);
+                putint(msg, 1);
+                addframe(millis, i, msg);
+                // dragging the selection along while pushing
+                if(!rnd(4)) e.sel.o[rnd(2)] += e.sel.grid;
+                e.next = millis + 80 + rnd(120);
+                break;
+            case EA_TEXTURE:
+                putsel(msg, N_EDITT, e.sel);
+                putint(msg, e.tex = (e.tex + 1)%400);
+                putint(msg, 0);
+                putint(msg, 0);
+                msg.pad(2);
+                *(ushort *)&msg[msg.length()-2] = 0;
+                addframe(millis, i, msg);
+                e.next = millis + 100 + rnd(200);
+                break;
+            case EA_DRAG:
+                e.entpos.add(vec(rndscale(8)-4, rndscale(8)-4, 0));
+                putint(msg, N_EDITENT);
+                putint(msg, e.ent);
+                loopk(3) putint(msg, int(e.entpos[k]*DMF));
+                putint(msg, ET_MAPMODEL);
+                putint(msg, 3); putint(msg, 90); putint(msg, 0); putint(msg, 0); putint(msg, 0);
+                addframe(millis, i, msg);
+                e.next = millis + 40;
+                break;
+            case EA_PASTE:
+                if(!rnd(8))
+                {
+                    putsel(msg, N_COPY, e.sel);
+                    addframe(millis, i, msg);
+                    msg.setsize(0);
+                    putpacked(msg, N_CLIPBOARD, i, 100 + rnd(1500));
+                    addframe(millis, -1, msg);
+                }
+                else
+                {
+                    e.sel.o.x += e.sel.s.x*e.sel.grid;
+                    putsel(msg, N_PASTE, e.sel);
+                    addframe(millis, i, msg);
+                }
+                e.next = millis + 400 + rnd(800);
+                break;
+            case EA_UNDO:
+                putpacked(msg, rnd(4) ? N_UNDO : N_REDO, i, 50 + rnd(500));
+                addframe(millis, -1, msg);
+                e.next = millis + 300 + rnd(700);
+                break;
+        }
+    }
+}
+
+struct scheme
+{
+    const char *name;
+    uint up, down;
+    int batches;
+    double millis;
+};
+
+static void runscheme(scheme &s, int mode)
+{
+    // 0: raw messages, 1: each batch deflated on its own, 2: one edit stream per sender
+    int maxcn = 0;
+    loopv(frames) maxcn = max(maxcn, frames[i].cn);
+    vector<vector<uchar> > pending;
+    vector<editstream *> senders, receivers;
+    loopi(maxcn + 1) { pending.add(); senders.add(new editstream); receivers.add(new editstream); }
+    vector<uchar> data, raw;
+    int receivercount = numeditors - 1 + numspectators;
+    s.up = s.down = 0;
+    s.batches = 0;
+    s.millis = 0;
+    int tick = frames.length() ? frames[0].millis/40 : 0;
+    for(int i = 0;; i++)
+    {
+        bool done = i >= frames.length();
+        if(done || frames[i].millis/40 != tick)
+        {
+            loopvj(pending)
+            {
+                vector<uchar> &msgs = pending[j];
+                if(msgs.empty()) continue;
+                int len = msgs.length();
+                if(mode && len >= EDITBATCH_MIN)
+                {
+                    data.setsize(0);
+                    uint start = getclockmicros();
+                    editstream fresh;
+                    int flags = (mode == 1 ? fresh : *senders[j]).compress(msgs.getbuf(), len, data);
+                    if(flags < 0) fatal("could not compress batch");
+                    raw.setsize(0);
+                    databuf<uchar> out = raw.reserve(len);
+                    if(!(mode == 1 ? fresh : *receivers[j]).decompress(mode == 1 ? EDITBATCH_RESET : flags, data.getbuf(), data.length(), out.buf, len) || memcmp(out.buf, msgs.getbuf(), len))
+                        fatal("batch %d did not survive the round trip", s.batches);
+                    s.millis += (getclockmicros() - start)/1000.0;
+                    s.batches++;
+                    vector<uchar> hdr;
+                    putint(hdr, N_EDITBATCH);
+                    putint(hdr, flags);
+                    putuint(hdr, len);
+                    putuint(hdr, data.length());
+                    len = hdr.length() + data.length();
+                }
+                // relayed as N_CLIENT cn len, sent once up and once down to every other client
+                vector<uchar> hdr;
+                putint(hdr, N_CLIENT);
+                putint(hdr, j);
+                putuint(hdr, len);
+                s.up += len;
+                s.down += (hdr.length() + len)*receivercount;
+                msgs.setsize(0);
+            }
+            if(done) break;
+            tick = frames[i].millis/40;
+        }
+        editframe &f = frames[i];
+        const uchar *msg = &framedata[f.offset];
+        if(f.cn < 0) continue;
+        pending[f.cn].put(msg, f.len);
+    }
+    senders.deletecontents();
+    receivers.deletecontents();
+}
+
+static bool loadoption(const char *arg)
+{
+    if(arg[0] != '-') return false;
+    switch(arg[1])
+    {
+        case 'e': numeditors = clamp(atoi(&arg[2]), 1, MAXCLIENTS); return true;
+        case 'r': numspectators = clamp(atoi(&arg[2]), 0, MAXCLIENTS); return true;
+        case 's': duration = max(atoi(&arg[2]), 1); return true;
+        case 'f': sessionfile = &arg[2]; return sessionfile[0] != '\0';
+        case 'm': mapfile = &arg[2]; return mapfile[0] != '\0';
+    }
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    for(int i = 1; i < argc; i++) if(!loadoption(argv[i]))
+    {
+        printf("usage: tess_editbench [-eEDITORS] [-rSPECTATORS] [-sSECONDS] [-fSESSION] [-mMAP.ogz]\n");
+        return EXIT_FAILURE;
+    }
+    seedMT(1);
+    if(sessionfile) loadsession(sessionfile);
+    else gensession();
+    if(frames.empty()) fatal("no edits to replay");
+    double seconds = max(frames.last().millis - frames[0].millis, 1)/1000.0;
+    printf("%d edits from %d editors over %.0f seconds, %d other clients each\n", frames.length(), numeditors, seconds, numeditors - 1 + numspectators);
+
+    uint packets = 0;
+    loopv(frames) if(frames[i].cn < 0) packets += frames[i].len;
+    printf("undo/clipboard packets up %8u bytes, down %9u bytes, the same in every scheme\n", packets, packets*(numeditors - 1 + numspectators));
+
+    scheme schemes[3] = { { "messages" }, { "batched" }, { "edit stream" } };
+    loopi(3)
+    {
+        scheme &s = schemes[i];
+        runscheme(s, i);
+        printf("%-12s up %8u bytes (%6.2f KB/s), down %9u bytes (%6.2f KB/s)", s.name, s.up, s.up/seconds/1024, s.down, s.down/seconds/1024);
+        if(s.batches) printf(", %.1f us/batch", s.millis*1000/s.batches);
+        printf("\n");
+    }
+
+    // the late joiner's download, exactly as the server packs its edit log
+    vector<uchar> editlog;
+    loopv(frames)
+    {
+        putint(editlog, frames[i].cn);
+        putuint(editlog, frames[i].len);
+        editlog.put(&framedata[frames[i].offset], frames[i].len);
+    }
+    uLongf len = compressBound(editlog.length());
+    uchar *packed = new uchar[len];
+    if(compress2(packed, &len, editlog.getbuf(), editlog.length(), Z_BEST_COMPRESSION) != Z_OK) fatal("could not compress edit log");
+    delete[] packed;
+    printf("late join: edit log %d bytes, %u compressed%s\n", editlog.length(), uint(len), editlog.length() > EDITLOG_MAX ? " (over the cap, the map would be sent)" : "");
+    if(mapfile)
+    {
+        stream *f = openrawfile(mapfile, "rb");
+        if(!f) fatal("could not open %s", mapfile);
+        printf("late join: map %s %d bytes\n", mapfile, int(f->size()));
+        delete f;
+    }
+    return EXIT_SUCCESS;
+}
@@ -51,7 +51,7 @@
         putint(q, ci->state.state);
         uint ip = extinfoip ? getclientip(ci->clientnum) : 0;
         q.put((uchar*)&ip, 3);
-        sendserverinforeply(q);
+        replyextinfo(q);
     }
 
     static inline void extinfoteamscore(ucharbuf &p, int team, int score)
@@ -110,7 +110,7 @@
                     if(!ci)
                     {
                         putint(p, EXT_ERROR); //client requested by id was not found
-                        sendserverinforeply(p);
+                        replyextinfo(p);
                         return;
                     }
                 }
@@ -121,7 +121,7 @@
                 putint(q, EXT_PLAYERSTATS_RESP_IDS); //send player ids following
                 if(ci) putint(q, ci->clientnum);
                 else loopv(clients) putint(q, clients[i]->clientnum);
-                sendserverinforeply(q);
+                replyextinfo(q);
 
                 if(ci) extinfoplayer(p, ci);
                 else loopv(clients) extinfoplayer(p, clients[i]);
@@ -140,6 +140,6 @@
                 break;
             }
         }
-        sendserverinforeply(p);
+        replyextinfo(p);
     }
 
@@ -215,18 +215,43 @@ namespace game
         }
     }
 
+    static bool simulating = false;
+    // client numbers of deaths the simulation ran into, carried out here since dying brings up the scoreboard
+    static vector<int> simsuicides;
+
     void updateworld()        // main game update loop
     {
+        PROFILE("world");
         if(!maptime) { maptime = lastmillis; maprealtime = totalmillis; return; }
-        if(!curtime) { gets2c(); if(player1->clientnum>=0) c2sinfo(); return; }
+        loopv(simsuicides)
+        {
+            gameent *d = getclient(simsuicides[i]);
+            if(d) suicide(d);
+        }
+        simsuicides.setsize(0);
+        // items run the map's teleport hooks, so they are picked up here rather than in simulateworld
+        if(connected && curtime && !intermission)
+        {
+            entities::checkitems(player1);
+            if(cmode) cmode->checkitems(player1);
+        }
+        gets2c();
+        if(player1->clientnum>=0) c2sinfo();   // sends what the last simulateworld produced
+    }
 
+    // may run on the simulation thread while the main thread presents the frame,
+    // so this must not touch gl, the ui, the script state or the network, such work is left to updateworld
+    void simulateworld()
+    {
+        if(!maptime || !curtime) return;
+        PROFILE("simulate");
+        simulating = true;
         physicsframe();
         ai::navigate();
         updateweapons(curtime);
         otherplayers(curtime);
         ai::update();
         moveragdolls();
-        gets2c();
         if(connected)
         {
             if(player1->state == CS_DEAD)
@@ -244,11 +269,9 @@ namespace game
                 if(!vr::isenabled()) crouchplayer(player1, 10, true);
                 moveplayer(player1, 10, true);
                 swayhudgun(curtime);
-                entities::checkitems(player1);
-                if(cmode) cmode->checkitems(player1);
             }
         }
-        if(player1->clientnum>=0) c2sinfo();   // do this last, to reduce the effective frame lag
+        simulating = false;
     }
 
     void spawnplayer(gameent *d)   // place at random spawn
@@ -660,6 +683,7 @@ namespace game
         {
             if(d->state!=CS_ALIVE) return;
             gameent *pl = (gameent *)d;
+            if(simulating) { if(simsuicides.find(pl->clientnum) < 0) simsuicides.add(pl->clientnum); return; }
             if(!m_mp(gamemode)) killed(pl, pl);
             else
             {
@@ -180,7 +180,7 @@ enum
     N_PING, N_PONG, N_CLIENTPING,
     N_TIMEUP, N_FORCEINTERMISSION,
     N_SERVMSG, N_ITEMLIST, N_RESUME,
-    N_EDITMODE, N_EDITENT, N_EDITF, N_EDITT, N_EDITM, N_FLIP, N_COPY, N_PASTE, N_ROTATE, N_REPLACE, N_DELCUBE, N_CALCLIGHT, N_REMIP, N_EDITVSLOT, N_UNDO, N_REDO, N_NEWMAP, N_GETMAP, N_SENDMAP, N_CLIPBOARD, N_EDITVAR,
+    N_EDITMODE, N_EDITENT, N_EDITF, N_EDITT, N_EDITM, N_FLIP, N_COPY, N_PASTE, N_ROTATE, N_REPLACE, N_DELCUBE, N_CALCLIGHT, N_REMIP, N_EDITVSLOT, N_UNDO, N_REDO, N_NEWMAP, N_GETMAP, N_SENDMAP, N_CLIPBOARD, N_EDITVAR, N_EDITBATCH, N_EDITLOG,
     N_MASTERMODE, N_KICK, N_CLEARBANS, N_CURRENTMASTER, N_SPECTATOR, N_SETMASTER, N_SETTEAM,
     N_LISTDEMOS, N_SENDDEMOLIST, N_GETDEMO, N_SENDDEMO,
     N_DEMOPLAYBACK, N_RECORDDEMO, N_STOPDEMO, N_CLEARDEMOS,
@@ -208,7 +208,7 @@ static const int msgsizes[] =               // size inclusive message token, 0 f
     N_PING, 2, N_PONG, 2, N_CLIENTPING, 2,
     N_TIMEUP, 2, N_FORCEINTERMISSION, 1,
     N_SERVMSG, 0, N_ITEMLIST, 0, N_RESUME, 0,
-    N_EDITMODE, 2, N_EDITENT, 11, N_EDITF, 16, N_EDITT, 16, N_EDITM, 16, N_FLIP, 14, N_COPY, 14, N_PASTE, 14, N_ROTATE, 15, N_REPLACE, 17, N_DELCUBE, 14, N_CALCLIGHT, 1, N_REMIP, 1, N_EDITVSLOT, 16, N_UNDO, 0, N_REDO, 0, N_NEWMAP, 2, N_GETMAP, 1, N_SENDMAP, 0, N_EDITVAR, 0, 
+    N_EDITMODE, 2, N_EDITENT, 11, N_EDITF, 16, N_EDITT, 16, N_EDITM, 16, N_FLIP, 14, N_COPY, 14, N_PASTE, 14, N_ROTATE, 15, N_REPLACE, 17, N_DELCUBE, 14, N_CALCLIGHT, 1, N_REMIP, 1, N_EDITVSLOT, 16, N_UNDO, 0, N_REDO, 0, N_NEWMAP, 2, N_GETMAP, 1, N_SENDMAP, 0, N_EDITVAR, 0, N_EDITBATCH, 0, N_EDITLOG, 0, 
     N_MASTERMODE, 2, N_KICK, 0, N_CLEARBANS, 1, N_CURRENTMASTER, 0, N_SPECTATOR, 3, N_SETMASTER, 0, N_SETTEAM, 0,
     N_LISTDEMOS, 1, N_SENDDEMOLIST, 0, N_GETDEMO, 2, N_SENDDEMO, 0,
     N_DEMOPLAYBACK, 3, N_RECORDDEMO, 2, N_STOPDEMO, 1, N_CLEARDEMOS, 2,
@@ -228,9 +228,10 @@ static const int msgsizes[] =               // size inclusive message token, 0 f
 #define TESSERACT_SERVER_PORT 42000
 #define TESSERACT_LANINFO_PORT 41998
 #define TESSERACT_MASTER_PORT 41999
-#define PROTOCOL_VERSION 2              // bump when protocol changes
+#define PROTOCOL_VERSION 3              // bump when protocol changes
 #define DEMO_VERSION 1                  // bump when demo format changes
 #define DEMO_MAGIC "TESSERACT_DEMO\0\0"
+#define DEMO_SEEKSPAN (256*1024)        // full flush interval so demos can be seeked cheaply
 
 struct demoheader
 {
@@ -238,6 +239,86 @@ struct demoheader
     int version, protocol;
 };
 
+// coop-edit traffic is coded with one raw deflate stream per sender that persists across ticks, so each
+// tick's batch of edits is compressed against the edits sent before it rather than against an empty window
+// every batch is sync-flushed and its trailing empty block stripped, so it decodes as soon as it arrives
+#define EDITBATCH_MIN 16                // smaller message blocks are sent as they are
+#define EDITBATCH_MAX (1<<20)           // largest uncompressed batch a receiver accepts
+#define EDITLOG_MAX (4*1024*1024)       // largest edit log kept for late joiners, like the map data cap
+
+enum { EDITBATCH_RESET = 1<<0 };
+
+struct editstream
+{
+    z_stream z;
+    bool active, compressing;
+
+    editstream() : active(false), compressing(false) {}
+    ~editstream() { reset(); }
+
+    void reset()
+    {
+        if(!active) return;
+        if(compressing) deflateEnd(&z);
+        else inflateEnd(&z);
+        active = false;
+    }
+
+    bool setup(bool compress)
+    {
+        reset();
+        memset(&z, 0, sizeof(z));
+        compressing = compress;
+        if(compress ? deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK : inflateInit2(&z, -MAX_WBITS) != Z_OK) return false;
+        active = true;
+        return true;
+    }
+
+    // appends the compressed batch to dst, returns EDITBATCH_* flags the receiver needs or -1 on failure
+    int compress(const uchar *src, int len, vector<uchar> &dst)
+    {
+        int flags = 0;
+        if(!active || !compressing)
+        {
+            if(!setup(true)) return -1;
+            flags |= EDITBATCH_RESET;
+        }
+        int start = dst.length();
+        z.next_in = (Bytef *)src;
+        z.avail_in = len;
+        do
+        {
+            databuf<uchar> buf = dst.reserve(len/2 + 64);
+            z.next_out = buf.buf;
+            z.avail_out = buf.maxlen;
+            int err = deflate(&z, Z_SYNC_FLUSH);
+            dst.advance(buf.maxlen - z.avail_out);
+            if(err != Z_OK && err != Z_BUF_ERROR) { reset(); return -1; }
+        } while(z.avail_in || !z.avail_out);
+        if(dst.length() - start >= 4) dst.setsize(dst.length() - 4);
+        return flags;
+    }
+
+    // inflates exactly len bytes into dst, giving up if the batch is corrupt or was coded against a window this stream never saw
+    bool decompress(int flags, const uchar *src, int srclen, uchar *dst, int len)
+    {
+        if(flags&EDITBATCH_RESET || !active || compressing) { if(!setup(false)) return false; }
+        static const uchar flush[4] = { 0, 0, 0xFF, 0xFF };
+        z.next_out = dst;
+        z.avail_out = len;
+        loopi(2)
+        {
+            z.next_in = (Bytef *)(i ? flush : src);
+            z.avail_in = i ? sizeof(flush) : srclen;
+            int err = inflate(&z, Z_SYNC_FLUSH);
+            if(err != Z_OK && err != Z_BUF_ERROR) { reset(); return false; }
+            if(z.avail_in) { reset(); return false; }
+        }
+        if(z.avail_out) { reset(); return false; }
+        return true;
+    }
+};
+
 #define MAXNAMELEN 15
 
 enum
@@ -364,6 +445,7 @@ struct gameent : dynent, gamestate
     int lastpickup, lastpickupmillis, flagpickup;
     int frags, flags, deaths, totaldamage, totalshots;
     editinfo *edit;
+    editstream editbatch;
     float deltayaw, deltapitch, deltaroll, newyaw, newpitch, newroll;
     int smoothmillis;
 
@@ -0,0 +1,120 @@
+// loadclient.h: protocol helpers shared by the headless load tools (tess_loadgen, tess_bothost)
+
+void vectoyawpitch(const vec &v, float &yaw, float &pitch)
+{
+    if(v.iszero()) yaw = pitch = 0;
+    else
+    {
+        yaw = -atan2(v.x, v.y)/RAD;
+        pitch = asin(v.z/v.magnitude())/RAD;
+    }
+}
+
+static void putconnect(packetbuf &p, const char *name)
+{
+    putint(p, N_CONNECT);
+    sendstring(name, p);
+    putint(p, 0);
+    putint(p, 0);
+    sendstring("", p);
+    sendstring("", p);
+    sendstring("", p);
+}
+
+// reads the rest of an N_SPAWNSTATE, returns whose spawn it is
+static int getspawnstate(ucharbuf &p, int &lifesequence)
+{
+    int cn = getint(p);
+    lifesequence = getint(p);
+    loopi(3 + NUMGUNS) getint(p);
+    return cn;
+}
+
+// reads an N_WELCOME up to the client's own spawn state, as laid out by server::welcomepacket
+// returns the spawn's life sequence, or -1 if the client was not spawned or something unexpected came first
+static int parsewelcome(ucharbuf &p, int cn, char *mapname)
+{
+    if(getint(p) != N_MAPCHANGE) return -1;
+    getstring(mapname, p, MAXSTRLEN);
+    getint(p);
+    getint(p);
+    while(!p.overread()) switch(getint(p))
+    {
+        case N_TIMEUP: getint(p); break;
+        case N_ITEMLIST: while(getint(p) >= 0 && !p.overread()) getint(p); break;
+        case N_CURRENTMASTER: getint(p); while(getint(p) >= 0 && !p.overread()) getint(p); break;
+        case N_PAUSEGAME: case N_GAMESPEED: loopi(2) getint(p); break;
+        case N_TEAMINFO: loopi(MAXTEAMS) getint(p); break;
+        case N_SETTEAM: loopi(3) getint(p); break;
+        case N_SPAWNSTATE:
+        {
+            int ls, scn = getspawnstate(p, ls);
+            return scn == cn && !p.overread() ? ls : -1;
+        }
+        default: return -1;
+    }
+    return -1;
+}
+
+// skips a message neither tool acts on, false if its layout isn't known here and the rest of the packet can't be read
+static bool skiploadmessage(int type, ucharbuf &p)
+{
+    switch(type)
+    {
+        case N_SHOTFX: loopi(9) getint(p); return true;
+        case N_EXPLODEFX: loopi(3) getint(p); return true;
+        case N_DAMAGE: case N_DIED: loopi(4) getint(p); return true;
+        case N_HITPUSH: loopi(6) getint(p); return true;
+        case N_ITEMACC: loopi(2) getint(p); return true;
+        case N_ITEMSPAWN: case N_CDIS: case N_TIMEUP: getint(p); return true;
+        case N_CLIENT:
+        {
+            getint(p);
+            int len = getuint(p);
+            p.subbuf(len);
+            return true;
+        }
+        default: return false;
+    }
+}
+
+static inline uint packdir(float yaw, float pitch)
+{
+    return (yaw < 0 ? 360 + int(yaw)%360 : int(yaw)%360) + clamp(int(pitch+90), 0, 180)*360;
+}
+
+// same encoding as game::sendposition, feet is the position of the player's feet
+static void putposition(packetbuf &p, int cn, int lifesequence, const vec &feet, float yaw, float pitch, const vec &vel)
+{
+    putint(p, N_POS);
+    putuint(p, cn);
+    p.put(PHYS_FLOOR | ((lifesequence&1)<<3));
+    ivec o = ivec(vec(feet).mul(DMF));
+    uint speed = min(int(vel.magnitude()*DVELF), 0xFFFF), movemag = vel.iszero() ? 0 : uint(DNF);
+    uint flags = 0;
+    loopk(3) if(o[k] < 0 || o[k] > 0xFFFF) flags |= 1<<k;
+    if(speed > 0xFF) flags |= 1<<3;
+    putuint(p, flags);
+    loopk(3)
+    {
+        p.put(o[k]&0xFF);
+        p.put((o[k]>>8)&0xFF);
+        if(o[k] < 0 || o[k] > 0xFFFF) p.put((o[k]>>16)&0xFF);
+    }
+    uint dir = packdir(yaw, pitch);
+    p.put(dir&0xFF);
+    p.put((dir>>8)&0xFF);
+    p.put(90);
+    p.put(movemag);
+    uint movedir = packdir(yaw, 0);
+    p.put(movedir&0xFF);
+    p.put((movedir>>8)&0xFF);
+    p.put(speed&0xFF);
+    if(speed > 0xFF) p.put((speed>>8)&0xFF);
+    float velyaw, velpitch;
+    vectoyawpitch(vel, velyaw, velpitch);
+    uint veldir = packdir(velyaw, velpitch);
+    p.put(veldir&0xFF);
+    p.put((veldir>>8)&0xFF);
+}
+
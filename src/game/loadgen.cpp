@@ -0,0 +1,363 @@
+// loadgen.cpp: floods a server with fake clients so its tick times can be measured under load
+// the server reports p50/p99 tick times in its status log line
+// with -m it instead floods a master server with concurrent list queries
+// with -i it floods a server with info pings (-e for extinfo player stats), set serverinforate 0 on the server to measure more than one address' share
+
+#include "game.h"
+#include "loadclient.h"
+
+struct loadclient
+{
+    ENetPeer *peer;
+    int clientnum, lifesequence;
+    bool connected, spawned;
+    float yaw;
+};
+
+static vector<loadclient> loadclients;
+static ENetHost *loadhost = NULL;
+static int numclients = 32, posrate = 30, duration = 60, sent = 0, received = 0;
+static uint sentbytes = 0, receivedbytes = 0;
+static string hostname = "localhost";
+static int port = -1;
+static bool masterflood = false, infoflood = false, extinfo = false;
+
+static void sendloadpacket(loadclient &c, int chan, packetbuf &p)
+{
+    ENetPacket *packet = p.finalize();
+    sentbytes += packet->dataLength;
+    sent++;
+    enet_peer_send(c.peer, chan, packet);
+    if(!packet->referenceCount) enet_packet_destroy(packet);
+}
+
+static void sendconnect(loadclient &c, int n)
+{
+    packetbuf p(MAXTRANS, ENET_PACKET_FLAG_RELIABLE);
+    defformatstring(name, "load%d", n);
+    putconnect(p, name);
+    sendloadpacket(c, 1, p);
+}
+
+static void sendspawn(loadclient &c)
+{
+    packetbuf p(MAXTRANS, ENET_PACKET_FLAG_RELIABLE);
+    putint(p, N_SPAWN);
+    putint(p, c.lifesequence);
+    putint(p, GUN_RAIL);
+    sendloadpacket(c, 1, p);
+    c.spawned = true;
+}
+
+static void sendposition(loadclient &c, int millis)
+{
+    // the client runs in a circle
+    c.yaw = fmod(c.yaw + 360.0f*posrate/1000.0f, 360.0f);
+    vec o(512 + 64*cosf(c.yaw*RAD), 512 + 64*sinf(c.yaw*RAD), 512), vel(-sinf(c.yaw*RAD), cosf(c.yaw*RAD), 0);
+    packetbuf p(64, 0);
+    putposition(p, c.clientnum, c.lifesequence, o, c.yaw + 90, 0, vel.mul(100));
+    sendloadpacket(c, 0, p);
+}
+
+static void sendping(loadclient &c, int millis)
+{
+    packetbuf p(16, ENET_PACKET_FLAG_RELIABLE);
+    putint(p, N_PING);
+    putint(p, millis);
+    sendloadpacket(c, 1, p);
+}
+
+static void parseloadpacket(loadclient &c, ENetPacket *packet, int chan)
+{
+    received++;
+    receivedbytes += packet->dataLength;
+    if(chan != 1) return;
+    // only spawn states matter here, but messages have to be read in order to find them
+    ucharbuf p(packet->data, packet->dataLength);
+    while(p.remaining() > 0 && !p.overread())
+    {
+        int type = getint(p);
+        switch(type)
+        {
+            case N_SERVINFO:
+                c.clientnum = getint(p);
+                return;
+
+            case N_WELCOME:
+            {
+                string mname;
+                int ls = parsewelcome(p, c.clientnum, mname);
+                if(ls >= 0) { c.lifesequence = ls; sendspawn(c); }
+                return;
+            }
+
+            case N_MAPCHANGE:
+            {
+                string mname;
+                getstring(mname, p);
+                getint(p);
+                getint(p);
+                break;
+            }
+
+            case N_SPAWNSTATE:
+            {
+                int ls, cn = getspawnstate(p, ls);
+                if(cn == c.clientnum) { c.lifesequence = ls; sendspawn(c); }
+                break;
+            }
+
+            default:
+                if(!skiploadmessage(type, p)) return;
+                break;
+        }
+    }
+}
+
+static bool loadoption(const char *opt)
+{
+    if(opt[0] != '-') return false;
+    switch(opt[1])
+    {
+        case 'h': copystring(hostname, opt+2); return true;
+        case 'p': port = atoi(opt+2); return true;
+        case 'c': numclients = clamp(atoi(opt+2), 1, MAXCLIENTS); return true;
+        case 'r': posrate = clamp(atoi(opt+2), 1, 1000); return true;
+        case 't': duration = max(atoi(opt+2), 1); return true;
+        case 'm': masterflood = true; return true;
+        case 'i': infoflood = true; return true;
+        case 'e': infoflood = extinfo = true; return true;
+        default: return false;
+    }
+}
+
+struct listquery
+{
+    ENetSocket sock;
+    enet_uint32 starttime;
+};
+
+static void floodmaster(ENetAddress &address)
+{
+    vector<listquery> queries;
+    int completed = 0, failed = 0, maxlatency = 0;
+    uint totallatency = 0, listbytes = 0;
+    enet_uint32 laststatus = 0;
+    static char buf[4096];
+    printf("flooding master %s:%d with %d concurrent list queries for %d seconds\n", hostname, port, numclients, duration);
+    for(;;)
+    {
+        enet_uint32 millis = enet_time_get();
+        if(millis >= enet_uint32(duration*1000)) break;
+        while(queries.length() < numclients)
+        {
+            ENetSocket sock = enet_socket_create(ENET_SOCKET_TYPE_STREAM);
+            if(sock == ENET_SOCKET_NULL || enet_socket_connect(sock, &address) < 0)
+            {
+                if(sock != ENET_SOCKET_NULL) enet_socket_destroy(sock);
+                failed++;
+                break;
+            }
+            ENetBuffer req;
+            req.data = (void *)"list\n";
+            req.dataLength = 5;
+            if(enet_socket_send(sock, NULL, &req, 1) < 0) { enet_socket_destroy(sock); failed++; break; }
+            listquery &q = queries.add();
+            q.sock = sock;
+            q.starttime = millis;
+        }
+        if(millis - laststatus >= 5000)
+        {
+            float secs = max(int(millis - laststatus), 1)/1000.0f;
+            printf("%.1f lists/sec (%.0f/min), %.2f ms avg latency, %d ms max, %d failed, %.1f K/sec\n", completed/secs, completed*60/secs, completed ? totallatency/float(completed) : 0.0f, maxlatency, failed, listbytes/1024.0f/secs);
+            laststatus = millis;
+            completed = failed = maxlatency = 0;
+            totallatency = listbytes = 0;
+        }
+
+        ENetSocketSet readset;
+        ENetSocket maxsock = 0;
+        ENET_SOCKETSET_EMPTY(readset);
+        loopv(queries) { ENET_SOCKETSET_ADD(readset, queries[i].sock); maxsock = max(maxsock, queries[i].sock); }
+        if(queries.empty() || enet_socketset_select(maxsock, &readset, NULL, 100) <= 0) continue;
+        millis = enet_time_get();
+        loopvrev(queries) if(ENET_SOCKETSET_CHECK(readset, queries[i].sock))
+        {
+            listquery &q = queries[i];
+            ENetBuffer in;
+            in.data = buf;
+            in.dataLength = sizeof(buf);
+            int res = enet_socket_receive(q.sock, NULL, &in, 1);
+            if(res > 0) { listbytes += res; continue; }
+            if(!res)
+            {
+                int latency = int(millis - q.starttime);
+                completed++;
+                totallatency += latency;
+                maxlatency = max(maxlatency, latency);
+            }
+            else failed++;
+            enet_socket_destroy(q.sock);
+            queries.removeunordered(i);
+        }
+    }
+    loopv(queries) enet_socket_destroy(queries[i].sock);
+}
+
+static void floodinfo(ENetAddress &address)
+{
+    ENetSocket sock = enet_socket_create(ENET_SOCKET_TYPE_DATAGRAM);
+    if(sock == ENET_SOCKET_NULL) { printf("could not create ping socket\n"); return; }
+    enet_socket_set_option(sock, ENET_SOCKOPT_NONBLOCK, 1);
+    // keeps a window of requests in flight, which is refilled when replies arrive or the window times out
+    int inflight = 0, replies = 0, requests = 0;
+    uint replybytes = 0;
+    enet_uint32 laststatus = 0, lastreply = 0;
+    static uchar buf[MAXTRANS];
+    printf("flooding %s:%d with %s pings, %d in flight, for %d seconds\n", hostname, port, extinfo ? "extinfo" : "info", numclients, duration);
+    for(;;)
+    {
+        enet_uint32 millis = enet_time_get();
+        if(millis >= enet_uint32(duration*1000)) break;
+        if(inflight > 0 && millis - lastreply >= 100) inflight = 0;
+        while(inflight < numclients)
+        {
+            uchar ping[16];
+            ucharbuf p(ping, sizeof(ping));
+            p.put(0xFF); p.put(0xFF);
+            if(extinfo)
+            {
+                putint(p, 0);
+                putint(p, 1); // EXT_PLAYERSTATS
+                putint(p, -1);
+            }
+            else putint(p, millis+1);
+            ENetBuffer req;
+            req.data = ping;
+            req.dataLength = p.length();
+            if(enet_socket_send(sock, &address, &req, 1) <= 0) break;
+            if(!inflight) lastreply = millis;
+            inflight++;
+            requests++;
+        }
+        if(millis - laststatus >= 5000)
+        {
+            float secs = max(int(millis - laststatus), 1)/1000.0f;
+            printf("%.0f requests/sec, %.0f replies/sec, %.1f K/sec\n", requests/secs, replies/secs, replybytes/1024.0f/secs);
+            laststatus = millis;
+            requests = replies = 0;
+            replybytes = 0;
+        }
+        enet_uint32 events = ENET_SOCKET_WAIT_RECEIVE;
+        if(enet_socket_wait(sock, &events, 10) < 0 || !events) continue;
+        for(;;)
+        {
+            ENetAddress from;
+            ENetBuffer in;
+            in.data = buf;
+            in.dataLength = sizeof(buf);
+            int len = enet_socket_receive(sock, &from, &in, 1);
+            if(len <= 0) break;
+            replies++;
+            replybytes += len;
+            inflight = max(inflight-1, 0);
+            lastreply = enet_time_get();
+        }
+    }
+    enet_socket_destroy(sock);
+}
+
+int main(int argc, char **argv)
+{
+    for(int i = 1; i < argc; i++) if(!loadoption(argv[i]))
+    {
+        printf("usage: tess_loadgen [-m|-i|-e] [-hHOST] [-pPORT] [-cCLIENTS] [-rPOSRATE] [-tSECONDS]\n");
+        return EXIT_FAILURE;
+    }
+    if(enet_initialize() < 0) { printf("unable to initialise network module\n"); return EXIT_FAILURE; }
+    atexit(enet_deinitialize);
+    enet_time_set(0);
+
+    ENetAddress address;
+    if(enet_address_set_host(&address, hostname) < 0) { printf("could not resolve %s\n", hostname); return EXIT_FAILURE; }
+    if(port < 0) port = masterflood ? TESSERACT_MASTER_PORT : TESSERACT_SERVER_PORT;
+    address.port = port;
+    if(masterflood)
+    {
+        floodmaster(address);
+        return EXIT_SUCCESS;
+    }
+    if(infoflood)
+    {
+        floodinfo(address);
+        return EXIT_SUCCESS;
+    }
+    loadhost = enet_host_create(NULL, numclients, 3, 0, 0);
+    if(!loadhost) { printf("could not create client host\n"); return EXIT_FAILURE; }
+    loopi(numclients)
+    {
+        loadclient &c = loadclients.add();
+        c.peer = enet_host_connect(loadhost, &address, 3, 0);
+        c.peer->data = (void *)(intptr_t)i;
+        c.clientnum = -1;
+        c.lifesequence = 0;
+        c.connected = c.spawned = false;
+        c.yaw = i*360.0f/numclients;
+    }
+
+    printf("flooding %s:%d with %d clients at %d positions/sec for %d seconds\n", hostname, port, numclients, posrate, duration);
+    int lastpos = 0, lastping = 0, laststatus = 0;
+    for(;;)
+    {
+        int millis = int(enet_time_get());
+        if(millis >= duration*1000) break;
+        if(millis - lastpos >= 1000/posrate)
+        {
+            lastpos = millis;
+            loopv(loadclients) if(loadclients[i].connected && loadclients[i].clientnum >= 0) sendposition(loadclients[i], millis);
+        }
+        if(millis - lastping >= 1000)
+        {
+            lastping = millis;
+            loopv(loadclients) if(loadclients[i].connected) sendping(loadclients[i], millis);
+        }
+        if(millis - laststatus >= 5000)
+        {
+            int connected = 0, spawned = 0;
+            loopv(loadclients) { if(loadclients[i].connected) connected++; if(loadclients[i].spawned) spawned++; }
+            printf("%d connected, %d spawned, %d sent (%.1f K/sec), %d received (%.1f K/sec)\n", connected, spawned, sent, sentbytes/1024.0f/max(millis - laststatus, 1)*1000, received, receivedbytes/1024.0f/max(millis - laststatus, 1)*1000);
+            laststatus = millis;
+            sent = received = 0;
+            sentbytes = receivedbytes = 0;
+        }
+
+        ENetEvent event;
+        while(enet_host_service(loadhost, &event, 1) > 0)
+        {
+            loadclient &c = loadclients[(intptr_t)event.peer->data];
+            switch(event.type)
+            {
+                case ENET_EVENT_TYPE_CONNECT:
+                    c.connected = true;
+                    sendconnect(c, int((intptr_t)event.peer->data));
+                    break;
+                case ENET_EVENT_TYPE_RECEIVE:
+                    parseloadpacket(c, event.packet, event.channelID);
+                    enet_packet_destroy(event.packet);
+                    break;
+                case ENET_EVENT_TYPE_DISCONNECT:
+                    printf("client %d disconnected (%s)\n", int((intptr_t)event.peer->data), c.connected ? "dropped" : "could not connect");
+                    c.connected = false;
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    loopv(loadclients) if(loadclients[i].connected) enet_peer_disconnect(loadclients[i].peer, DISC_NONE);
+    enet_host_flush(loadhost);
+    enet_host_destroy(loadhost);
+    return EXIT_SUCCESS;
+}
+
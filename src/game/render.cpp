@@ -34,6 +34,7 @@ namespace game
 
     void moveragdolls()
     {
+        PROFILE("physics");
         loopv(ragdolls)
         {
             gameent *d = ragdolls[i];
@@ -215,6 +215,7 @@ namespace server
         servstate state;
         vector<gameevent *> events;
         vector<uchar> position, messages;
+        editstream editin, editout;
         uchar *wsdata;
         int wslen;
         vector<clientinfo *> bots;
@@ -391,6 +392,22 @@ namespace server
     enet_uint32 lastsend = 0;
     int mastermode = MM_OPEN, mastermask = MM_PRIVSERV;
     stream *mapdata = NULL;
+    int serverinfomillis = -1;
+
+    // coop edits made since the map was loaded, so a client still holding the base map can replay them instead of downloading the map
+    enum { EDITLOG_WAIT = 0, EDITLOG_ACTIVE, EDITLOG_INVALID };
+    vector<uchar> editlog, editlogzip; // editlogzip caches the compressed log until it changes
+    int editlogcrc = 0, editlogstate = EDITLOG_WAIT;
+    stream *editrecord = NULL;
+
+    void resetedits(int state = EDITLOG_WAIT)
+    {
+        editlog.setsize(0);
+        editlogzip.setsize(0);
+        editlogstate = state;
+    }
+
+    void serverinfochanged() { serverinfomillis = -1; }
 
     vector<uint> allowedips;
     vector<ban> bannedips;
@@ -996,6 +1013,8 @@ namespace server
     {
         if(!demorecord) return;
 
+        flushbroadcasts();
+
         DELETEP(demorecord);
 
         if(!demotmp) return;
@@ -1030,7 +1049,7 @@ namespace server
         demotmp = opentempfile("demorecord", "w+b");
         if(!demotmp) return;
 
-        stream *f = opengzfile(NULL, "wb", demotmp);
+        stream *f = opengzfile(NULL, "wb", demotmp, Z_BEST_COMPRESSION, DEMO_SEEKSPAN);
         if(!f) { DELETEP(demotmp); return; }
 
         sendservmsg("recording demo");
@@ -1196,6 +1215,7 @@ namespace server
     {
         if(gamepaused==val) return;
         gamepaused = val;
+        serverinfochanged();
         sendf(-1, 1, "riii", N_PAUSEGAME, gamepaused ? 1 : 0, ci ? ci->clientnum : -1);
     }
 
@@ -1219,6 +1239,7 @@ namespace server
         val = clamp(val, 10, 1000);
         if(gamespeed==val) return;
         gamespeed = val;
+        serverinfochanged();
         sendf(-1, 1, "riii", N_GAMESPEED, gamespeed, ci ? ci->clientnum : -1);
     }
 
@@ -1342,6 +1363,7 @@ namespace server
         {
             mastermode = MM_OPEN;
             allowedips.shrink(0);
+            serverinfochanged();
         }
         string msg;
         if(val && authname)
@@ -1452,7 +1474,7 @@ namespace server
         }
 
         uchar operator[](int msg) const { return msg >= 0 && msg < NUMMSG ? msgmask[msg] : 0; }
-    } msgfilter(-1, N_CONNECT, N_SERVINFO, N_INITCLIENT, N_WELCOME, N_MAPCHANGE, N_SERVMSG, N_DAMAGE, N_HITPUSH, N_SHOTFX, N_EXPLODEFX, N_DIED, N_SPAWNSTATE, N_FORCEDEATH, N_TEAMINFO, N_ITEMACC, N_ITEMSPAWN, N_TIMEUP, N_CDIS, N_CURRENTMASTER, N_PONG, N_RESUME, N_SENDDEMOLIST, N_SENDDEMO, N_DEMOPLAYBACK, N_SENDMAP, N_DROPFLAG, N_SCOREFLAG, N_RETURNFLAG, N_RESETFLAG, N_CLIENT, N_AUTHCHAL, N_INITAI, N_DEMOPACKET, -2, N_CALCLIGHT, N_REMIP, N_NEWMAP, N_GETMAP, N_SENDMAP, N_CLIPBOARD, -3, N_EDITENT, N_EDITF, N_EDITT, N_EDITM, N_FLIP, N_COPY, N_PASTE, N_ROTATE, N_REPLACE, N_DELCUBE, N_EDITVAR, N_EDITVSLOT, N_UNDO, N_REDO, -4, N_POS, NUMMSG),
+    } msgfilter(-1, N_CONNECT, N_SERVINFO, N_INITCLIENT, N_WELCOME, N_MAPCHANGE, N_SERVMSG, N_DAMAGE, N_HITPUSH, N_SHOTFX, N_EXPLODEFX, N_DIED, N_SPAWNSTATE, N_FORCEDEATH, N_TEAMINFO, N_ITEMACC, N_ITEMSPAWN, N_TIMEUP, N_CDIS, N_CURRENTMASTER, N_PONG, N_RESUME, N_SENDDEMOLIST, N_SENDDEMO, N_DEMOPLAYBACK, N_SENDMAP, N_DROPFLAG, N_SCOREFLAG, N_RETURNFLAG, N_RESETFLAG, N_CLIENT, N_AUTHCHAL, N_INITAI, N_DEMOPACKET, N_EDITLOG, -2, N_CALCLIGHT, N_REMIP, N_NEWMAP, N_GETMAP, N_SENDMAP, N_CLIPBOARD, -3, N_EDITENT, N_EDITF, N_EDITT, N_EDITM, N_FLIP, N_COPY, N_PASTE, N_ROTATE, N_REPLACE, N_DELCUBE, N_EDITVAR, N_EDITVSLOT, N_UNDO, N_REDO, N_EDITBATCH, -4, N_POS, NUMMSG),
       connectfilter(-1, N_CONNECT, -2, N_AUTHANS, -3, N_PING, NUMMSG);
 
     int checktype(int type, clientinfo *ci)
@@ -1498,9 +1520,19 @@ namespace server
         void cleanup() { DELETEA(data); len = 0; }
         bool contains(const uchar *p) const { return p >= data && p < &data[len]; }
     };
-    vector<worldstate> worldstates;
+    vector<worldstate> worldstates, spareworldstates;
     bool reliablemessages = false;
 
+    // released buffers are kept for the next ticks, so steady play does not allocate a new worldstate each time
+    #define MAXSPAREWORLDSTATES 4
+
+    static void releaseworldstate(worldstate &ws)
+    {
+        ws.uses = 0;
+        if(spareworldstates.length() < MAXSPAREWORLDSTATES) spareworldstates.add(ws);
+        else ws.cleanup();
+    }
+
     void cleanworldstate(ENetPacket *packet)
     {
         loopv(worldstates)
@@ -1510,13 +1542,99 @@ namespace server
             ws.uses--;
             if(ws.uses <= 0)
             {
-                ws.cleanup();
+                releaseworldstate(ws);
                 worldstates.removeunordered(i);
             }
             break;
         }
     }
 
+    // broadcasts from sendf ride along with the next worldstate instead of each becoming a packet of its own
+    vector<uchar> broadcasts;
+    bool reliablebroadcasts = false;
+
+    // a broadcast that leaves out one client stays in order in everyone's stream, only that client's copy skips it
+    struct broadcastskip
+    {
+        int offset, len, exclude;
+    };
+    vector<broadcastskip> broadcastskips;
+    int broadcastpos = -1; // where the queued broadcasts start in the worldstate messages being built
+
+    bool queuebroadcast(int chan, const uchar *data, int len, int exclude, bool reliable)
+    {
+        if(chan != 1 || clients.empty() || (!hasnonlocalclients() && !demorecord)) return false;
+        if(exclude >= 0)
+        {
+            if(broadcastskips.length() && broadcastskips.last().exclude == exclude && broadcastskips.last().offset + broadcastskips.last().len == broadcasts.length())
+                broadcastskips.last().len += len;
+            else
+            {
+                broadcastskip &s = broadcastskips.add();
+                s.offset = broadcasts.length();
+                s.len = len;
+                s.exclude = exclude;
+            }
+        }
+        broadcasts.put(data, len);
+        if(reliable) reliablebroadcasts = true;
+        return true;
+    }
+
+    static bool skipsbroadcasts(clientinfo &ci)
+    {
+        loopv(broadcastskips) if(broadcastskips[i].exclude == ci.clientnum) return true;
+        return false;
+    }
+
+    // copies the client's part of a stream minus the broadcasts it is excluded from, which start at bcast
+    // the stream may repeat past wrap bytes, so a skip that lies before the client's part is found one wrap later
+    static void sendskipped(clientinfo &ci, const uchar *data, int size, const uchar *bcast, int wrap, int flags)
+    {
+        ENetPacket *packet = enet_packet_create(NULL, size, flags);
+        uchar *dst = packet->data;
+        const uchar *src = data;
+        loopk(2) loopv(broadcastskips)
+        {
+            broadcastskip &s = broadcastskips[i];
+            if(s.exclude != ci.clientnum) continue;
+            const uchar *skip = bcast + s.offset;
+            if(skip < data) { if(!k) continue; skip += wrap; }
+            else if(k) continue;
+            memcpy(dst, src, skip - src);
+            dst += skip - src;
+            src = skip + s.len;
+        }
+        memcpy(dst, src, data + size - src);
+        dst += data + size - src;
+        enet_packet_resize(packet, dst - packet->data);
+        sendpacket(ci.clientnum, 1, packet);
+        if(!packet->referenceCount) enet_packet_destroy(packet);
+    }
+
+    // sends queued broadcasts right away, so a reliable packet sent directly can't overtake them
+    void flushbroadcasts()
+    {
+        if(broadcasts.empty()) return;
+        ENetPacket *packet = enet_packet_create(broadcasts.getbuf(), broadcasts.length(), reliablebroadcasts ? ENET_PACKET_FLAG_RELIABLE : 0);
+        broadcasts.setsize(0);
+        reliablebroadcasts = false;
+        if(broadcastskips.empty()) sendpacket(-1, 1, packet);
+        else
+        {
+            recordpacket(1, packet->data, packet->dataLength);
+            loopv(clients)
+            {
+                clientinfo &ci = *clients[i];
+                if(ci.state.aitype != AI_NONE || !ci.connected) continue;
+                if(skipsbroadcasts(ci)) sendskipped(ci, packet->data, packet->dataLength, packet->data, 0, packet->flags);
+                else sendpacket(ci.clientnum, 1, packet);
+            }
+            broadcastskips.setsize(0);
+        }
+        if(!packet->referenceCount) enet_packet_destroy(packet);
+    }
+
     void flushclientposition(clientinfo &ci)
     {
         if(ci.position.empty() || (!hasnonlocalclients() && !demorecord)) return;
@@ -1574,23 +1692,63 @@ namespace server
             int size = wslen;
             if(ci.wsdata >= wsbuf.buf) { data = ci.wsdata + ci.wslen; size -= ci.wslen; }
             if(size <= 0) continue;
+            if(broadcastpos >= 0 && skipsbroadcasts(ci))
+            {
+                sendskipped(ci, data, size, wsbuf.buf + broadcastpos, wslen, reliablemessages ? ENET_PACKET_FLAG_RELIABLE : 0);
+                continue;
+            }
             ENetPacket *packet = enet_packet_create(data, size, (reliablemessages ? ENET_PACKET_FLAG_RELIABLE : 0) | ENET_PACKET_FLAG_NO_ALLOCATE);
             sendpacket(ci.clientnum, 1, packet);
             if(packet->referenceCount) { ws.uses++; packet->freeCallback = cleanworldstate; }
             else enet_packet_destroy(packet);
         }
+        if(broadcastpos >= 0)
+        {
+            broadcastskips.setsize(0);
+            broadcastpos = -1;
+        }
         wsbuf.offset(wsbuf.length());
     }
 
+    // reliable coop-edit blocks go out through the sender's edit stream, which every other client decodes in order
+    static bool compressmessages(clientinfo &bi, vector<uchar> &batch)
+    {
+        if(!m_edit || !reliablemessages || demorecord || bi.messages.length() < EDITBATCH_MIN) return false;
+        static vector<uchar> data;
+        data.setsize(0);
+        int flags = bi.editout.compress(bi.messages.getbuf(), bi.messages.length(), data);
+        if(flags < 0) return false;
+        batch.setsize(0);
+        putint(batch, N_EDITBATCH);
+        putint(batch, flags);
+        putuint(batch, bi.messages.length());
+        putuint(batch, data.length());
+        batch.put(data.getbuf(), data.length());
+        return true;
+    }
+
+    static inline void addbroadcasts(worldstate &ws, ucharbuf &wsbuf, int mtu)
+    {
+        if(broadcasts.empty()) return;
+        if(wsbuf.length() + broadcasts.length() > mtu) sendmessages(ws, wsbuf);
+        broadcastpos = wsbuf.length();
+        wsbuf.put(broadcasts.getbuf(), broadcasts.length());
+        broadcasts.setsize(0);
+        if(reliablebroadcasts) reliablemessages = true;
+        reliablebroadcasts = false;
+    }
+
     static inline void addmessages(worldstate &ws, ucharbuf &wsbuf, int mtu, clientinfo &bi, clientinfo &ci)
     {
         if(bi.messages.empty()) return;
-        if(wsbuf.length() + 10 + bi.messages.length() > mtu) sendmessages(ws, wsbuf);
+        static vector<uchar> batch;
+        vector<uchar> &msgs = compressmessages(bi, batch) ? batch : bi.messages;
+        if(wsbuf.length() + 10 + msgs.length() > mtu) sendmessages(ws, wsbuf);
         int offset = wsbuf.length();
         putint(wsbuf, N_CLIENT);
         putint(wsbuf, bi.clientnum);
-        putuint(wsbuf, bi.messages.length());
-        wsbuf.put(bi.messages.getbuf(), bi.messages.length());
+        putuint(wsbuf, msgs.length());
+        wsbuf.put(msgs.getbuf(), msgs.length());
         bi.messages.setsize(0);
         int len = wsbuf.length() - offset;
         if(ci.wsdata < wsbuf.buf) { ci.wsdata = &wsbuf.buf[offset]; ci.wslen = len; }
@@ -1599,7 +1757,7 @@ namespace server
 
     bool buildworldstate()
     {
-        int wsmax = 0;
+        int wsmax = broadcasts.length();
         loopv(clients)
         {
             clientinfo &ci = *clients[i];
@@ -1614,7 +1772,12 @@ namespace server
             return false;
         }
         worldstate &ws = worldstates.add();
-        ws.setup(2*wsmax);
+        if(spareworldstates.length())
+        {
+            ws = spareworldstates.pop();
+            if(ws.len < 2*wsmax) { ws.cleanup(); ws.setup(2*wsmax); }
+        }
+        else ws.setup(2*wsmax);
         int mtu = getservermtu() - 100;
         if(mtu <= 0) mtu = ws.len;
         ucharbuf wsbuf(ws.data, ws.len);
@@ -1626,6 +1789,8 @@ namespace server
             loopvj(ci.bots) addposition(ws, wsbuf, mtu, *ci.bots[j], ci);
         }
         sendpositions(ws, wsbuf);
+        // queued broadcasts belong to no client's own messages, so every client gets them
+        addbroadcasts(ws, wsbuf, mtu);
         loopv(clients)
         {
             clientinfo &ci = *clients[i];
@@ -1636,14 +1801,15 @@ namespace server
         sendmessages(ws, wsbuf);
         reliablemessages = false;
         if(ws.uses) return true;
-        ws.cleanup();
+        releaseworldstate(ws);
         worldstates.drop();
         return false;
     }
 
     bool sendpackets(bool force)
     {
-        if(clients.empty() || (!hasnonlocalclients() && !demorecord)) return false;
+        PROFILE("worldstate");
+        if(clients.empty() || (!hasnonlocalclients() && !demorecord)) { flushbroadcasts(); return false; }
         enet_uint32 curtime = enet_time_get()-lastsend;
         if(curtime<40 && !force) return false;
         bool flush = buildworldstate();
@@ -1896,6 +2062,7 @@ namespace server
         changegamespeed(100);
         if(smode) smode->cleanup();
         aiman::clearai();
+        serverinfochanged();
 
         gamemode = mode;
         gamemillis = 0;
@@ -1903,6 +2070,7 @@ namespace server
         interm = 0;
         nextexceeded = 0;
         copystring(smapname, s);
+        resetedits();
         loaditems();
         scores.shrink(0);
         shouldcheckteamkills = false;
@@ -2242,6 +2410,7 @@ namespace server
 
     void processevents()
     {
+        PROFILE("events");
         loopv(clients)
         {
             clientinfo *ci = clients[i];
@@ -2477,6 +2646,7 @@ namespace server
             sendf(-1, 1, "ri2", N_CDIS, n);
             clients.removeobj(ci);
             aiman::removeai(ci);
+            serverinfochanged();
             if(!numclients(-1, false, true)) noclients(); // bans clear when server empties
             if(ci->local) checkpausegame();
         }
@@ -2697,9 +2867,70 @@ namespace server
         mapdata = opentempfile("mapdata", "w+b");
         if(!mapdata) { sendf(sender, 1, "ris", N_SERVMSG, "failed to open temporary file for map"); return; }
         mapdata->write(data, len);
+        // the log's edits were made against the map this one replaces
+        resetedits(EDITLOG_INVALID);
         sendservmsgf("[%s sent a map to server, \"/getmap\" to receive it]", colorname(ci));
     }
 
+    // cn is the editor for relayed messages, or -1 for packets that carry their own client number
+    void logedit(int cn, const uchar *msg, int len)
+    {
+        if(editrecord)
+        {
+            vector<uchar> frame;
+            putint(frame, totalmillis);
+            putint(frame, cn);
+            putuint(frame, len);
+            frame.put(msg, len);
+            editrecord->write(frame.getbuf(), frame.length());
+        }
+        switch(editlogstate)
+        {
+            case EDITLOG_WAIT: resetedits(EDITLOG_INVALID); return;
+            case EDITLOG_INVALID: return;
+        }
+        putint(editlog, cn);
+        putuint(editlog, len);
+        editlog.put(msg, len);
+        editlogzip.setsize(0);
+        if(editlog.length() > EDITLOG_MAX) resetedits(EDITLOG_INVALID);
+    }
+
+    ICOMMAND(recordedits, "s", (char *name),
+    {
+        DELETEP(editrecord);
+        if(name[0] && !(editrecord = openrawfile(path(name, true), "wb"))) conoutf(CON_ERROR, "could not open edit recording %s", name);
+    });
+
+    bool canreplayedits(clientinfo *ci)
+    {
+        return editlogstate == EDITLOG_ACTIVE && editlog.length() && ci->clientmap[0] && ci->mapcrc == editlogcrc;
+    }
+
+    ENetPacket *sendedits(clientinfo *ci)
+    {
+        if(!canreplayedits(ci)) return NULL;
+        if(editlogzip.empty())
+        {
+            uLongf len = compressBound(editlog.length());
+            editlogzip.reserve(len);
+            if(compress2(editlogzip.getbuf(), &len, editlog.getbuf(), editlog.length(), Z_DEFAULT_COMPRESSION) != Z_OK) return NULL;
+            editlogzip.advance(len);
+        }
+        int len = editlogzip.length();
+        // the map itself may still be the cheaper download after long sessions
+        if(mapdata && stream::offset(len) >= mapdata->size()) return NULL;
+        packetbuf p(MAXTRANS + len, ENET_PACKET_FLAG_RELIABLE);
+        putint(p, N_EDITLOG);
+        putint(p, editlogcrc);
+        putuint(p, editlog.length());
+        putuint(p, len);
+        p.put(editlogzip.getbuf(), len);
+        ENetPacket *packet = p.finalize();
+        sendpacket(ci->clientnum, 2, packet);
+        return packet->referenceCount > 0 ? packet : NULL;
+    }
+
     void sendclipboard(clientinfo *ci)
     {
         if(!ci->lastclipboard || !ci->clipboard) return;
@@ -2723,8 +2954,19 @@ namespace server
 
         shouldstep = true;
 
+        // whatever was queued before the new client joined must not reach it ahead of its welcome
+        flushbroadcasts();
+
         connects.removeobj(ci);
         clients.add(ci);
+        serverinfochanged();
+
+        // the new client has none of the edit history the relay streams were built on
+        loopv(clients)
+        {
+            clients[i]->editout.reset();
+            loopvj(clients[i]->bots) clients[i]->bots[j]->editout.reset();
+        }
 
         ci->connectauth = 0;
         ci->connected = true;
@@ -2824,6 +3066,7 @@ namespace server
                 { body; } \
             } \
         }
+        #define QUEUE_EDIT { logedit(ci->clientnum, &p.buf[curmsg], p.length() - curmsg); QUEUE_MSG; }
         #define QUEUE_INT(n) QUEUE_BUF(putint(cm->messages, n))
         #define QUEUE_UINT(n) QUEUE_BUF(putuint(cm->messages, n))
         #define QUEUE_STR(text) QUEUE_BUF(sendstring(text, cm->messages))
@@ -2843,7 +3086,7 @@ namespace server
                     int n = p.get(); n |= p.get()<<8; if(flags&(1<<k)) { n |= p.get()<<16; if(n&0x800000) n |= ~0U<<24; }
                     pos[k] = n/DMF;
                 }
-                loopk(8) p.get();
+                loopk(6) p.get();
                 if(flags&(1<<9)) p.get();
                 int mag = p.get(); if(flags&(1<<3)) mag |= p.get()<<8;
                 int dir = p.get(); dir |= p.get()<<8;
@@ -2947,6 +3190,7 @@ namespace server
                 }
                 copystring(ci->clientmap, text);
                 ci->mapcrc = text[0] ? crc : 1;
+                if(m_edit && text[0] && editlogstate == EDITLOG_WAIT) { editlogcrc = crc; editlogstate = EDITLOG_ACTIVE; }
                 checkmaps();
                 if(cq && cq != ci && cq->ownernum != ci->clientnum) cq = NULL;
                 break;
@@ -3167,7 +3411,7 @@ namespace server
                 int type = getint(p);
                 loopk(5) getint(p);
                 if(!ci || ci->state.state==CS_SPECTATOR) break;
-                QUEUE_MSG;
+                QUEUE_EDIT;
                 bool canspawn = canspawnitem(type);
                 if(i<MAXENTS && (sents.inrange(i) || canspawnitem(type)))
                 {
@@ -3193,7 +3437,7 @@ namespace server
                     case ID_FVAR: getfloat(p); break;
                     case ID_SVAR: getstring(text, p);
                 }
-                if(ci && ci->state.state!=CS_SPECTATOR) QUEUE_MSG;
+                if(ci && ci->state.state!=CS_SPECTATOR) QUEUE_EDIT;
                 break;
             }
 
@@ -3222,6 +3466,7 @@ namespace server
                     {
                         mastermode = mm;
                         allowedips.shrink(0);
+                        serverinfochanged();
                         if(mm>=MM_PRIVATE)
                         {
                             loopv(clients) allowedips.add(getclientip(clients[i]->clientnum));
@@ -3333,12 +3578,12 @@ namespace server
             }
 
             case N_GETMAP:
-                if(!mapdata) sendf(sender, 1, "ris", N_SERVMSG, "no map to send");
+                if(!mapdata && !canreplayedits(ci)) sendf(sender, 1, "ris", N_SERVMSG, "no map to send");
                 else if(ci->getmap) sendf(sender, 1, "ris", N_SERVMSG, "already sending map");
                 else
                 {
                     sendservmsgf("[%s is getting the map]", colorname(ci));
-                    if((ci->getmap = sendfile(sender, 2, mapdata, "ri", N_SENDMAP)))
+                    if((ci->getmap = sendedits(ci)) || (mapdata && (ci->getmap = sendfile(sender, 2, mapdata, "ri", N_SENDMAP))))
                         ci->getmap->freeCallback = freegetmap;
                     ci->needclipboard = totalmillis ? totalmillis : 1;
                 }
@@ -3348,6 +3593,7 @@ namespace server
             {
                 int size = getint(p);
                 if(!ci->privilege && !ci->local && ci->state.state==CS_SPECTATOR) break;
+                resetedits(EDITLOG_INVALID);
                 if(size>=0)
                 {
                     smapname[0] = '\0';
@@ -3490,6 +3736,7 @@ namespace server
                 if(packlen > 0) p.get(q.subbuf(packlen).buf, packlen);
                 ci->clipboard = q.finalize();
                 ci->clipboard->referenceCount++;
+                logedit(-1, ci->clipboard->data, ci->clipboard->dataLength);
                 break;
             }
 
@@ -3504,10 +3751,25 @@ namespace server
                 int extra = lilswap(*(const ushort *)p.pad(2));
                 if(p.remaining() < extra) { disconnect_client(sender, DISC_MSGERR); return; }                
                 p.pad(extra); 
-                if(ci && ci->state.state!=CS_SPECTATOR) QUEUE_MSG;
+                if(ci && ci->state.state!=CS_SPECTATOR) QUEUE_EDIT;
                 break;
             }
   
+            case N_EDITBATCH:
+            {
+                static bool inbatch = false;
+                int flags = getint(p), rawlen = getuint(p), packlen = getuint(p);
+                if(inbatch || rawlen <= 0 || rawlen > EDITBATCH_MAX || packlen < 0 || p.remaining() < packlen) { disconnect_client(sender, DISC_MSGERR); return; }
+                ucharbuf b = p.subbuf(packlen);
+                packetbuf q(rawlen, p.packet->flags&ENET_PACKET_FLAG_RELIABLE);
+                if(!ci->editin.decompress(flags, b.buf, b.maxlen, q.buf, rawlen)) { disconnect_client(sender, DISC_MSGERR); return; }
+                inbatch = true;
+                parsepacket(sender, chan, q);
+                inbatch = false;
+                if(getinfo(sender) != ci) return;
+                break;
+            }
+
             case N_UNDO:
             case N_REDO:
             {
@@ -3524,7 +3786,9 @@ namespace server
                 putint(q, unpacklen);
                 putint(q, packlen);
                 if(packlen > 0) p.get(q.subbuf(packlen).buf, packlen);
-                sendpacket(-1, 1, q.finalize(), ci->clientnum);
+                ENetPacket *packet = q.finalize();
+                logedit(-1, packet->data, packet->dataLength);
+                sendpacket(-1, 1, packet, ci->clientnum);
                 break;
             }
  
@@ -3551,7 +3815,11 @@ namespace server
                 loopi(size-1) getint(p);
                 if(ci) switch(msgfilter[type])
                 {
-                    case 2: case 3: if(ci->state.state != CS_SPECTATOR) QUEUE_MSG; break;
+                    case 2: case 3:
+                        if(ci->state.state == CS_SPECTATOR) break;
+                        if(type != N_CALCLIGHT) logedit(ci->clientnum, &p.buf[curmsg], p.length() - curmsg);
+                        QUEUE_MSG;
+                        break;
                     default: if(cq && (ci != cq || ci->state.state!=CS_SPECTATOR)) { QUEUE_AI; QUEUE_MSG; } break;
                 }
                 break;
@@ -3565,30 +3833,98 @@ namespace server
     int masterport() { return TESSERACT_MASTER_PORT; }
     int numchannels() { return 3; }
 
+    // info replies are built at most once per server tick, so a burst of pings from a server browser sweep
+    // only costs a copy and a send each; ext replies are cached per distinct request
+    #define MAXEXTINFOCACHES 32
+
+    struct extinfocache
+    {
+        vector<uchar> req, replies;
+    };
+
+    vector<uchar> serverinfocache;
+    vector<extinfocache> extinfocaches;
+    vector<uchar> *extinfocapture = NULL;
+
+    void checkserverinfocache()
+    {
+        if(serverinfomillis == totalmillis) return;
+        serverinfomillis = totalmillis;
+        serverinfocache.setsize(0);
+        extinfocaches.shrink(0);
+    }
+
+    void replyextinfo(ucharbuf &p)
+    {
+        if(extinfocapture)
+        {
+            putint(*extinfocapture, p.length());
+            extinfocapture->put(p.buf, p.length());
+        }
+        sendserverinforeply(p);
+    }
+
     #include "extinfo.h"
 
+    void cachedextinforeply(ucharbuf &req, ucharbuf &p)
+    {
+        checkserverinfocache();
+        // the reply starts out as a copy of the request, so replies to an identical request are identical
+        loopv(extinfocaches)
+        {
+            extinfocache &c = extinfocaches[i];
+            if(c.req.length() != p.length() || memcmp(c.req.getbuf(), p.buf, p.length())) continue;
+            ucharbuf r(c.replies.getbuf(), c.replies.length());
+            while(r.remaining())
+            {
+                int len = getint(r);
+                ucharbuf q(&r.buf[r.len], len);
+                q.len = len;
+                sendserverinforeply(q);
+                r.len += len;
+            }
+            return;
+        }
+        if(extinfocaches.length() >= MAXEXTINFOCACHES)
+        {
+            extserverinforeply(req, p);
+            return;
+        }
+        extinfocache &c = extinfocaches.add();
+        c.req.put(p.buf, p.length());
+        extinfocapture = &c.replies;
+        extserverinforeply(req, p);
+        extinfocapture = NULL;
+    }
+
     void serverinforeply(ucharbuf &req, ucharbuf &p)
     {
         if(req.remaining() && !getint(req))
         {
-            extserverinforeply(req, p);
+            cachedextinforeply(req, p);
             return;
         }
 
-        putint(p, PROTOCOL_VERSION);
-        putint(p, numclients(-1, false, true));
-        putint(p, maxclients);
-        putint(p, gamepaused || gamespeed != 100 ? 5 : 3); // number of attrs following
-        putint(p, gamemode);
-        putint(p, m_timed ? max((gamelimit - gamemillis)/1000, 0) : 0);
-        putint(p, serverpass[0] ? MM_PASSWORD : (!m_mp(gamemode) ? MM_PRIVATE : (mastermode || mastermask&MM_AUTOAPPROVE ? mastermode : MM_AUTH)));
-        if(gamepaused || gamespeed != 100)
+        checkserverinfocache();
+        if(serverinfocache.empty())
         {
-            putint(p, gamepaused ? 1 : 0);
-            putint(p, gamespeed);
+            vector<uchar> &q = serverinfocache;
+            putint(q, PROTOCOL_VERSION);
+            putint(q, numclients(-1, false, true));
+            putint(q, maxclients);
+            putint(q, gamepaused || gamespeed != 100 ? 5 : 3); // number of attrs following
+            putint(q, gamemode);
+            putint(q, m_timed ? max((gamelimit - gamemillis)/1000, 0) : 0);
+            putint(q, serverpass[0] ? MM_PASSWORD : (!m_mp(gamemode) ? MM_PRIVATE : (mastermode || mastermask&MM_AUTOAPPROVE ? mastermode : MM_AUTH)));
+            if(gamepaused || gamespeed != 100)
+            {
+                putint(q, gamepaused ? 1 : 0);
+                putint(q, gamespeed);
+            }
+            sendstring(smapname, q);
+            sendstring(serverdesc, q);
         }
-        sendstring(smapname, p);
-        sendstring(serverdesc, p);
+        p.put(serverinfocache.getbuf(), serverinfocache.length());
         sendserverinforeply(p);
     }
 
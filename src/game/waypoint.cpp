@@ -417,95 +417,285 @@ namespace ai
         return n;
     }
 
-    static inline float heapscore(waypoint *q) { return q->score(); }
+    // landmark (ALT) heuristic: exact path costs to and from a few well spread waypoints, by the triangle inequality
+    // |cost(L,goal) - cost(L,n)| bounds cost(n,goal) far tighter than straight line distance on maze-like maps
+    #define MAXWPLANDMARKS 16
 
-    bool route(gameent *d, int node, int goal, vector<int> &route, const avoidset &obstacles, int retries)
+    VAR(waypointlandmarks, 0, 1, 1);
+
+    static vector<ushort> landmarks;
+    static vector<float> landmarkdists; // per waypoint, per landmark: cost from the landmark, cost to the landmark, -1 if unreachable
+    static int landmarkwps = 0;
+
+    static void clearlandmarks()
     {
-        if(waypoints.empty() || !iswaypoint(node) || !iswaypoint(goal) || goal == node || !waypoints[node].links[0])
-            return false;
+        landmarks.setsize(0);
+        landmarkdists.setsize(0);
+        landmarkwps = 0;
+    }
 
-        static ushort routeid = 1;
-        static vector<waypoint *> queue;
+    static inline bool uselandmarks()
+    {
+        return waypointlandmarks && landmarks.length() && landmarkwps == waypoints.length();
+    }
 
-        if(!routeid)
+    static inline float landmarkestimate(int wp, int goal)
+    {
+        int stride = landmarks.length()*2;
+        const float *a = &landmarkdists[wp*stride], *b = &landmarkdists[goal*stride];
+        float est = 0;
+        loopv(landmarks)
         {
-            loopv(waypoints) waypoints[i].route = 0;
-            routeid = 1;
+            if(a[0] >= 0 && b[0] >= 0) est = max(est, b[0] - a[0]);
+            if(a[1] >= 0 && b[1] >= 0) est = max(est, a[1] - b[1]);
+            a += 2;
+            b += 2;
         }
+        return est;
+    }
+
+    static inline int heapscore(const routestate::opennode &n) { return n.score; }
+
+    bool route(routestate &rs, gameent *d, int node, int goal, vector<int> &route, const avoidset &obstacles, int retries)
+    {
+        if(waypoints.empty() || !iswaypoint(node) || !iswaypoint(goal) || goal == node || !waypoints[node].links[0])
+            return false;
 
+        rs.reset(waypoints.length());
+        ushort routeid = rs.routeid;
+
+        #define BLOCKROUTE(wp) do { rs.route[wp] = routeid; rs.curscore[wp] = -1; rs.estscore[wp] = 0; } while(0)
         if(d)
         {
             if(retries <= 1 && d->ai) loopi(ai::NUMPREVNODES) if(d->ai->prevnodes[i] != node && iswaypoint(d->ai->prevnodes[i]))
-            {
-                waypoints[d->ai->prevnodes[i]].route = routeid;
-                waypoints[d->ai->prevnodes[i]].curscore = -1;
-                waypoints[d->ai->prevnodes[i]].estscore = 0;
-            }
+                BLOCKROUTE(d->ai->prevnodes[i]);
             if(retries <= 0)
             {
                 loopavoid(obstacles, d,
                 {
                     if(iswaypoint(wp) && wp != node && wp != goal && waypoints[node].find(wp) < 0 && waypoints[goal].find(wp) < 0)
-                    {
-                        waypoints[wp].route = routeid;
-                        waypoints[wp].curscore = -1;
-                        waypoints[wp].estscore = 0;
-                    }
+                        BLOCKROUTE(wp);
                 });
             }
         }
-
-        waypoints[node].route = routeid;
-        waypoints[node].curscore = waypoints[node].estscore = 0;
-        waypoints[node].prev = 0;
-        queue.setsize(0);
-        queue.add(&waypoints[node]);
+        #undef BLOCKROUTE
+
+        rs.route[node] = routeid;
+        rs.curscore[node] = rs.estscore[node] = 0;
+        rs.prev[node] = 0;
+        rs.queue.setsize(0);
+        routestate::opennode &first = rs.queue.add();
+        first.score = 0;
+        first.wp = node;
         route.setsize(0);
 
+        const vec &target = waypoints[goal].o;
+        bool landmarked = uselandmarks();
         int lowest = -1;
-        while(!queue.empty())
+        float lowestscore = 0;
+        while(!rs.queue.empty())
         {
-            waypoint &m = *queue.removeheap();
-            float prevscore = m.curscore;
-            m.curscore = -1;
+            int cur = rs.queue.removeheap().wp;
+            const waypoint &m = waypoints[cur];
+            float prevscore = rs.curscore[cur];
+            rs.curscore[cur] = -1;
             loopi(MAXWAYPOINTLINKS)
             {
                 int link = m.links[i];
                 if(!link) break;
                 if(iswaypoint(link) && (link == node || link == goal || waypoints[link].links[0]))
                 {
-                    waypoint &n = waypoints[link];
+                    const waypoint &n = waypoints[link];
                     int weight = max(n.weight, 1);
                     float curscore = prevscore + n.o.dist(m.o)*weight;
-                    if(n.route == routeid && curscore >= n.curscore) continue;
-                    n.curscore = curscore;
-                    n.prev = ushort(&m - &waypoints[0]);
-                    if(n.route != routeid)
+                    if(rs.route[link] == routeid && curscore >= rs.curscore[link]) continue;
+                    rs.curscore[link] = curscore;
+                    rs.prev[link] = cur;
+                    if(rs.route[link] != routeid)
                     {
-                        n.estscore = n.o.dist(waypoints[goal].o)*weight;
-                        if(n.estscore <= WAYPOINTRADIUS*4 && (lowest < 0 || n.estscore <= waypoints[lowest].estscore))
+                        float estscore = n.o.dist(target)*weight;
+                        if(estscore <= WAYPOINTRADIUS*4 && (lowest < 0 || estscore <= lowestscore))
+                        {
                             lowest = link;
-                        n.route = routeid;
+                            lowestscore = estscore;
+                        }
+                        if(landmarked) estscore = max(estscore, landmarkestimate(link, goal));
+                        rs.estscore[link] = estscore;
+                        rs.route[link] = routeid;
                         if(link == goal) goto foundgoal;
-                        queue.addheap(&n);
+                        routestate::opennode &open = rs.queue.add();
+                        open.score = int(curscore) + int(estscore);
+                        open.wp = link;
+                        rs.queue.upheap(rs.queue.length()-1);
+                    }
+                    else loopvj(rs.queue) if(rs.queue[j].wp == link)
+                    {
+                        rs.queue[j].score = int(curscore) + int(rs.estscore[link]);
+                        rs.queue.upheap(j);
+                        break;
                     }
-                    else loopvj(queue) if(queue[j] == &n) { queue.upheap(j); break; }
                 }
             }
         }
         foundgoal:
 
-        routeid++;
-
         if(lowest >= 0) // otherwise nothing got there
         {
-            for(waypoint *m = &waypoints[lowest]; m > &waypoints[0]; m = &waypoints[m->prev])
-                route.add(m - &waypoints[0]); // just keep it stored backward
+            for(int m = lowest; m > 0; m = rs.prev[m])
+                route.add(m); // just keep it stored backward
         }
 
         return !route.empty();
     }
 
+    static routestate mainroute;
+
+    bool route(gameent *d, int node, int goal, vector<int> &route, const avoidset &obstacles, int retries)
+    {
+        return ai::route(mainroute, d, node, goal, route, obstacles, retries);
+    }
+
+    // times routes between pseudo random pairs of linked waypoints, the same pairs every run so waypointlandmarks 0/1 compare directly
+    void benchroute(int num)
+    {
+        vector<int> linked;
+        for(int i = 1; i < waypoints.length(); i++) if(waypoints[i].links[0]) linked.add(i);
+        if(linked.length() < 2) { conoutf(CON_ERROR, "not enough linked waypoints"); return; }
+        avoidset obstacles;
+        vector<int> path;
+        uint seed = 1;
+        int found = 0, nodes = 0;
+        if(num <= 0) num = 1000;
+        uint start = getclockmicros();
+        loopi(num)
+        {
+            seed = seed*1103515245 + 12345;
+            int from = linked[(seed>>8)%linked.length()];
+            seed = seed*1103515245 + 12345;
+            int to = linked[(seed>>8)%linked.length()];
+            if(route(NULL, from, to, path, obstacles)) { found++; nodes += path.length(); }
+        }
+        uint elapsed = getclockmicros() - start;
+        conoutf("%d routes, %d found, %.1f nodes average: %.3f ms total, %.1f us per route%s",
+            num, found, found ? nodes/float(found) : 0.0f, elapsed/1000.0f, elapsed/float(num), uselandmarks() ? " (landmarks)" : "");
+    }
+    ICOMMAND(benchroute, "i", (int *num), benchroute(*num));
+
+    struct landmarknode
+    {
+        float dist;
+        int wp;
+    };
+
+    static inline float heapscore(const landmarknode &n) { return n.dist; }
+
+    // dijkstra from the landmark, along the links or against them using the reversed link lists
+    static void landmarksearch(int source, bool reverse, const vector<int> &revstart, const vector<ushort> &revlinks, vector<float> &dists)
+    {
+        dists.setsize(0);
+        loopv(waypoints) dists.add(-1);
+        vector<landmarknode> queue;
+        dists[source] = 0;
+        landmarknode &first = queue.add();
+        first.dist = 0;
+        first.wp = source;
+        while(!queue.empty())
+        {
+            landmarknode cur = queue.removeheap();
+            if(cur.dist > dists[cur.wp]) continue;
+            const waypoint &m = waypoints[cur.wp];
+            #define RELAXLANDMARK(link, cost) do { \
+                float dist = cur.dist + (cost); \
+                if(dists[link] >= 0 && dist >= dists[link]) break; \
+                dists[link] = dist; \
+                landmarknode &next = queue.add(); \
+                next.dist = dist; \
+                next.wp = link; \
+                queue.upheap(queue.length()-1); \
+            } while(0)
+            if(reverse)
+            {
+                float weight = max(m.weight, 1);
+                for(int i = revstart[cur.wp]; i < revstart[cur.wp+1]; i++)
+                {
+                    int link = revlinks[i];
+                    RELAXLANDMARK(link, waypoints[link].o.dist(m.o)*weight);
+                }
+            }
+            else loopi(MAXWAYPOINTLINKS)
+            {
+                int link = m.links[i];
+                if(!link) break;
+                if(!iswaypoint(link)) continue;
+                const waypoint &n = waypoints[link];
+                RELAXLANDMARK(link, n.o.dist(m.o)*max(n.weight, 1));
+            }
+            #undef RELAXLANDMARK
+        }
+    }
+
+    void genlandmarks(int num)
+    {
+        clearlandmarks();
+        num = clamp(num, 1, MAXWPLANDMARKS);
+
+        vector<int> revstart;
+        vector<ushort> revlinks;
+        loopv(waypoints) revstart.add(0);
+        revstart.add(0);
+        for(int i = 1; i < waypoints.length(); i++) loopj(MAXWAYPOINTLINKS)
+        {
+            int link = waypoints[i].links[j];
+            if(!link) break;
+            if(iswaypoint(link)) revstart[link+1]++;
+        }
+        loopv(waypoints) revstart[i+1] += revstart[i];
+        revlinks.pad(revstart.last());
+        vector<int> fill;
+        fill.put(revstart.getbuf(), waypoints.length());
+        for(int i = 1; i < waypoints.length(); i++) loopj(MAXWAYPOINTLINKS)
+        {
+            int link = waypoints[i].links[j];
+            if(!link) break;
+            if(iswaypoint(link)) revlinks[fill[link]++] = i;
+        }
+
+        // farthest point selection: each landmark is the linked waypoint farthest from those already chosen,
+        // waypoints no landmark reaches yet count as farthest so disconnected areas get covered too
+        vector<float> forward, backward, nearest;
+        vector<vector<float> > dists;
+        loopv(waypoints) nearest.add(-1);
+        int next = -1;
+        for(int i = 1; i < waypoints.length(); i++) if(waypoints[i].links[0]) { next = i; break; }
+        if(next < 0) return;
+        landmarksearch(next, false, revstart, revlinks, forward);
+        loopv(forward) if(forward[i] > forward[next] && waypoints[i].links[0]) next = i;
+        while(landmarks.length() < num)
+        {
+            landmarks.add(next);
+            landmarksearch(next, false, revstart, revlinks, forward);
+            landmarksearch(next, true, revstart, revlinks, backward);
+            dists.add().move(forward);
+            dists.add().move(backward);
+            next = -1;
+            float best = 0;
+            for(int i = 1; i < waypoints.length(); i++)
+            {
+                float dist = dists[dists.length()-2][i];
+                if(dist >= 0 && (nearest[i] < 0 || dist < nearest[i])) nearest[i] = dist;
+                if(!waypoints[i].links[0]) continue;
+                float score = nearest[i] < 0 ? 1e16f : nearest[i];
+                if(score > best) { best = score; next = i; }
+            }
+            if(next < 0) break;
+        }
+
+        int stride = landmarks.length()*2;
+        landmarkdists.pad(waypoints.length()*stride);
+        loopv(waypoints) loopj(stride) landmarkdists[i*stride + j] = dists[j][i];
+        landmarkwps = waypoints.length();
+    }
+
     VARF(dropwaypoints, 0, 0, 1, { player1->lastnode = -1; });
 
     int addwaypoint(const vec &o, int weight = -1)
@@ -514,11 +704,13 @@ namespace ai
         int n = waypoints.length();
         waypoints.add(waypoint(o, weight >= 0 ? weight : getweight(o)));
         invalidatewpcache(n);
+        clearlandmarks();
         return n;
     }
 
     void linkwaypoint(waypoint &a, int n)
     {
+        clearlandmarks();
         loopi(MAXWAYPOINTLINKS)
         {
             if(a.links[i] == n) return;
@@ -592,6 +784,7 @@ namespace ai
 
     void navigate()
     {
+        PROFILE("ai");
         if(shouldnavigate()) loopv(players) ai::navigate(players[i]);
         if(invalidatedwpcaches) clearwpcache(false);
     }
@@ -600,6 +793,7 @@ namespace ai
     {
         waypoints.setsize(0);
         clearwpcache();
+        clearlandmarks();
         if(full)
         {
             loadedwaypoints[0] = '\0';
@@ -628,6 +822,7 @@ namespace ai
 
     void remapwaypoints()
     {
+        clearlandmarks();
         vector<ushort> remap;
         int total = 0;
         loopv(waypoints) remap.add(waypoints[i].links[1] == 0xFFFF ? 0 : total++);
@@ -674,16 +869,88 @@ namespace ai
         return false;
     }
 
-    bool getwaypointfile(const char *mname, char *wptname)
+    bool getwaypointfile(const char *mname, char *wptname, const char *ext = "wpt")
     {
         if(!mname || !*mname) mname = getclientmap();
         if(!*mname) return false;
 
-        nformatstring(wptname, MAXSTRLEN, "media/map/%s.wpt", mname);
+        nformatstring(wptname, MAXSTRLEN, "media/map/%s.%s", mname, ext);
         path(wptname);
         return true;
     }
 
+    // landmark tables live in a .wpl next to the .wpt, tied to the exact graph and weights they were generated from
+    static uint waypointcrc()
+    {
+        uint crc = crc32(0, NULL, 0);
+        for(int i = 1; i < waypoints.length(); i++)
+        {
+            waypoint w = waypoints[i];
+            lilswap(&w.o.x, 3);
+            lilswap(&w.weight, 1);
+            lilswap(w.links, MAXWAYPOINTLINKS);
+            crc = crc32(crc, (const Bytef *)&w, sizeof(w));
+        }
+        return crc;
+    }
+
+    static void loadlandmarks(const char *mname)
+    {
+        clearlandmarks();
+        string wplname;
+        if(!getwaypointfile(mname, wplname, "wpl")) return;
+        stream *f = opengzfile(wplname, "rb");
+        if(!f) return;
+        char magic[4];
+        if(f->read(magic, 4) < 4 || memcmp(magic, "OWPL", 4) ||
+           f->getlil<ushort>() != waypoints.length()-1 || f->getlil<uint>() != waypointcrc())
+        {
+            conoutf(CON_WARN, "ignoring out of date waypoint landmarks %s", wplname);
+            delete f;
+            return;
+        }
+        int num = f->getchar();
+        if(num <= 0 || num > MAXWPLANDMARKS) { delete f; return; }
+        loopi(num) landmarks.add(f->getlil<ushort>());
+        int stride = num*2;
+        landmarkdists.pad(waypoints.length()*stride);
+        loopi(stride) landmarkdists[i] = -1;
+        for(int i = stride; i < landmarkdists.length(); i++) landmarkdists[i] = f->getlil<float>();
+        bool ok = !f->end();
+        loopv(landmarks) if(!iswaypoint(landmarks[i])) ok = false;
+        delete f;
+        if(!ok) { clearlandmarks(); return; }
+        landmarkwps = waypoints.length();
+        conoutf("loaded %d waypoint landmarks from %s", num, wplname);
+    }
+
+    static void savelandmarks(const char *mname)
+    {
+        string wplname;
+        if(!getwaypointfile(mname, wplname, "wpl")) return;
+        stream *f = opengzfile(wplname, "wb");
+        if(!f) return;
+        f->write("OWPL", 4);
+        f->putlil<ushort>(waypoints.length()-1);
+        f->putlil<uint>(waypointcrc());
+        f->putchar(landmarks.length());
+        loopv(landmarks) f->putlil<ushort>(landmarks[i]);
+        for(int i = landmarks.length()*2; i < landmarkdists.length(); i++) f->putlil<float>(landmarkdists[i]);
+        delete f;
+        conoutf("saved %d waypoint landmarks to %s", landmarks.length(), wplname);
+    }
+
+    void genwaypointlandmarks(int num, const char *mname)
+    {
+        if(waypoints.length() <= 1) { conoutf(CON_ERROR, "no waypoints to generate landmarks for"); return; }
+        uint start = getclockmicros();
+        genlandmarks(num > 0 ? num : 8);
+        if(!uselandmarks()) { conoutf(CON_ERROR, "no linked waypoints to generate landmarks for"); return; }
+        conoutf("generated %d waypoint landmarks in %.1f ms", landmarks.length(), (getclockmicros() - start)/1000.0f);
+        savelandmarks(mname);
+    }
+    ICOMMAND(genwaypointlandmarks, "is", (int *num, char *mname), genwaypointlandmarks(*num, mname));
+
     void loadwaypoints(bool force, const char *mname)
     {
         string wptname;
@@ -722,6 +989,7 @@ namespace ai
         conoutf("loaded %d waypoints from %s", numwp, wptname);
 
         if(!cleanwaypoints()) clearwpcache();
+        loadlandmarks(mname);
     }
     ICOMMAND(loadwaypoints, "s", (char *mname), loadwaypoints(true, mname));
 
@@ -750,6 +1018,8 @@ namespace ai
 
         delete f;
         conoutf("saved %d waypoints to %s", waypoints.length()-1, wptname);
+
+        if(uselandmarks()) savelandmarks(mname);
     }
 
     ICOMMAND(savewaypoints, "s", (char *mname), savewaypoints(true, mname));
@@ -794,6 +1064,7 @@ namespace ai
             w.o.add(d);
             if(!insideworld(w.o)) { w.links[0] = 0; w.links[1] = 0xFFFF; cleared++; }
         }
+        clearlandmarks();
         if(cleared)
         {
             player1->lastnode = -1;
@@ -234,6 +234,34 @@ extern void renderentring(const extentity &e, float radius, int axis = 0);
 
 // main
 extern void fatal(const char *s, ...) PRINTFARGS(1, 2);
+extern uint getclockmicros();
+
+// profile
+struct profilestat
+{
+    const char *name;
+    int depth;
+    float millis, calls;
+};
+
+extern int profiling;
+extern void beginprofile(const char *name);
+extern void endprofile();
+extern void profileframe();
+extern const vector<profilestat> &publishprofile();
+extern void logprofile();
+extern void profilethread(const char *name, bool framed = false);
+extern void profilethreaddone();
+
+struct profilescope
+{
+    bool active;
+
+    profilescope(const char *name) : active(profiling!=0) { if(active) beginprofile(name); }
+    ~profilescope() { if(active) endprofile(); }
+};
+
+#define PROFILE(name) profilescope profilezone(name)
 
 // rendertext
 extern bool setfont(const char *name);
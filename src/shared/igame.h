@@ -51,6 +51,7 @@ namespace game
     extern void loadconfigs();
 
     extern void updateworld();
+    extern void simulateworld();
     extern void initclient();
     extern void physicstrigger(physent *d, bool local, int floorlevel, int waterlevel, int material = 0);
     extern void bounced(physent *d, const vec &surface);
@@ -104,6 +105,8 @@ namespace server
     extern void localconnect(int n);
     extern bool allowbroadcast(int n);
     extern void recordpacket(int chan, void *data, int len);
+    extern bool queuebroadcast(int chan, const uchar *data, int len, int exclude, bool reliable);
+    extern void flushbroadcasts();
     extern void parsepacket(int sender, int chan, packetbuf &p);
     extern void sendservmsg(const char *s);
     extern bool sendpackets(bool force = false);
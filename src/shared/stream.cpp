@@ -701,6 +701,7 @@ struct filestream : stream
 #ifndef STANDALONE
 VAR(dbggz, 0, 0, 1);
 #endif
+VAR(gzseekspan, 0, 1024, 1<<20);
 
 struct gzstream : stream
 {
@@ -709,7 +710,10 @@ struct gzstream : stream
         MAGIC1   = 0x1F,
         MAGIC2   = 0x8B,
         BUFSIZE  = 16384,
-        OS_UNIX  = 0x03
+        OS_UNIX  = 0x03,
+        SEEK_ID1 = 'T',
+        SEEK_ID2 = 'S',
+        WINSIZE  = 1<<MAX_WBITS
     };
 
     enum
@@ -722,14 +726,24 @@ struct gzstream : stream
         F_RESERVED = 0xE0
     };
 
+    struct seekpoint
+    {
+        offset out, in;
+        uint crc;
+        int bits;
+        uchar *window;
+    };
+
     stream *file;
     z_stream zfile;
-    uchar *buf;
+    uchar *buf, *window;
     bool reading, writing, autoclose;
-    uint crc;
+    uint crc, flushspan, seekspan;
     size_t headersize;
+    offset inbase;
+    vector<seekpoint> seekpoints;
 
-    gzstream() : file(NULL), buf(NULL), reading(false), writing(false), autoclose(false), crc(0), headersize(0)
+    gzstream() : file(NULL), buf(NULL), window(NULL), reading(false), writing(false), autoclose(false), crc(0), flushspan(0), seekspan(0), headersize(0), inbase(0)
     {
         zfile.zalloc = NULL;
         zfile.zfree = NULL;
@@ -745,8 +759,18 @@ struct gzstream : stream
 
     void writeheader()
     {
-        uchar header[] = { MAGIC1, MAGIC2, Z_DEFLATED, 0, 0, 0, 0, 0, 0, OS_UNIX };
+        uchar header[] = { MAGIC1, MAGIC2, Z_DEFLATED, uchar(flushspan ? F_EXTRA : 0), 0, 0, 0, 0, 0, OS_UNIX };
         file->write(header, sizeof(header));
+        if(flushspan)
+        {
+            // advertise the full flush interval so readers can seek without keeping a window
+            uchar extra[] =
+            {
+                8, 0, SEEK_ID1, SEEK_ID2, 4, 0,
+                uchar(flushspan&0xFF), uchar((flushspan>>8)&0xFF), uchar((flushspan>>16)&0xFF), uchar((flushspan>>24)&0xFF)
+            };
+            file->write(extra, sizeof(extra));
+        }
     }
 
     void readbuf(size_t size = BUFSIZE)
@@ -789,16 +813,32 @@ struct gzstream : stream
         {
             size_t len = readbyte(512);
             len |= size_t(readbyte(512))<<8;
+            while(len >= 4)
+            {
+                uchar id1 = readbyte(512), id2 = readbyte(512);
+                size_t sublen = readbyte(512);
+                sublen |= size_t(readbyte(512))<<8;
+                len -= 4;
+                sublen = min(sublen, len);
+                len -= sublen;
+                if(id1 == SEEK_ID1 && id2 == SEEK_ID2 && sublen >= 4)
+                {
+                    loopi(4) flushspan |= uint(readbyte(512)) << (i*8);
+                    sublen -= 4;
+                }
+                skipbytes(sublen);
+            }
             skipbytes(len);
         }
         if(flags & F_NAME) while(readbyte(512));
         if(flags & F_COMMENT) while(readbyte(512));
         if(flags & F_CRC) skipbytes(2);
         headersize = size_t(file->tell() - zfile.avail_in);
+        inbase = headersize;
         return zfile.avail_in > 0 || !file->end();
     }
 
-    bool open(stream *f, const char *mode, bool needclose, int level)
+    bool open(stream *f, const char *mode, bool needclose, int level, int flush)
     {
         if(file) return false;
         for(; *mode; mode++)
@@ -820,13 +860,98 @@ struct gzstream : stream
         if(reading)
         {
             if(!checkheader()) { stopreading(); return false; }
+            if(flushspan) seekspan = gzseekspan ? flushspan : 0;
+            else if(gzseekspan)
+            {
+                seekspan = max(gzseekspan, WINSIZE>>9)<<10;
+                window = new uchar[WINSIZE];
+            }
+        }
+        else if(writing)
+        {
+            flushspan = max(flush, 0);
+            writeheader();
         }
-        else if(writing) writeheader();
 
         autoclose = needclose;
         return true;
     }
 
+    void updatewindow(const uchar *data, size_t len)
+    {
+        if(len > WINSIZE) { data += len - WINSIZE; len = WINSIZE; }
+        size_t pos = size_t((zfile.total_out - len) % WINSIZE), n = min(len, WINSIZE - pos);
+        memcpy(&window[pos], data, n);
+        if(n < len) memcpy(window, &data[n], len - n);
+    }
+
+    void consume(uchar *&done)
+    {
+        size_t n = zfile.next_out - done;
+        crc = crc32(crc, done, n);
+        if(window) updatewindow(done, n);
+        done = zfile.next_out;
+    }
+
+    void addseekpoint()
+    {
+        offset out = zfile.total_out;
+        if(!out || (zfile.data_type&64) || out < (seekpoints.empty() ? 0 : seekpoints.last().out) + seekspan) return;
+        // full flush points only line up with multiples of the flush interval
+        if(flushspan && out%flushspan) return;
+        seekpoint &sp = seekpoints.add();
+        sp.out = out;
+        sp.in = inbase + zfile.total_in;
+        sp.crc = crc;
+        sp.bits = zfile.data_type&7;
+        sp.window = NULL;
+        if(window)
+        {
+            sp.window = new uchar[WINSIZE];
+            size_t pos = size_t(out % WINSIZE);
+            memcpy(sp.window, &window[pos], WINSIZE - pos);
+            memcpy(&sp.window[WINSIZE - pos], window, pos);
+        }
+    }
+
+    seekpoint *findseekpoint(offset pos)
+    {
+        int lo = 0, hi = seekpoints.length();
+        while(lo < hi)
+        {
+            int mid = (lo + hi)/2;
+            if(seekpoints[mid].out <= pos) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo > 0 ? &seekpoints[lo-1] : NULL;
+    }
+
+    bool restoreseekpoint(const seekpoint &sp)
+    {
+        int c = 0;
+        if(!file->seek(sp.in - (sp.bits ? 1 : 0), SEEK_SET) || (sp.bits && (c = file->getchar()) < 0)) return false;
+        if(inflateReset(&zfile) != Z_OK || (sp.bits && inflatePrime(&zfile, sp.bits, c >> (8 - sp.bits)) != Z_OK)) return false;
+        zfile.avail_in = 0;
+        zfile.next_in = NULL;
+        inbase = sp.in;
+        zfile.total_out = uLong(sp.out);
+        if(sp.window)
+        {
+            if(inflateSetDictionary(&zfile, sp.window, WINSIZE) != Z_OK) return false;
+            updatewindow(sp.window, WINSIZE);
+        }
+        crc = sp.crc;
+        return true;
+    }
+
+    void clearseekpoints()
+    {
+        loopv(seekpoints) DELETEA(seekpoints[i].window);
+        seekpoints.setsize(0);
+        seekspan = 0;
+        DELETEA(window);
+    }
+
     uint getcrc() { return crc; }
 
     void finishreading()
@@ -851,6 +976,7 @@ struct gzstream : stream
         if(!reading) return;
         inflateEnd(&zfile);
         reading = false;
+        clearseekpoints();
     }
 
     void finishwriting()
@@ -915,11 +1041,17 @@ struct gzstream : stream
         }
         else if(whence == SEEK_CUR) pos += zfile.total_out;
 
-        if(pos >= (offset)zfile.total_out) pos -= zfile.total_out;
+        seekpoint *sp = pos >= 0 ? findseekpoint(pos) : NULL;
+        if(sp && (pos < (offset)zfile.total_out || sp->out > (offset)zfile.total_out))
+        {
+            if(!restoreseekpoint(*sp)) { stopreading(); return false; }
+            pos -= sp->out;
+        }
+        else if(pos >= (offset)zfile.total_out) pos -= zfile.total_out;
         else if(pos < 0 || !file->seek(headersize, SEEK_SET)) return false;
         else
         {
-            if(zfile.next_in && zfile.total_in <= uint(zfile.next_in - buf))
+            if(zfile.next_in && inbase == (offset)headersize && zfile.total_in <= uint(zfile.next_in - buf))
             {
                 zfile.avail_in += zfile.total_in;
                 zfile.next_in -= zfile.total_in;
@@ -930,6 +1062,7 @@ struct gzstream : stream
                 zfile.next_in = NULL;
             }
             inflateReset(&zfile);
+            inbase = headersize;
             crc = crc32(0, NULL, 0);
         }
 
@@ -947,6 +1080,7 @@ struct gzstream : stream
     size_t read(void *buf, size_t len)
     {
         if(!reading || !buf || !len) return 0;
+        uchar *done = (uchar *)buf;
         zfile.next_out = (Bytef *)buf;
         zfile.avail_out = len;
         while(zfile.avail_out > 0)
@@ -956,11 +1090,12 @@ struct gzstream : stream
                 readbuf(BUFSIZE);
                 if(!zfile.avail_in) { stopreading(); break; }
             }
-            int err = inflate(&zfile, Z_NO_FLUSH);
-            if(err == Z_STREAM_END) { crc = crc32(crc, (Bytef *)buf, len - zfile.avail_out); finishreading(); stopreading(); return len - zfile.avail_out; }
+            int err = inflate(&zfile, seekspan ? Z_BLOCK : Z_NO_FLUSH);
+            if(err == Z_STREAM_END) { consume(done); finishreading(); stopreading(); return len - zfile.avail_out; }
             else if(err != Z_OK) { stopreading(); break; }
+            if(seekspan && zfile.data_type&128) { consume(done); addseekpoint(); }
         }
-        crc = crc32(crc, (Bytef *)buf, len - zfile.avail_out);
+        consume(done);
         return len - zfile.avail_out;
     }
 
@@ -979,19 +1114,40 @@ struct gzstream : stream
 
     bool flush() { return flushbuf(true); }
 
+    bool fullflush()
+    {
+        do
+        {
+            if(!zfile.avail_out && !flushbuf()) return false;
+            int err = deflate(&zfile, Z_FULL_FLUSH);
+            if(err != Z_OK && err != Z_BUF_ERROR) return false;
+        } while(!zfile.avail_out);
+        return true;
+    }
+
     size_t write(const void *buf, size_t len)
     {
         if(!writing || !buf || !len) return 0;
+        uLong start = zfile.total_in;
         zfile.next_in = (Bytef *)buf;
         zfile.avail_in = len;
-        while(zfile.avail_in > 0)
+        while(writing && zfile.avail_in > 0)
         {
-            if(!zfile.avail_out && !flushbuf()) { stopwriting(); break; }
-            int err = deflate(&zfile, Z_NO_FLUSH);
-            if(err != Z_OK) { stopwriting(); break; }
+            uint rest = 0;
+            if(flushspan) { uint span = flushspan - uint(zfile.total_in%flushspan); if(zfile.avail_in > span) { rest = zfile.avail_in - span; zfile.avail_in = span; } }
+            while(zfile.avail_in > 0)
+            {
+                if(!zfile.avail_out && !flushbuf()) { stopwriting(); break; }
+                int err = deflate(&zfile, Z_NO_FLUSH);
+                if(err != Z_OK) { stopwriting(); break; }
+            }
+            if(!writing) break;
+            if(flushspan && !(zfile.total_in%flushspan) && !fullflush()) stopwriting();
+            zfile.avail_in += rest;
         }
-        crc = crc32(crc, (Bytef *)buf, len - zfile.avail_in);
-        return len - zfile.avail_in;
+        size_t written = size_t(zfile.total_in - start);
+        crc = crc32(crc, (Bytef *)buf, written);
+        return written;
     }
 };
 
@@ -1193,12 +1349,12 @@ stream *opentempfile(const char *name, const char *mode)
     return file;
 }
 
-stream *opengzfile(const char *filename, const char *mode, stream *file, int level)
+stream *opengzfile(const char *filename, const char *mode, stream *file, int level, int flushspan)
 {
     stream *source = file ? file : openfile(filename, mode);
     if(!source) return NULL;
     gzstream *gz = new gzstream;
-    if(!gz->open(source, mode, !file, level)) { if(!file) delete source; delete gz; return NULL; }
+    if(!gz->open(source, mode, !file, level, flushspan)) { if(!file) delete source; delete gz; return NULL; }
     return gz;
 }
 
@@ -1195,6 +1195,192 @@ template <class T, int SIZE> struct reversequeue : queue<T, SIZE>
     const T &operator[](int offset) const { return queue<T, SIZE>::added(offset); }
 };
 
+#ifdef __GNUC__
+template<class T> static inline T atomicload(const T &v) { return __atomic_load_n(&v, __ATOMIC_ACQUIRE); }
+template<class T> static inline void atomicstore(T &v, T n) { __atomic_store_n(&v, n, __ATOMIC_RELEASE); }
+template<class T> static inline T atomicadd(T &v, T n) { return __atomic_add_fetch(&v, n, __ATOMIC_ACQ_REL); }
+template<class T> static inline bool atomiccas(T &v, T expected, T n) { return __atomic_compare_exchange_n(&v, &expected, n, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE); }
+#else
+// volatile accesses have acquire/release semantics under MSVC
+template<class T> static inline T atomicload(const T &v) { return *(const volatile T *)&v; }
+template<class T> static inline void atomicstore(T &v, T n) { *(volatile T *)&v = n; }
+template<class T> static inline T atomicadd(T &v, T n) { return T(_InterlockedExchangeAdd((volatile long *)&v, long(n)) + long(n)); }
+template<class T> static inline bool atomiccas(T &v, T expected, T n) { return _InterlockedCompareExchange((volatile long *)&v, long(n), long(expected)) == long(expected); }
+#endif
+
+// bounded lock-free queue for handing items from exactly one producer thread to exactly one consumer thread
+template <class T, int SIZE> struct spscqueue
+{
+    int head;
+    T data[SIZE];
+    int tail;
+
+    spscqueue() : head(0), tail(0) {}
+
+    bool empty() const { return atomicload(head) == atomicload(tail); }
+
+    bool add(const T &e)
+    {
+        int next = tail+1 < SIZE ? tail+1 : 0;
+        if(next == atomicload(head)) return false;
+        data[tail] = e;
+        atomicstore(tail, next);
+        return true;
+    }
+
+    bool remove(T &e)
+    {
+        if(head == atomicload(tail)) return false;
+        e = data[head];
+        atomicstore(head, head+1 < SIZE ? head+1 : 0);
+        return true;
+    }
+};
+
+extern void fatal(const char *s, ...) PRINTFARGS(1, 2);
+
+// insert-only open addressing table that any number of threads may search and insert into at once without locks
+// a slot's state goes from empty to claimed by the one inserting thread, then to ready once its element is written,
+// so readers only ever compare fully written keys; it never grows, so reserve() room for every element up front
+template<class H, class E, class K, class T> struct concurrenthashbase
+{
+    typedef E elemtype;
+    typedef K keytype;
+    typedef T datatype;
+
+    enum { EMPTY = 0, CLAIMED = 1, READY = 3 };
+    enum { DEFAULTSIZE = 1<<10 };
+
+    int size;
+    int numelems;
+    uint *states;
+    E *elems;
+
+    concurrenthashbase(int maxelems = DEFAULTSIZE/2) : size(0), numelems(0), states(NULL), elems(NULL)
+    {
+        reserve(maxelems);
+    }
+
+    ~concurrenthashbase()
+    {
+        DELETEA(states);
+        DELETEA(elems);
+    }
+
+    // not thread safe, sizes the table at no more than half full for maxelems and empties it
+    void reserve(int maxelems)
+    {
+        int sz = DEFAULTSIZE;
+        while(sz < 2*maxelems) sz <<= 1;
+        if(sz != size)
+        {
+            DELETEA(states);
+            DELETEA(elems);
+            size = sz;
+            states = new uint[size];
+            elems = new E[size];
+        }
+        memset(states, 0, size*sizeof(uint));
+        numelems = 0;
+    }
+
+    void clear()
+    {
+        if(!numelems) return;
+        loopi(size) if(states[i]) { elems[i].~E(); new (&elems[i]) E; }
+        memset(states, 0, size*sizeof(uint));
+        numelems = 0;
+    }
+
+    int length() const { return atomicload(numelems); }
+    bool inuse(int i) const { return atomicload(states[i]) == READY; }
+
+    // tag the state with the upper hash bits so most mismatches never touch the element
+    #define CHTFIND(found, claim) \
+        uint h = hthash(key), tag = h&~3U; \
+        for(int i = h&(this->size-1), probes = 0; probes < this->size;) \
+        { \
+            uint state = atomicload(this->states[i]); \
+            if(state == EMPTY) { claim; break; } \
+            if((state&~3U) == tag) \
+            { \
+                while((state&3) != READY) state = atomicload(this->states[i]); \
+                if(htcmp(key, H::getkey(this->elems[i]))) return found H::getdata(this->elems[i]); \
+            } \
+            i = (i+1)&(this->size-1); \
+            probes++; \
+        }
+
+    template<class U>
+    T *access(const U &key)
+    {
+        CHTFIND(&, );
+        return NULL;
+    }
+
+    // returns the existing data for key, or inserts elem; when several threads race to insert the same key one wins
+    template<class U, class V>
+    T &access(const U &key, const V &elem)
+    {
+        CHTFIND( , if(!atomiccas(this->states[i], state, tag|CLAIMED)) continue;
+            H::setkey(this->elems[i], key);
+            H::getdata(this->elems[i]) = elem;
+            atomicadd(this->numelems, 1);
+            atomicstore(this->states[i], tag|READY);
+            return H::getdata(this->elems[i]));
+        fatal("concurrent hash table full (%d elements)", size);
+        return H::getdata(elems[0]);
+    }
+
+    template<class U>
+    T &find(const U &key, T &notfound)
+    {
+        CHTFIND( , );
+        return notfound;
+    }
+
+    template<class U>
+    const T &find(const U &key, const T &notfound)
+    {
+        CHTFIND( , );
+        return notfound;
+    }
+
+    #undef CHTFIND
+};
+
+template<class T> struct concurrenthashset : concurrenthashbase<concurrenthashset<T>, T, T, T>
+{
+    typedef concurrenthashbase<concurrenthashset<T>, T, T, T> basetype;
+
+    concurrenthashset(int maxelems = basetype::DEFAULTSIZE/2) : basetype(maxelems) {}
+
+    static inline const T &getkey(const T &elem) { return elem; }
+    static inline T &getdata(T &elem) { return elem; }
+    template<class K> static inline void setkey(T &elem, const K &key) {}
+
+    template<class V>
+    T &add(const V &elem)
+    {
+        return basetype::access(elem, elem);
+    }
+};
+
+template<class K, class T> struct concurrenthashtable : concurrenthashbase<concurrenthashtable<K, T>, hashtableentry<K, T>, K, T>
+{
+    typedef concurrenthashbase<concurrenthashtable<K, T>, hashtableentry<K, T>, K, T> basetype;
+    typedef typename basetype::elemtype elemtype;
+
+    concurrenthashtable(int maxelems = basetype::DEFAULTSIZE/2) : basetype(maxelems) {}
+
+    static inline K &getkey(elemtype &elem) { return elem.key; }
+    static inline T &getdata(elemtype &elem) { return elem.data; }
+    template<class U> static inline void setkey(elemtype &elem, const U &key) { elem.key = key; }
+};
+
+#define enumerateconcurrentkt(ht,k,e,t,f,b) loopi((ht).size) if((ht).inuse(i)) { k &e = (ht).elems[i].key; t &f = (ht).elems[i].data; b; }
+#define enumerateconcurrent(ht,t,e,b)       loopi((ht).size) if((ht).inuse(i)) { t &e = (ht).getdata((ht).elems[i]); b; }
+
 static inline bool islittleendian() { union { int i; uchar b[sizeof(int)]; } conv; conv.i = 1; return conv.b[0] != 0; }
 #ifdef SDL_BYTEORDER
 #define endianswap16 SDL_Swap16
@@ -1366,7 +1552,7 @@ extern stream *openrawfile(const char *filename, const char *mode);
 extern stream *openzipfile(const char *filename, const char *mode);
 extern stream *openfile(const char *filename, const char *mode);
 extern stream *opentempfile(const char *filename, const char *mode);
-extern stream *opengzfile(const char *filename, const char *mode, stream *file = NULL, int level = Z_BEST_COMPRESSION);
+extern stream *opengzfile(const char *filename, const char *mode, stream *file = NULL, int level = Z_BEST_COMPRESSION, int flushspan = 0);
 extern stream *openutf8file(const char *filename, const char *mode, stream *file = NULL);
 extern char *loadfile(const char *fn, size_t *size, bool utf8 = true);
 extern bool listdir(const char *dir, bool rel, const char *ext, vector<char *> &files);